@@ -623,7 +623,7 @@ calc_getenv(calc_t *self, void *user, calctok_t *tok)
 {
   char *s;
 
-  if( (s = getenv(tok->tok_sym.cc_string)) != 0 )
+  if( (s = getenv(csvcell_gettext(&tok->tok_sym))) != 0 )
   {
     csvcell_setauto(&tok->tok_val, s);
     tok->tok_code = tc_lit;
@@ -634,7 +634,7 @@ calc_getenv(calc_t *self, void *user, calctok_t *tok)
     tok->tok_code = tc_lit;
   }
 
-  fprintf(stderr, "GETENV '%s' '%s'\n", tok->tok_sym.cc_string, s ? s : "<none>");
+  fprintf(stderr, "GETENV '%s' '%s'\n", csvcell_gettext(&tok->tok_sym), s ? s : "<none>");
 }
 
 /* ------------------------------------------------------------------------- *
@@ -646,9 +646,9 @@ calc_setenv(calc_t *self, void *user, calctok_t *tok)
 {
   char tmp[32];
   const char *val = csvcell_getstring(&tok->tok_val, tmp, sizeof tmp);
-  setenv(tok->tok_sym.cc_string, val, 1);
+  setenv(csvcell_gettext(&tok->tok_sym), val, 1);
 
-  fprintf(stderr, "SETENV '%s' '%s'\n", tok->tok_sym.cc_string, val);
+  fprintf(stderr, "SETENV '%s' '%s'\n", csvcell_gettext(&tok->tok_sym), val);
 }
 
 /* ------------------------------------------------------------------------- *
@@ -1070,10 +1070,11 @@ static int calc_tokenize_expression(calc_t *self, const char *text)
        * - - - - - - - - - - - - - - - - - - - */
 
       t->tok_code = tc_lit;
-      csvcell_setnumber(&t->tok_val, strtod(beg,&end));
+      double numb = strtod(beg, &end);
+      csvcell_setdigits(&t->tok_val, numb, beg, end - beg);
 
 // QUARANTINE       fprintf(stderr, "TOK <- num '%.*s' %g\n",
-// QUARANTINE         (int)(end-beg), beg, t->tok_val.cc_number);
+// QUARANTINE         (int)(end-beg), beg, csvcell_getnumber(&t->tok_val));
     }
     else if( issymbeg(c) )
     {
@@ -1119,7 +1120,7 @@ static int calc_tokenize_expression(calc_t *self, const char *text)
     }
   }
 
-  if( !ok )
+  if( !ok && !self->calc_quiet )
   {
     fprintf(stderr, "TOKENIZATION ERROR:\n");
     fprintf(stderr, "%s\n", text);
@@ -1143,21 +1144,24 @@ static int calc_syntax_tree(calc_t *self)
   if( setjmp(syntax_error_return) != 0 )
   {
     ok = 0;
-    fprintf(stderr, "\n");
-    fprintf(stderr, "SYNTAX ERROR:\n");
+    if( !self->calc_quiet )
+    {
+      fprintf(stderr, "\n");
+      fprintf(stderr, "SYNTAX ERROR:\n");
 
-    int x = 0, t = 0;
+      int x = 0, t = 0;
 
-    for( int i = 0; i < self->calc_fifo.stk_tail; ++i )
-    {
-      calctok_t *tok = self->calc_fifo.stk_data[i];
-      char tmp[64];
-      if( tok == syntax_error_token ) { t = x; }
-      x += fprintf(stderr, "%s ", calctok_repr(tok, tmp));
+      for( int i = 0; i < self->calc_fifo.stk_tail; ++i )
+      {
+        calctok_t *tok = self->calc_fifo.stk_data[i];
+        char tmp[64];
+        if( tok == syntax_error_token ) { t = x; }
+        x += fprintf(stderr, "%s ", calctok_repr(tok, tmp));
+      }
+      fprintf(stderr, "\n");
+      arrow(t);
+      //fprintf(stderr, "%*s^\n", t, "");
     }
-    fprintf(stderr, "\n");
-    arrow(t);
-    //fprintf(stderr, "%*s^\n", t, "");
   }
   else
   {
@@ -1180,8 +1184,8 @@ static int calc_syntax_tree(calc_t *self)
  * calc_evalsub  --  evaluate numerical value of token tree
  * ------------------------------------------------------------------------- */
 
-#define value(cell)		(cell->cc_number)
-#define istrue(cell)	(fabs(cell->cc_number) > EPSILON)
+#define value(cell)		csvcell_getnumber(cell)
+#define istrue(cell)	(fabs(csvcell_getnumber(cell)) > EPSILON)
 
 #define a1() 			calc_evalsub(self, root->tok_arg1)
 #define a2() 			calc_evalsub(self, root->tok_arg2)
@@ -1190,6 +1194,62 @@ static int calc_syntax_tree(calc_t *self)
 #define v1()            value(a1())
 #define v2()            value(a2())
 
+/* ------------------------------------------------------------------------- *
+ * calc_arith  --  add, sub, mul & mod with exact integer results
+ *
+ * Doubles hold integers exactly below 2^53, so the 64 bit integer
+ * path is taken only for large integer operands or results.
+ * ------------------------------------------------------------------------- */
+
+static void calc_arith(csvcell_t *res, int code,
+                       const csvcell_t *c1, const csvcell_t *c2)
+{
+  double  d1 = value(c1);
+  double  d2 = value(c2);
+  double  dr = 0;
+  int64_t i1, i2, ir = 0;
+  int     ok;
+
+  switch( code )
+  {
+  case tc_add: dr = d1 + d2;      break;
+  case tc_sub: dr = d1 - d2;      break;
+  case tc_mul: dr = d1 * d2;      break;
+  case tc_mod: dr = fmod(d1, d2); break;
+  }
+
+  if( fabs(dr) < CSVCELL_EXACT && !csvcell_isint64(c1) && !csvcell_isint64(c2) )
+  {
+    csvcell_setnumber(res, dr);
+    return;
+  }
+
+  ok = csvcell_getinteger(c1, &i1) && csvcell_getinteger(c2, &i2);
+
+  if( ok )
+  {
+    switch( code )
+    {
+    case tc_add: ok = !__builtin_add_overflow(i1, i2, &ir); break;
+    case tc_sub: ok = !__builtin_sub_overflow(i1, i2, &ir); break;
+    case tc_mul: ok = !__builtin_mul_overflow(i1, i2, &ir); break;
+    case tc_mod:
+      ok = (i2 != 0 && !(i1 == INT64_MIN && i2 == -1));
+      if( ok ) ir = i1 % i2;
+      break;
+    }
+  }
+
+  if( ok )
+  {
+    csvcell_setinteger(res, ir);
+  }
+  else
+  {
+    csvcell_setnumber(res, dr);
+  }
+}
+
 
 static csvcell_t *calc_evalsub(calc_t *self, calctok_t *root)
 {
@@ -1233,13 +1293,14 @@ static csvcell_t *calc_evalsub(calc_t *self, calctok_t *root)
     break;
 
   case tc_add:
-    csvcell_setnumber(res, v1() + v2());
-    break;
   case tc_sub:
-    csvcell_setnumber(res, v1() - v2());
-    break;
   case tc_mul:
-    csvcell_setnumber(res, v1() * v2());
+    {
+      // left operand first, assignments may add columns
+      const csvcell_t *c1 = a1();
+      const csvcell_t *c2 = a2();
+      calc_arith(res, root->tok_code, c1, c2);
+    }
     break;
   case tc_div:
     //csvcell_setnumber(res, v1() / v2());
@@ -1276,7 +1337,11 @@ static csvcell_t *calc_evalsub(calc_t *self, calctok_t *root)
     break;
 
   case tc_mod:
-    csvcell_setnumber(res, fmod(v1(),v2()));
+    {
+      const csvcell_t *c1 = a1();
+      const csvcell_t *c2 = a2();
+      calc_arith(res, root->tok_code, c1, c2);
+    }
     break;
   case tc_pow:
     csvcell_setnumber(res, pow(v1(),v2()));
@@ -1287,14 +1352,25 @@ static csvcell_t *calc_evalsub(calc_t *self, calctok_t *root)
     break;
 
   case tc_neg:
-    csvcell_setnumber(res, -v2());
+    {
+      const csvcell_t *arg = a2();
+
+      if( csvcell_isint64(arg) && csvcell_getint64(arg) != INT64_MIN )
+      {
+        csvcell_setinteger(res, -csvcell_getint64(arg));
+      }
+      else
+      {
+        csvcell_setnumber(res, -value(arg));
+      }
+    }
     break;
 
   case tc_lit:
     break;
 
   case tc_var:
-    if( root->tok_sym.cc_string == 0 )
+    if( !csvcell_isstring(&root->tok_sym) )
     {
       fprintf(stderr, "get target not variable!\n");
     }
@@ -1305,7 +1381,7 @@ static csvcell_t *calc_evalsub(calc_t *self, calctok_t *root)
     break;
 
   case tc_set:
-    if( root->tok_arg1->tok_sym.cc_string == 0 )
+    if( !csvcell_isstring(&root->tok_arg1->tok_sym) )
     {
       fprintf(stderr, "set target not variable!\n");
     }
@@ -1357,6 +1433,8 @@ calc_t *calc_create(void)
   self->calc_getvar = calc_getenv;
   self->calc_setvar = calc_setenv;
 
+  self->calc_quiet = 0;
+
   return self;
 }
 
@@ -1406,7 +1484,7 @@ double calc_evaluate(calc_t *self)
   if( root != 0 )
   {
     calc_evalsub(self, root);
-    return root->tok_val.cc_number;
+    return csvcell_getnumber(&root->tok_val);
   }
   return 0;
 }
@@ -1424,6 +1502,90 @@ double calc_compile_and_evaluate(calc_t *self, const char *expr)
   return 0.0;
 }
 
+/* ------------------------------------------------------------------------- *
+ * calc_reserve  --  make room in table for columns expression assigns
+ *
+ * Call after compiling, so that assignments to new columns do not
+ * need to grow the table rows one column at a time while evaluating.
+ * ------------------------------------------------------------------------- */
+
+void calc_reserve(calc_t *self, csv_t *csv)
+{
+  calcstk_t *fifo = &self->calc_fifo;
+  int        add  = 0;
+
+  for( int i = 0; i < fifo->stk_tail; ++i )
+  {
+    calctok_t  *tok = fifo->stk_data[i];
+    const char *sym = 0;
+    int         dup = 0;
+
+    if( tok->tok_code != tc_set || !csvcell_isstring(&tok->tok_arg1->tok_sym) )
+    {
+      continue;
+    }
+
+    sym = calctok_getsymbol(tok->tok_arg1);
+
+    for( int k = 0; !dup && k < i; ++k )
+    {
+      calctok_t *set = fifo->stk_data[k];
+
+      dup = (set->tok_code == tc_set &&
+             csvcell_isstring(&set->tok_arg1->tok_sym) &&
+             !strcmp(calctok_getsymbol(set->tok_arg1), sym));
+    }
+
+    if( !dup && csv_getcol(csv, sym) < 0 )
+    {
+      add += 1;
+    }
+  }
+
+  if( add > 0 )
+  {
+    csv_reserve(csv, 0, csv_cols(csv) + add);
+  }
+}
+
+/* ------------------------------------------------------------------------- *
+ * calc_sets_conditionally  --  check for assignments done on some rows only
+ *
+ * Assignments on the right hand side of '&&', '||' and '#', or in
+ * the branches of '?:', depend on values, so the columns such an
+ * expression adds to a table depend on the rows it is evaluated for.
+ * ------------------------------------------------------------------------- */
+
+static int calc_branch_sets(const calctok_t *tok, int cond)
+{
+  if( tok == 0 )
+  {
+    return 0;
+  }
+
+  switch( tok->tok_code )
+  {
+  case tc_set:
+    return cond || calc_branch_sets(tok->tok_arg2, cond);
+
+  case tc_and:
+  case tc_or:
+  case tc_opt:
+  case tc_op1:
+    return (calc_branch_sets(tok->tok_arg1, cond) ||
+            calc_branch_sets(tok->tok_arg2, 1));
+
+  default:
+    return (calc_branch_sets(tok->tok_arg1, cond) ||
+            calc_branch_sets(tok->tok_arg2, cond));
+  }
+}
+
+int calc_sets_conditionally(calc_t *self)
+{
+  return calc_branch_sets(calc_root(self), 0);
+}
+
 /* ========================================================================= *
  * test main
  * ========================================================================= */
@@ -176,6 +176,8 @@ struct calc_t
   void   (*calc_setvar)(calc_t *self, void *user, calctok_t *tok);
 
   void    *calc_userdata; /* data to pass to above hooks */
+
+  int       calc_quiet;    /* do not report compilation errors */
 };
 
 /* ------------------------------------------------------------------------- *
@@ -189,6 +191,8 @@ calc_t *calc_create(void);
 int calc_compile(calc_t *self, const char *expr);
 double calc_evaluate(calc_t *self);
 double calc_compile_and_evaluate(calc_t *self, const char *expr);
+void calc_reserve(calc_t *self, csv_t *csv);
+int calc_sets_conditionally(calc_t *self);
 
 const char *calctok_getsymbol(const calctok_t *self);
 
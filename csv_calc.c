@@ -114,6 +114,10 @@ csv_calc_t *csv_calc_create(csv_t *table, const char *expr)
     csv_calc_delete(self);
     self = 0;
   }
+  else
+  {
+    calc_reserve(self->calc, table);
+  }
 
   return self;
 }
@@ -42,6 +42,7 @@
  * ========================================================================= */
 
 #include <stddef.h>
+#include <string.h>
 #include <math.h>
 #include <float.h>
 
@@ -51,10 +52,154 @@
 #if 1
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
+
+/* ------------------------------------------------------------------------- *
+ * csv_float_parse  --  strtod() compatible number parsing
+ *
+ * Plain decimal numbers with at most 19 significant digits are
+ * parsed to 64 bit integer mantissa and decimal exponent. If both
+ * mantissa and power of ten are exactly representable as doubles,
+ * a single multiplication / division gives the correctly rounded
+ * result (Clinger's fast path). Everything else (hex, inf, nan,
+ * long mantissas, large exponents) is handed over to strtod().
+ *
+ * The parse position is left exactly where strtod() would leave it.
+ * ------------------------------------------------------------------------- */
+
+static const double csv_float_pow10[] =
+{
+  1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+  1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+  1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
 double csv_float_parse(const char **ppos)
 {
+  const char *pos = *ppos;
+  const char *dig;
+  int         neg = 0;
+  uint64_t    man = 0;
+  int         cnt = 0;
+  int         exp = 0;
+  double      val;
+
+  switch( *pos )
+  {
+  case '-': neg = 1; // fall through
+  case '+': ++pos;   break;
+  }
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * hex floats are left for strtod
+   * - - - - - - - - - - - - - - - - - - - */
+
+  if( pos[0] == '0' && (pos[1] == 'x' || pos[1] == 'X') )
+  {
+    goto fallback;
+  }
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * mantissa: leading zeros are skipped
+   * and do not count as significant
+   * - - - - - - - - - - - - - - - - - - - */
+
+  dig = pos;
+
+  for( ; (unsigned)(*pos - '0') < 10; ++pos )
+  {
+    if( man == 0 && *pos == '0' ) continue;
+    if( ++cnt > 19 ) goto fallback;
+    man = man * 10 + (*pos - '0');
+  }
+
+  if( *pos == '.' )
+  {
+    for( ++pos; (unsigned)(*pos - '0') < 10; ++pos )
+    {
+      exp -= 1;
+      if( man == 0 && *pos == '0' ) continue;
+      if( ++cnt > 19 ) goto fallback;
+      man = man * 10 + (*pos - '0');
+    }
+    if( pos - dig == 1 )
+    {
+      /* lone '.', or inf / nan */
+      goto fallback;
+    }
+  }
+
+  if( pos == dig )
+  {
+    goto fallback;
+  }
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * exponent is consumed only if there
+   * are digits after optional sign
+   * - - - - - - - - - - - - - - - - - - - */
+
+  if( *pos == 'e' || *pos == 'E' )
+  {
+    const char *tmp = pos + 1;
+    int         esg = 1;
+    int         eval = 0;
+
+    switch( *tmp )
+    {
+    case '-': esg = -1; // fall through
+    case '+': ++tmp;    break;
+    }
+
+    if( (unsigned)(*tmp - '0') < 10 )
+    {
+      for( ; (unsigned)(*tmp - '0') < 10; ++tmp )
+      {
+        if( eval < 100000 ) eval = eval * 10 + (*tmp - '0');
+      }
+      exp += esg * eval;
+      pos = tmp;
+    }
+  }
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * exact conversion if possible
+   * - - - - - - - - - - - - - - - - - - - */
+
+  if( man == 0 )
+  {
+    val = 0.0;
+  }
+  else if( man > (UINT64_C(1) << 53) )
+  {
+    goto fallback;
+  }
+  else if( exp == 0 )
+  {
+    val = (double)man;
+  }
+#if FLT_EVAL_METHOD == 0
+  else if( 0 < exp && exp <= 22 )
+  {
+    val = (double)man * csv_float_pow10[exp];
+  }
+  else if( -22 <= exp && exp < 0 )
+  {
+    val = (double)man / csv_float_pow10[-exp];
+  }
+#endif
+  else
+  {
+    goto fallback;
+  }
+
+  *ppos = pos;
+  return neg ? -val : val;
+
+  fallback:
   return strtod((char *)*ppos, (char **)ppos);
 }
+
 char *csv_float_to_string(double num, char *buff, size_t size)
 {
   //snprintf(buff, size, "%.11e", num);
@@ -414,13 +559,245 @@ char *csv_float_to_string(double num, char *buff, size_t size)
 }
 #endif
 
+/* ------------------------------------------------------------------------- *
+ * csv_int_parse  --  parse plain decimal integer
+ *
+ * Accepts optional sign followed by digits. Returns 0 and advances the
+ * parse position if the value fits in 64 bits, or -1 without touching
+ * the position otherwise.
+ * ------------------------------------------------------------------------- */
+
+int csv_int_parse(const char **ppos, int64_t *pval)
+{
+  const char *pos = *ppos;
+  int         neg = 0;
+  uint64_t    val = 0;
+  uint64_t    max = INT64_MAX;
+
+  switch( *pos )
+  {
+  case '-': neg = 1, max += 1; // fall through
+  case '+': ++pos;             break;
+  }
+
+  if( (unsigned)(*pos - '0') >= 10 )
+  {
+    return -1;
+  }
+
+  for( ; (unsigned)(*pos - '0') < 10; ++pos )
+  {
+    unsigned dig = *pos - '0';
+
+    if( val > (max - dig) / 10 )
+    {
+      return -1;
+    }
+    val = val * 10 + dig;
+  }
+
+  *ppos = pos;
+  *pval = neg ? (int64_t)(0 - val) : (int64_t)val;
+  return 0;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_int_to_string  --  format 64 bit integer
+ *
+ * Digits are produced two at a time from a lookup table, which is
+ * several times faster than snprintf(). The buffer must have room
+ * for 21 characters.
+ * ------------------------------------------------------------------------- */
+
+char *csv_int_to_string(int64_t num, char *buff, size_t size)
+{
+  static const char pairs[] =
+    "00010203040506070809" "10111213141516171819"
+    "20212223242526272829" "30313233343536373839"
+    "40414243444546474849" "50515253545556575859"
+    "60616263646566676869" "70717273747576777879"
+    "80818283848586878889" "90919293949596979899";
+
+  char     tmp[24];
+  char    *pos = tmp + sizeof tmp;
+  uint64_t val = (num < 0) ? (0 - (uint64_t)num) : (uint64_t)num;
+
+  *--pos = 0;
+
+  while( val >= 100 )
+  {
+    unsigned i = (unsigned)(val % 100) * 2;
+    val /= 100;
+    *--pos = pairs[i + 1];
+    *--pos = pairs[i + 0];
+  }
+  if( val >= 10 )
+  {
+    unsigned i = (unsigned)val * 2;
+    *--pos = pairs[i + 1];
+    *--pos = pairs[i + 0];
+  }
+  else
+  {
+    *--pos = '0' + (unsigned)val;
+  }
+  if( num < 0 )
+  {
+    *--pos = '-';
+  }
+
+  size_t len = tmp + sizeof tmp - pos;
+
+  if( len > size )
+  {
+    len = size, pos[len - 1] = 0;
+  }
+  return memcpy(buff, pos, len);
+}
+
 #ifdef TESTMAIN
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <time.h>
+
+/* random number text, biased towards what track files contain */
+static void fuzz_text(char *buff, size_t size)
+{
+  static const char *const odd[] =
+  {
+    "inf", "-Infinity", "nan", "NAN(123)", "0x1p3", "-0X1.8P-2", "0x",
+    ".", "-.", "+", "-", "e5", ".e5", "1e", "1e+", "1E-x", "-0", "+0.0",
+    "00000000000000000000000000000001", "9007199254740993",
+    "9007199254740992", "18446744073709551616", "1e22", "1e23",
+    "4.9406564584124654e-324", "2.2250738585072014e-308",
+    "1.7976931348623157e308", "1e400", "1e-400", "123456789012345678901",
+    "0.1e-22", "1.5e-22", "3.14159265358979323846264338327950288",
+  };
+
+  char *pos = buff;
+  char *end = buff + size - 32;
+
+  switch( rand() % 8 )
+  {
+  case 0:
+    snprintf(buff, size, "%s", odd[rand() % (sizeof odd / sizeof *odd)]);
+    pos = strchr(buff, 0);
+    break;
+
+  case 1:
+    pos += sprintf(pos, "%.*g", 1 + rand() % 17,
+                   ldexp((double)rand() / RAND_MAX, rand() % 400 - 200));
+    break;
+
+  default:
+    if( rand() % 4 == 0 ) *pos++ = "+-"[rand() % 2];
+    for( int n = rand() % 22; n-- > 0 && pos < end; )
+      *pos++ = '0' + rand() % 10;
+    if( rand() % 2 )
+    {
+      *pos++ = '.';
+      for( int n = rand() % 22; n-- > 0 && pos < end; )
+        *pos++ = '0' + rand() % 10;
+    }
+    if( rand() % 4 == 0 )
+    {
+      pos += sprintf(pos, "%c%s%d", "eE"[rand() % 2],
+                     (const char *[]){"", "+", "-"}[rand() % 3],
+                     rand() % 40);
+    }
+    break;
+  }
+
+  /* trailing garbage */
+  if( rand() % 4 == 0 )
+  {
+    *pos++ = ",;\ta.e-x"[rand() % 9];
+  }
+  *pos = 0;
+}
+
+/* bit exact comparison against strtod, including end position */
+static int fuzz_test(int rounds)
+{
+  char txt[256];
+
+  for( int i = 0; i < rounds; ++i )
+  {
+    char       *ref_end = 0;
+    const char *pos     = txt;
+
+    fuzz_text(txt, sizeof txt);
+
+    double ref = strtod(txt, &ref_end);
+    double val = csv_float_parse(&pos);
+
+    if( pos != ref_end || (memcmp(&ref, &val, sizeof ref) &&
+                           !(isnan(ref) && isnan(val))) )
+    {
+      printf("fuzz: '%s' -> %.17g/%d, strtod %.17g/%d\n", txt,
+             val, (int)(pos - txt), ref, (int)(ref_end - txt));
+      return -1;
+    }
+  }
+  return 0;
+}
+
+static double bench_time(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* parse speed of typical track data values: integers & short decimals */
+static void bench(void)
+{
+  enum { N = 1 << 20 };
+  char  *text = malloc(N * 16);
+  char **item = malloc(N * sizeof *item);
+  char  *pos  = text;
+
+  for( int i = 0; i < N; ++i )
+  {
+    item[i] = pos;
+    if( i & 1 )
+      pos += sprintf(pos, "%d", rand() % 10000000) + 1;
+    else
+      pos += sprintf(pos, "%.3f", rand() / 1000.0) + 1;
+  }
+
+  for( int k = 0; k < 2; ++k )
+  {
+    double best = 1e9, sum = 0;
+
+    for( int r = 0; r < 5; ++r )
+    {
+      double t0 = bench_time();
+      for( int i = 0; i < N; ++i )
+      {
+        const char *p = item[i];
+        sum += k ? csv_float_parse(&p) : strtod(p, 0);
+      }
+      double t1 = bench_time();
+      if( best > t1 - t0 ) best = t1 - t0;
+    }
+    printf("%-16s %6.1f ns/value (%g)\n",
+           k ? "csv_float_parse" : "strtod", best * 1e9 / N, sum);
+  }
+  free(item);
+  free(text);
+}
+
 int main(int ac, char **av)
 {
+  if( fuzz_test(10 * 1000 * 1000) != 0 )
+  {
+    exit(1);
+  }
+  bench();
+
   enum { N = 1024*4, LO = -32, HI = 32 };
   double *data = calloc(N, sizeof *data);
 
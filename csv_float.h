@@ -37,6 +37,9 @@
 #ifndef CSV_FLOAT_H_
 #define CSV_FLOAT_H_
 
+#include <stddef.h>
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #elif 0
@@ -46,6 +49,8 @@ extern "C" {
 /* csv_float.c */
 double csv_float_parse(const char **ppos);
 char *csv_float_to_string(double num, char *buff, size_t size);
+int csv_int_parse(const char **ppos, int64_t *pval);
+char *csv_int_to_string(int64_t num, char *buff, size_t size);
 
 #ifdef __cplusplus
 };
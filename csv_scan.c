@@ -0,0 +1,447 @@
+/*
+ * This file is part of libsysperf
+ *
+ * Copyright (C) 2026 libsysperf contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+/* ========================================================================= *
+ * File: csv_scan.c
+ *
+ * -------------------------------------------------------------------------
+ *
+ * Block scanner for CSV data, see csv_scan.h
+ *
+ * The block mask is computed with AVX2 or SSE2 instructions when
+ * the cpu supports them, otherwise a portable SWAR version is used.
+ * The implementation is selected once at startup.
+ * ========================================================================= */
+
+/* ========================================================================= *
+ * Include Files
+ * ========================================================================= */
+
+#include <string.h>
+
+#include "csv_scan.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define CSV_SCAN_X86 1
+# include <immintrin.h>
+#else
+# define CSV_SCAN_X86 0
+#endif
+
+/* ========================================================================= *
+ * Block Mask Implementations
+ * ========================================================================= */
+
+typedef uint64_t (*csv_scan_fn)(const char *blk, int sep);
+
+/* ------------------------------------------------------------------------- *
+ * csv_scan_swar8  --  mask of interesting bytes in 8 byte word
+ * ------------------------------------------------------------------------- */
+
+static inline unsigned csv_scan_swar8(uint64_t v, uint64_t sep)
+{
+  static const uint64_t lo = 0x7f7f7f7f7f7f7f7fULL;
+  static const uint64_t nl = 0x0a0a0a0a0a0a0a0aULL;
+  static const uint64_t cr = 0x0d0d0d0d0d0d0d0dULL;
+
+  uint64_t t, z = 0;
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * exact zero byte test: high bit is set
+   * for bytes that are equal to zero
+   * - - - - - - - - - - - - - - - - - - - */
+
+  t = v;        z |= ~(((t & lo) + lo) | t | lo);
+  t = v ^ nl;   z |= ~(((t & lo) + lo) | t | lo);
+  t = v ^ cr;   z |= ~(((t & lo) + lo) | t | lo);
+  t = v ^ sep;  z |= ~(((t & lo) + lo) | t | lo);
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * gather high bits to the low byte
+   * - - - - - - - - - - - - - - - - - - - */
+
+  return (unsigned)(((z >> 7) * 0x0102040810204080ULL) >> 56);
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_scan_block_scalar
+ * ------------------------------------------------------------------------- */
+
+static uint64_t csv_scan_block_scalar(const char *blk, int sep)
+{
+  uint64_t s = 0x0101010101010101ULL * (unsigned char)sep;
+  uint64_t m = 0;
+
+  for( int i = 0; i < CSV_SCAN_BLOCK; i += 8 )
+  {
+    uint64_t v;
+    memcpy(&v, blk + i, sizeof v);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    m |= (uint64_t)csv_scan_swar8(v, s) << i;
+  }
+  return m;
+}
+
+#if CSV_SCAN_X86
+/* ------------------------------------------------------------------------- *
+ * csv_scan_block_sse2
+ * ------------------------------------------------------------------------- */
+
+__attribute__((target("sse2")))
+static uint64_t csv_scan_block_sse2(const char *blk, int sep)
+{
+  const __m128i s  = _mm_set1_epi8((char)sep);
+  const __m128i nl = _mm_set1_epi8('\n');
+  const __m128i cr = _mm_set1_epi8('\r');
+  const __m128i nul = _mm_setzero_si128();
+
+  uint64_t m = 0;
+
+  for( int i = 0; i < CSV_SCAN_BLOCK; i += 16 )
+  {
+    __m128i v = _mm_loadu_si128((const __m128i *)(blk + i));
+    __m128i e = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, s),
+                                          _mm_cmpeq_epi8(v, nl)),
+                             _mm_or_si128(_mm_cmpeq_epi8(v, cr),
+                                          _mm_cmpeq_epi8(v, nul)));
+    m |= (uint64_t)(unsigned)_mm_movemask_epi8(e) << i;
+  }
+  return m;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_scan_block_avx2
+ * ------------------------------------------------------------------------- */
+
+__attribute__((target("avx2")))
+static uint64_t csv_scan_block_avx2(const char *blk, int sep)
+{
+  const __m256i s  = _mm256_set1_epi8((char)sep);
+  const __m256i nl = _mm256_set1_epi8('\n');
+  const __m256i cr = _mm256_set1_epi8('\r');
+  const __m256i nul = _mm256_setzero_si256();
+
+  uint64_t m = 0;
+
+  for( int i = 0; i < CSV_SCAN_BLOCK; i += 32 )
+  {
+    __m256i v = _mm256_loadu_si256((const __m256i *)(blk + i));
+    __m256i e = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, s),
+                                                _mm256_cmpeq_epi8(v, nl)),
+                                _mm256_or_si256(_mm256_cmpeq_epi8(v, cr),
+                                                _mm256_cmpeq_epi8(v, nul)));
+    m |= (uint64_t)(unsigned)_mm256_movemask_epi8(e) << i;
+  }
+  return m;
+}
+#endif
+
+/* ========================================================================= *
+ * Implementation Selection
+ * ========================================================================= */
+
+static const struct
+{
+  const char  *name;
+  csv_scan_fn  func;
+} csv_scan_lut[] =
+{
+#if CSV_SCAN_X86
+  { "avx2",   csv_scan_block_avx2   },
+  { "sse2",   csv_scan_block_sse2   },
+#endif
+  { "scalar", csv_scan_block_scalar },
+};
+
+static const char  *csv_scan_name  = "scalar";
+static csv_scan_fn  csv_scan_block = csv_scan_block_scalar;
+
+/* ------------------------------------------------------------------------- *
+ * csv_scan_usable  --  check if cpu supports named implementation
+ * ------------------------------------------------------------------------- */
+
+static int csv_scan_usable(const char *name)
+{
+#if CSV_SCAN_X86
+  __builtin_cpu_init();
+  if( !strcmp(name, "avx2") ) return __builtin_cpu_supports("avx2");
+  if( !strcmp(name, "sse2") ) return __builtin_cpu_supports("sse2");
+#endif
+  return !strcmp(name, "scalar");
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_scan_select  --  force use of named implementation, or best if NULL
+ * ------------------------------------------------------------------------- */
+
+int csv_scan_select(const char *name)
+{
+  size_t n = sizeof csv_scan_lut / sizeof *csv_scan_lut;
+
+  for( size_t i = 0; i < n; ++i )
+  {
+    if( name != 0 && strcmp(name, csv_scan_lut[i].name) )
+    {
+      continue;
+    }
+    if( csv_scan_usable(csv_scan_lut[i].name) )
+    {
+      csv_scan_name  = csv_scan_lut[i].name;
+      csv_scan_block = csv_scan_lut[i].func;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_scan_impl  --  name of implementation in use
+ * ------------------------------------------------------------------------- */
+
+const char *csv_scan_impl(void)
+{
+  return csv_scan_name;
+}
+
+static void csv_scan_ctor(void) __attribute__((constructor));
+
+static void csv_scan_ctor(void)
+{
+  csv_scan_select(0);
+}
+
+/* ========================================================================= *
+ * Scanner
+ * ========================================================================= */
+
+/* ------------------------------------------------------------------------- *
+ * csv_scan_mask  --  compute mask for block starting at given offset
+ * ------------------------------------------------------------------------- */
+
+uint64_t csv_scan_mask(csv_scan_t *self, size_t base)
+{
+  size_t todo = self->cs_size - base;
+
+  if( todo >= CSV_SCAN_BLOCK )
+  {
+    return csv_scan_block(self->cs_data + base, self->cs_sep);
+  }
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * partial block at end of data: must
+   * not read past the end, the data might
+   * be at the end of a mapping
+   * - - - - - - - - - - - - - - - - - - - */
+
+  char blk[CSV_SCAN_BLOCK];
+
+  memset(blk, (self->cs_sep == 'x') ? 'y' : 'x', sizeof blk);
+  memcpy(blk, self->cs_data + base, todo);
+
+  return csv_scan_block(blk, self->cs_sep) & ((1ULL << todo) - 1);
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_scan_init  --  start scanning data
+ * ------------------------------------------------------------------------- */
+
+void csv_scan_init(csv_scan_t *self, const char *data, size_t size, int sep)
+{
+  self->cs_data = data;
+  self->cs_size = size;
+  self->cs_base = (size_t)0 - CSV_SCAN_BLOCK;
+  self->cs_bits = 0;
+  self->cs_sep  = sep;
+}
+
+#ifdef TESTMAIN
+/* ========================================================================= *
+ * Microbenchmark: bytes/second for narrow & wide tables, compared
+ * against the byte at a time switch loop previously used for
+ * slicing lines in csv_table.c
+ *
+ *   cc -DTESTMAIN -std=c99 -D_GNU_SOURCE -O2 csv_scan.c
+ * ========================================================================= */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static double bench_time(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static char *bench_table(int cols, size_t size, size_t *plen)
+{
+  char  *data = malloc(size + 256);
+  size_t used = 0;
+
+  srand(cols);
+
+  while( used < size )
+  {
+    for( int c = 0; c < cols; ++c )
+    {
+      const char *sep = (c == cols - 1) ? "\n" : ",";
+      if( c & 1 )
+        used += sprintf(data + used, "name%d%s", rand() % 1000, sep);
+      else
+        used += sprintf(data + used, "%d%s", rand() % 100000, sep);
+    }
+  }
+  *plen = used;
+  return data;
+}
+
+/* old parser_slice switch loop + memchr for line end */
+static uint64_t bench_bytewise(const char *data, size_t size, int sep)
+{
+  const char *pos = data;
+  const char *end = data + size;
+  uint64_t    sum = 0;
+
+  while( pos < end )
+  {
+    const char *eol = memchr(pos, '\n', end - pos);
+    const char *col = pos;
+
+    for( ;; )
+    {
+      switch( (pos < eol) ? *pos : 0 )
+      {
+      case '\t': case ',': case ';':
+        if( *pos == sep )
+        {
+          sum += pos - col;
+          col = ++pos;
+          break;
+        }
+      default:
+        ++pos;
+        break;
+
+      case 0x00: case '\r': case '\n':
+        sum += pos - col;
+        goto next;
+      }
+    }
+    next:
+    pos = eol + 1;
+  }
+  return sum;
+}
+
+static uint64_t bench_blockwise(const char *data, size_t size, int sep)
+{
+  csv_scan_t  scan;
+  const char *col = data;
+  uint64_t    sum = 0;
+  size_t      offs;
+
+  csv_scan_init(&scan, data, size, sep);
+
+  while( (offs = csv_scan_next(&scan)) < size )
+  {
+    sum += data + offs - col;
+    col  = data + offs + 1;
+  }
+  return sum;
+}
+
+/* check all implementations against byte at a time reference */
+static int bench_verify(const char *impl)
+{
+  static const char alpha[] = "ab,;\t\r\n\0\x80\xff";
+
+  char blk[CSV_SCAN_BLOCK + 7];
+
+  for( int k = 0; k < 100000; ++k )
+  {
+    int sep = ",;\t"[k % 3];
+    uint64_t ref = 0;
+
+    for( int i = 0; i < CSV_SCAN_BLOCK; ++i )
+    {
+      blk[i] = alpha[rand() % (sizeof alpha - 1)];
+      if( blk[i] == sep || blk[i] == '\n' || blk[i] == '\r' || blk[i] == 0 )
+        ref |= 1ULL << i;
+    }
+    if( csv_scan_block(blk, sep) != ref )
+    {
+      printf("%s: mask mismatch\n", impl);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+int main(int ac, char **av)
+{
+  static const int cols[] = { 4, 128 };
+  static const char *impl[] = { "scalar", "sse2", "avx2" };
+
+  for( int i = 0; i < 3; ++i )
+  {
+    if( csv_scan_select(impl[i]) == 0 && bench_verify(impl[i]) != 0 )
+    {
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  for( int t = 0; t < 2; ++t )
+  {
+    size_t len  = 0;
+    char  *data = bench_table(cols[t], 64 << 20, &len);
+    double t0, t1, best;
+    uint64_t ref = 0, sum = 0;
+
+    best = 1e9;
+    for( int k = 0; k < 3; ++k )
+    {
+      t0 = bench_time(), ref = bench_bytewise(data, len, ','), t1 = bench_time();
+      if( best > t1 - t0 ) best = t1 - t0;
+    }
+    printf("%3d cols  %-8s %8.1f MB/s\n", cols[t], "bytewise",
+           len / best * 1e-6);
+
+    for( int i = 0; i < 3; ++i )
+    {
+      if( csv_scan_select(impl[i]) != 0 ) continue;
+
+      best = 1e9;
+      for( int k = 0; k < 3; ++k )
+      {
+        t0 = bench_time(), sum = bench_blockwise(data, len, ','), t1 = bench_time();
+        if( best > t1 - t0 ) best = t1 - t0;
+      }
+      printf("%3d cols  %-8s %8.1f MB/s%s\n", cols[t], impl[i],
+             len / best * 1e-6, (sum == ref) ? "" : "  MISMATCH");
+    }
+    free(data);
+  }
+  return 0;
+}
+#endif
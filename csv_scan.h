@@ -0,0 +1,95 @@
+/*
+ * This file is part of libsysperf
+ *
+ * Copyright (C) 2026 libsysperf contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+/* ========================================================================= *
+ * File: csv_scan.h
+ *
+ * -------------------------------------------------------------------------
+ *
+ * Block scanner for locating field separators and line breaks in
+ * CSV data. The data is processed 64 bytes at a time, producing
+ * a bitmask of interesting positions within the block. Positions
+ * are then handed out in order by csv_scan_next().
+ *
+ * Interesting bytes are: the separator, '\n', '\r' and '\0'.
+ * ========================================================================= */
+
+#ifndef CSV_SCAN_H_
+#define CSV_SCAN_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#elif 0
+} /* fool JED indentation ... */
+#endif
+
+enum { CSV_SCAN_BLOCK = 64 };
+
+typedef struct csv_scan_t csv_scan_t;
+
+struct csv_scan_t
+{
+  const char *cs_data;  // data to scan
+  size_t      cs_size;  // bytes of data
+  size_t      cs_base;  // offset of current block
+  uint64_t    cs_bits;  // positions not yet returned in current block
+  int         cs_sep;   // field separator
+};
+
+/* csv_scan.c */
+const char *csv_scan_impl(void);
+int csv_scan_select(const char *name);
+uint64_t csv_scan_mask(csv_scan_t *self, size_t base);
+void csv_scan_init(csv_scan_t *self, const char *data, size_t size, int sep);
+
+/* ------------------------------------------------------------------------- *
+ * csv_scan_next  --  offset of next interesting byte, or size at end
+ * ------------------------------------------------------------------------- */
+
+static inline size_t csv_scan_next(csv_scan_t *self)
+{
+  size_t offs;
+
+  while( self->cs_bits == 0 )
+  {
+    self->cs_base += CSV_SCAN_BLOCK;
+
+    if( self->cs_base >= self->cs_size )
+    {
+      self->cs_base = self->cs_size;
+      return self->cs_size;
+    }
+    self->cs_bits = csv_scan_mask(self, self->cs_base);
+  }
+
+  offs = self->cs_base + __builtin_ctzll(self->cs_bits);
+  self->cs_bits &= self->cs_bits - 1;
+  return offs;
+}
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif /* CSV_SCAN_H_ */
@@ -94,10 +94,15 @@
 #include "calculator.h"
 #include "csv_table.h"
 #include "csv_float.h"
+#include "reader.h"
+#include "csv_scan.h"
 
 // QUARANTINE #include <assert.h>
 #include <float.h>
+#include <limits.h>
 #include <math.h>
+#include <sys/stat.h>
+#include <pthread.h>
 
 #define DEBUG_CSVTEXT 0
 
@@ -192,148 +197,433 @@ csvvar_setval(csvvar_t *self, const char *val)
  * csvtext_t  --  methods
  * ========================================================================= */
 
-enum { HSIZE = 16 << 10, HMASK = HSIZE - 1 };
-static csvtext_t *csvtext_slot[HSIZE];
-static size_t     csvtext_uniq;
-static size_t     csvtext_adds;
+/* - - - - - - - - - - - - - - - - - - - *
+ * interned strings are spread over a
+ * fixed number of shards by hash value;
+ * each shard has a lock of its own, a
+ * chain table that doubles in size when
+ * it gets full and a memory pool the
+ * entries are allocated from
+ * - - - - - - - - - - - - - - - - - - - */
+
+enum
+{
+  CSVTEXT_SHARDS = 16,        // power of two
+  CSVTEXT_SLOTS  = 256,       // initial chains per shard
+  CSVTEXT_CHUNK  = 64 << 10,  // entry pool chunk size
+};
+
+typedef struct
+{
+  pthread_mutex_t  tb_mutex;
+  csvtext_t      **tb_slot;
+  size_t           tb_mask;   // chains - 1
+  size_t           tb_uniq;   // entries in chains
+  size_t           tb_adds;   // intern requests
+  size_t           tb_text;   // text bytes in entries
+  mem_pool_t       tb_pool;   // entry storage
+} csvtextshard_t;
+
+struct csvtextpool_t
+{
+  csvtextshard_t tp_shard[CSVTEXT_SHARDS];
+};
+
+static csvtextpool_t  csvtext_default;
+static csvtextpool_t *csvtext_pool = &csvtext_default;
 
 const char csvtext_empty[] = "";
 
 /* ------------------------------------------------------------------------- *
- * csvtext_statistics  --  string intern hash table statistics
+ * csvtext_checkaddr  --  abort if string can not be stored in a cell
+ *
+ * Cells hold string pointers in the bits below CSVCELL_TAG_MASK, see
+ * csv_table.h. Storage for such strings is checked when allocated.
  * ------------------------------------------------------------------------- */
 
-#if DEBUG_CSVTEXT
-static void csvtext_statistics(void) __attribute__((destructor));
-
 static void
-csvtext_statistics(void)
+csvtext_checkaddr(const char *text)
 {
-  fprintf(stderr, "--\n");
-  fprintf(stderr, "%s: %Zd unique strings\n", __FUNCTION__, csvtext_uniq);
-  fprintf(stderr, "%s: %Zd added  strings\n", __FUNCTION__, csvtext_adds);
-  fprintf(stderr, "--\n");
+  if( ((uintptr_t)text & CSVCELL_TAG_MASK) != 0 )
+  {
+    msg_error("string address %p does not fit in a table cell\n", text);
+    abort();
+  }
 }
-#endif
 
 /* ------------------------------------------------------------------------- *
- * csvtext_release  --  release all interned strings
+ * csvtextpool_ctor
  * ------------------------------------------------------------------------- */
 
-static void csvtext_release(void) __attribute__((destructor));
+static void
+csvtextpool_ctor(csvtextpool_t *self)
+{
+  for( int i = 0; i < CSVTEXT_SHARDS; ++i )
+  {
+    csvtextshard_t *shard = &self->tp_shard[i];
+
+    pthread_mutex_init(&shard->tb_mutex, 0);
+    shard->tb_slot = calloc(CSVTEXT_SLOTS, sizeof *shard->tb_slot);
+    if ( shard->tb_slot == NULL ) abort();
+    shard->tb_mask = CSVTEXT_SLOTS - 1;
+    shard->tb_uniq = 0;
+    shard->tb_adds = 0;
+    shard->tb_text = 0;
+    mem_pool_ctor(&shard->tb_pool);
+    shard->tb_pool.alloc = CSVTEXT_CHUNK;
+  }
+}
+
+/* ------------------------------------------------------------------------- *
+ * csvtextpool_dtor
+ * ------------------------------------------------------------------------- */
 
 static void
-csvtext_release(void)
+csvtextpool_dtor(csvtextpool_t *self)
 {
-  for( int h = 0; h < HSIZE; ++h )
+  for( int i = 0; i < CSVTEXT_SHARDS; ++i )
   {
-    csvtext_t *t;
+    csvtextshard_t *shard = &self->tp_shard[i];
 
-    while( (t = csvtext_slot[h]) != 0 )
-    {
-      csvtext_slot[h] = t->ct_next;
-      free(t);
-    }
+    mem_pool_dtor(&shard->tb_pool);
+    free(shard->tb_slot), shard->tb_slot = 0;
+    pthread_mutex_destroy(&shard->tb_mutex);
   }
 }
 
 /* ------------------------------------------------------------------------- *
- * csvtext_global_replace_char_hack  --  ploticus & categories ....
+ * csvtextpool_create  --  string interner with private storage
+ *
+ * Strings interned while the pool is selected with csvtext_setpool()
+ * stay valid until the pool is deleted, so that long running processes
+ * can release the strings of tables they are done with.
+ * ------------------------------------------------------------------------- */
+
+csvtextpool_t *
+csvtextpool_create(void)
+{
+  csvtextpool_t *self = calloc(1, sizeof *self);
+  if ( self == NULL ) abort();
+  csvtextpool_ctor(self);
+  return self;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csvtextpool_delete  --  release pool and all strings interned in it
  * ------------------------------------------------------------------------- */
 
 void
-csvtext_global_replace_char_hack(int from, int to)
+csvtextpool_delete(csvtextpool_t *self)
 {
-  for( int h = 0; h < HSIZE; ++h )
+  if( self != 0 && self != &csvtext_default )
   {
-    for( csvtext_t *t = csvtext_slot[h]; t; t = t->ct_next )
+    if( csvtext_pool == self )
     {
-      for( char *s = t->ct_text; *s; ++ s)
-      {
-        if( *s == from ) *s = to;
-      }
+      csvtext_pool = &csvtext_default;
     }
+    csvtextpool_dtor(self);
+    free(self);
   }
 }
 
 /* ------------------------------------------------------------------------- *
- * csvtext_intern  --  intern a string
+ * csvtextpool_grow  --  double the chains of a shard
  * ------------------------------------------------------------------------- */
 
-const char *
-csvtext_intern(const char *text)
+static void
+csvtextpool_grow(csvtextshard_t *shard)
 {
-  char    *r = 0;
-  char    *w = 0;
-  char    *s = 0;
-  size_t   n = 0;
+  size_t      mask = shard->tb_mask * 2 + 1;
+  csvtext_t **slot = calloc(mask + 1, sizeof *slot);
 
-  /* - - - - - - - - - - - - - - - - - - - *
-   * zero pad text to multiple of four size
-   * work space for short strings taken from
-   * stack, larger ones from heap
-   * - - - - - - - - - - - - - - - - - - - */
+  if ( slot == NULL ) abort();
 
-  if( (n = (strlen(text) + 1u + 3u) & ~3u) < 256 )
-  {
-    s = alloca(n);
-  }
-  else
+  for( size_t h = 0; h <= shard->tb_mask; ++h )
   {
-    s = w = malloc(n);
+    csvtext_t *t;
+
+    while( (t = shard->tb_slot[h]) != 0 )
+    {
+      shard->tb_slot[h] = t->ct_next;
+      t->ct_next = slot[t->ct_hash & mask];
+      slot[t->ct_hash & mask] = t;
+    }
   }
 
-  strncpy(s, text, n);
+  free(shard->tb_slot);
+  shard->tb_slot = slot;
+  shard->tb_mask = mask;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csvtextpool_intern  --  intern a string of given length in a pool
+ * ------------------------------------------------------------------------- */
 
+const char *
+csvtextpool_intern(csvtextpool_t *self, const char *text, size_t size)
+{
   /* - - - - - - - - - - - - - - - - - - - *
-   * hash table management
+   * the text does not need to be zero
+   * terminated, so that cells can be
+   * interned directly from mmapped input
+   *
+   * top bits of the hash select the shard
+   * and low bits the chain within it
    * - - - - - - - - - - - - - - - - - - - */
 
-  uint32_t h = jhash2((uint32_t*)s, n/4, 0);
+  uint32_t        h     = jhash(text, size, 0);
+  csvtextshard_t *shard = &self->tp_shard[h >> 28 & (CSVTEXT_SHARDS - 1)];
+  csvtext_t      *p     = 0;
+
+  pthread_mutex_lock(&shard->tb_mutex);
 
-  for( csvtext_t *p = csvtext_slot[h & HMASK]; ; p = p->ct_next )
+  for( p = shard->tb_slot[h & shard->tb_mask]; p != 0; p = p->ct_next )
   {
-    if( p == 0 )
+    if( p->ct_hash == h && p->ct_size == size &&
+        !memcmp(p->ct_text, text, size) )
     {
       /* - - - - - - - - - - - - - - - - - - - *
-       * add new entry
+       * use existing entry
        * - - - - - - - - - - - - - - - - - - - */
 
-      p = malloc(sizeof *p + n);
-      p->ct_next = csvtext_slot[h & HMASK];
-      p->ct_hash = h;
-      p->ct_size = n;
-      memcpy(p->ct_text, s, n);
-      csvtext_slot[h & HMASK] = p;
-      r = p->ct_text;
-
-      csvtext_uniq += 1;
       break;
     }
+  }
+
+  if( p == 0 )
+  {
+    /* - - - - - - - - - - - - - - - - - - - *
+     * add new entry, keep the average
+     * chain length at most one
+     * - - - - - - - - - - - - - - - - - - - */
 
-    if( p->ct_hash == h && p->ct_size == n && !memcmp(p->ct_text, s, n) )
+    if( shard->tb_uniq > shard->tb_mask )
     {
-      /* - - - - - - - - - - - - - - - - - - - *
-       * use existing entry
-       * - - - - - - - - - - - - - - - - - - - */
+      csvtextpool_grow(shard);
+    }
 
-      r = p->ct_text;
-      break;
+    p = mem_pool_alloc(&shard->tb_pool, sizeof *p + size + 1);
+    csvtext_checkaddr(p->ct_text);
+    p->ct_next = shard->tb_slot[h & shard->tb_mask];
+    p->ct_hash = h;
+    p->ct_size = size;
+    memcpy(p->ct_text, text, size);
+    p->ct_text[size] = 0;
+    shard->tb_slot[h & shard->tb_mask] = p;
+
+    shard->tb_uniq += 1;
+    shard->tb_text += size + 1;
+  }
+
+  shard->tb_adds += 1;
+
+  pthread_mutex_unlock(&shard->tb_mutex);
+
+  return p->ct_text;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csvtextpool_count  --  number of unique strings in a pool
+ * ------------------------------------------------------------------------- */
+
+size_t
+csvtextpool_count(csvtextpool_t *self)
+{
+  size_t res = 0;
+
+  for( int i = 0; i < CSVTEXT_SHARDS; ++i )
+  {
+    csvtextshard_t *shard = &self->tp_shard[i];
+
+    pthread_mutex_lock(&shard->tb_mutex);
+    res += shard->tb_uniq;
+    pthread_mutex_unlock(&shard->tb_mutex);
+  }
+  return res;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csvtextpool_stats  --  string and hash chain statistics of a pool
+ *
+ * NULL gives statistics of the pool selected with csvtext_setpool().
+ * ------------------------------------------------------------------------- */
+
+void
+csvtextpool_stats(csvtextpool_t *self, csvtextstat_t *stats)
+{
+  memset(stats, 0, sizeof *stats);
+
+  if( self == 0 )
+  {
+    self = csvtext_pool;
+  }
+
+  for( int i = 0; i < CSVTEXT_SHARDS; ++i )
+  {
+    csvtextshard_t *shard = &self->tp_shard[i];
+    size_t          reserved;
+
+    pthread_mutex_lock(&shard->tb_mutex);
+
+    stats->ts_strings  += shard->tb_uniq;
+    stats->ts_requests += shard->tb_adds;
+    stats->ts_text     += shard->tb_text;
+    stats->ts_chains   += shard->tb_mask + 1;
+
+    mem_pool_usage(&shard->tb_pool, 0, &reserved);
+    stats->ts_reserved += reserved;
+    stats->ts_tables   += (shard->tb_mask + 1) * sizeof *shard->tb_slot;
+
+    for( size_t h = 0; h <= shard->tb_mask; ++h )
+    {
+      size_t len = 0;
+
+      for( csvtext_t *t = shard->tb_slot[h]; t; t = t->ct_next )
+      {
+        ++len;
+      }
+
+      if( stats->ts_maxchain < len )
+      {
+        stats->ts_maxchain = len;
+      }
+      stats->ts_chainlen[len < CSVTEXT_CHAINLEN ? len : CSVTEXT_CHAINLEN - 1] += 1;
     }
+
+    pthread_mutex_unlock(&shard->tb_mutex);
   }
 
-  /* - - - - - - - - - - - - - - - - - - - *
-   * free temp stack space if used
-   * - - - - - - - - - - - - - - - - - - - */
+  stats->ts_hits    = stats->ts_requests - stats->ts_strings;
+  stats->ts_entries = stats->ts_strings * sizeof(csvtext_t);
+}
+
+/* ------------------------------------------------------------------------- *
+ * csvtextstat_emit  --  print string pool statistics
+ * ------------------------------------------------------------------------- */
+
+void
+csvtextstat_emit(const csvtextstat_t *self, FILE *file)
+{
+  double hit = self->ts_requests ? 100.0 * self->ts_hits / self->ts_requests : 0;
+
+  fprintf(file, "strings:  %zu unique, %zu requests, %.1f%% hits\n",
+          self->ts_strings, self->ts_requests, hit);
+  fprintf(file, "  text    %12zu bytes\n", self->ts_text);
+  fprintf(file, "  entries %12zu bytes\n", self->ts_entries);
+  fprintf(file, "  chains  %12zu bytes\n", self->ts_tables);
+  fprintf(file, "  pools   %12zu bytes reserved\n", self->ts_reserved);
+  fprintf(file, "  chain lengths:");
+  for( int i = 0; i < CSVTEXT_CHAINLEN; ++i )
+  {
+    fprintf(file, " %d%s:%zu", i, (i == CSVTEXT_CHAINLEN - 1) ? "+" : "",
+            self->ts_chainlen[i]);
+  }
+  fprintf(file, ", max %zu of %zu chains\n", self->ts_maxchain, self->ts_chains);
+}
+
+/* ------------------------------------------------------------------------- *
+ * csvtext_setpool  --  select pool used by csvtext_intern()
+ *
+ * NULL selects the process wide default pool. Returns the previously
+ * selected pool. Selection is global and should not be changed while
+ * tables are being loaded or processed. Strings from different pools
+ * compare equal by content, but not by pointer.
+ * ------------------------------------------------------------------------- */
+
+csvtextpool_t *
+csvtext_setpool(csvtextpool_t *pool)
+{
+  csvtextpool_t *prev = csvtext_pool;
+  csvtext_pool = pool ? pool : &csvtext_default;
+  return prev;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csvtext_init  --  set up default pool
+ * ------------------------------------------------------------------------- */
+
+static void csvtext_init(void) __attribute__((constructor));
+
+static void
+csvtext_init(void)
+{
+  csvtextpool_ctor(&csvtext_default);
+}
+
+/* ------------------------------------------------------------------------- *
+ * csvtext_statistics  --  string intern hash table statistics
+ * ------------------------------------------------------------------------- */
+
+#if DEBUG_CSVTEXT
+static void csvtext_statistics(void) __attribute__((destructor));
+
+static void
+csvtext_statistics(void)
+{
+  csvtextstat_t stats;
+
+  csvtextpool_stats(&csvtext_default, &stats);
+
+  fprintf(stderr, "--\n");
+  csvtextstat_emit(&stats, stderr);
+  fprintf(stderr, "--\n");
+}
+#endif
+
+/* ------------------------------------------------------------------------- *
+ * csvtext_release  --  release all interned strings
+ * ------------------------------------------------------------------------- */
+
+static void csvtext_release(void) __attribute__((destructor));
+
+static void
+csvtext_release(void)
+{
+  csvtextpool_dtor(&csvtext_default);
+}
+
+/* ------------------------------------------------------------------------- *
+ * csvtext_global_replace_char_hack  --  ploticus & categories ....
+ * ------------------------------------------------------------------------- */
 
-  if( w != 0 )
+void
+csvtext_global_replace_char_hack(int from, int to)
+{
+  for( int i = 0; i < CSVTEXT_SHARDS; ++i )
   {
-    free(w);
+    csvtextshard_t *shard = &csvtext_pool->tp_shard[i];
+
+    for( size_t h = 0; h <= shard->tb_mask; ++h )
+    {
+      for( csvtext_t *t = shard->tb_slot[h]; t; t = t->ct_next )
+      {
+        for( char *s = t->ct_text; *s; ++ s)
+        {
+          if( *s == from ) *s = to;
+        }
+      }
+    }
   }
+}
 
-  csvtext_adds += 1;
+/* ------------------------------------------------------------------------- *
+ * csvtext_intern_ex  --  intern a string of given length
+ * ------------------------------------------------------------------------- */
 
-  return r;
+const char *
+csvtext_intern_ex(const char *text, size_t size)
+{
+  return csvtextpool_intern(csvtext_pool, text, size);
+}
+
+/* ------------------------------------------------------------------------- *
+ * csvtext_intern  --  intern a string
+ * ------------------------------------------------------------------------- */
+
+const char *
+csvtext_intern(const char *text)
+{
+  return csvtextpool_intern(csvtext_pool, text, strlen(text));
 }
 
 /* ------------------------------------------------------------------------- *
@@ -403,8 +693,7 @@ csvtext_compare(const char *s1, const char *s2)
 /*static inline*/ void
 csvcell_ctor(csvcell_t *self)
 {
-  self->cc_number = 0.0;
-  self->cc_string = csvtext_empty;
+  csvcell_settext(self, csvtext_empty);
 }
 
 /* ------------------------------------------------------------------------- *
@@ -416,16 +705,6 @@ csvcell_dtor(csvcell_t *self)
 {
 }
 
-/* ------------------------------------------------------------------------- *
- * csvcell_isstring  --  check if cell is a string
- * ------------------------------------------------------------------------- */
-
-/*static inline*/ int
-csvcell_isstring(const csvcell_t *self)
-{
-  return self->cc_string != NULL;
-}
-
 /* ------------------------------------------------------------------------- *
  * csvcell_isempty  --  check if cell is a empty string
  * ------------------------------------------------------------------------- */
@@ -433,17 +712,8 @@ csvcell_isstring(const csvcell_t *self)
 /*static inline*/ int
 csvcell_isempty(const csvcell_t *self)
 {
-  return self->cc_string != NULL && *self->cc_string == 0;
-}
-
-/* ------------------------------------------------------------------------- *
- * csvcell_isnumber  --  check if cell is a number
- * ------------------------------------------------------------------------- */
-
-/*static inline*/ int
-csvcell_isnumber(const csvcell_t *self)
-{
-  return self->cc_string == NULL;
+  const char *text = csvcell_gettext(self);
+  return text != NULL && *text == 0;
 }
 
 /* ------------------------------------------------------------------------- *
@@ -453,18 +723,7 @@ csvcell_isnumber(const csvcell_t *self)
 /*static inline*/ int
 csvcell_iszero(const csvcell_t *self)
 {
-  return self->cc_string == NULL && self->cc_number == 0.0;
-}
-
-/* ------------------------------------------------------------------------- *
- * csvcell_getnumber  --  obtain numerical cell value
- * ------------------------------------------------------------------------- */
-
-/*static inline*/ double
-csvcell_getnumber(const csvcell_t *self)
-{
-  // guranteed: zero if non-numerical
-  return self->cc_number;
+  return csvcell_isnumber(self) && csvcell_getnumber(self) == 0.0;
 }
 
 /* ------------------------------------------------------------------------- *
@@ -474,56 +733,173 @@ csvcell_getnumber(const csvcell_t *self)
 /*static inline*/ const char *
 csvcell_getstring(const csvcell_t *self, char *buff, size_t size)
 {
-  if( self->cc_string != NULL )
+  const char *text = csvcell_gettext(self);
+
+  if( text != NULL )
   {
-    return self->cc_string;
+    return text;
   }
   if( buff != 0 )
   {
-    snprintf(buff, size, ""CELL_FMT"", self->cc_number);
+    int64_t numb;
+
+    if( csvcell_getinteger(self, &numb) &&
+        (csvcell_isint64(self) || fabs((double)numb) < CSVCELL_EXACT) )
+    {
+      csv_int_to_string(numb, buff, size);
+    }
+    else
+    {
+      snprintf(buff, size, ""CELL_FMT"", csvcell_getnumber(self));
+    }
   }
   return buff;
 }
 
 /* ------------------------------------------------------------------------- *
- * csvcell_setstring  --  set cell to textual value
+ * csvcell_format  --  textual cell value as written to CSV files
+ *
+ * Integers are written exactly, other numbers with 11 significant
+ * digits.
  * ------------------------------------------------------------------------- */
 
-/*static inline*/ void
-csvcell_setstring(csvcell_t *self, const char *text)
+const char *
+csvcell_format(const csvcell_t *self, char *buff, size_t size)
 {
-  self->cc_number = 0.0;
-  self->cc_string = text ? csvtext_intern(text) : csvtext_empty;
-}
+  const char *text = csvcell_gettext(self);
+  int64_t     numb;
 
-/* ------------------------------------------------------------------------- *
- * csvcell_setnumber  --  set cell to numerical value
- * ------------------------------------------------------------------------- */
+  if( text != NULL )
+  {
+    return text;
+  }
 
-/*static inline*/ void
-csvcell_setnumber(csvcell_t *self, double numb)
-{
-  self->cc_number = numb;
-  self->cc_string = NULL;
+  if( csvcell_getinteger(self, &numb) &&
+      (csvcell_isint64(self) || fabs((double)numb) < CSVCELL_EXACT) )
+  {
+    return csv_int_to_string(numb, buff, size);
+  }
+
+  return csv_float_to_string(csvcell_getnumber(self), buff, size);
 }
 
 /* ------------------------------------------------------------------------- *
- * csvcell_setauto  --  parse cell value from string -> numeric or textual
+ * csvcell_setinteger  --  set cell to integer value
+ *
+ * Values below 2^53 are stored as doubles. Larger ones are interned
+ * as a zero byte followed by the 8 value bytes, which no CSV text
+ * can contain, and the cell points to the interned copy.
+ * Equal values thus have equal cell bits, as with strings.
  * ------------------------------------------------------------------------- */
 
-/*static inline*/ void
-csvcell_setauto(csvcell_t *self, const char *text)
+void
+csvcell_setinteger(csvcell_t *self, int64_t numb)
 {
-  char  *end;
-  double val = strtod(text, &end);
+  double conv = (double)numb;
 
-  if( end != text && *end == 0 )
+  if( fabs(conv) < CSVCELL_EXACT )
   {
-    csvcell_setnumber(self, val);
+    csvcell_setnumber(self, conv);
   }
   else
   {
-    csvcell_setstring(self, text);
+    char key[1 + sizeof numb];
+
+    key[0] = 0;
+    memcpy(key + 1, &numb, sizeof numb);
+
+    self->cc_bits = (CSVCELL_TAG_INT64 |
+                     (uint64_t)(uintptr_t)csvtext_intern_ex(key, sizeof key));
+  }
+}
+
+/* ------------------------------------------------------------------------- *
+ * csvcell_getinteger  --  obtain value if cell holds an integer
+ *
+ * Returns nonzero and sets *pnumb for large integers and for doubles
+ * that are integral and fit in 64 bits. Negative zero is not treated
+ * as integer, so that it keeps its sign.
+ * ------------------------------------------------------------------------- */
+
+int
+csvcell_getinteger(const csvcell_t *self, int64_t *pnumb)
+{
+  if( csvcell_isint64(self) )
+  {
+    *pnumb = csvcell_getint64(self);
+    return 1;
+  }
+
+  if( csvcell_isstring(self) )
+  {
+    return 0;
+  }
+
+  double numb = csvcell_getnumber(self);
+
+  if( !(numb >= -0x1p63 && numb < 0x1p63) || numb != floor(numb) )
+  {
+    return 0;
+  }
+  if( numb == 0 && self->cc_bits != 0 )
+  {
+    return 0;
+  }
+  *pnumb = (int64_t)numb;
+  return 1;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csvcell_setdigits  --  set cell to number parsed from text
+ *
+ * Integers beyond the exact range of doubles are parsed again from
+ * the text, so that all 64 bits are kept.
+ * ------------------------------------------------------------------------- */
+
+void
+csvcell_setdigits(csvcell_t *self, double numb, const char *text, size_t size)
+{
+  const char *pos = text;
+  int64_t     ival;
+
+  if( fabs(numb) >= CSVCELL_EXACT &&
+      csv_int_parse(&pos, &ival) == 0 && pos == text + size )
+  {
+    csvcell_setinteger(self, ival);
+  }
+  else
+  {
+    csvcell_setnumber(self, numb);
+  }
+}
+
+/* ------------------------------------------------------------------------- *
+ * csvcell_setstring  --  set cell to textual value
+ * ------------------------------------------------------------------------- */
+
+/*static inline*/ void
+csvcell_setstring(csvcell_t *self, const char *text)
+{
+  csvcell_settext(self, text ? csvtext_intern(text) : csvtext_empty);
+}
+
+/* ------------------------------------------------------------------------- *
+ * csvcell_setauto  --  parse cell value from string -> numeric or textual
+ * ------------------------------------------------------------------------- */
+
+/*static inline*/ void
+csvcell_setauto(csvcell_t *self, const char *text)
+{
+  char  *end;
+  double val = strtod(text, &end);
+
+  if( end != text && *end == 0 )
+  {
+    csvcell_setdigits(self, val, text, end - text);
+  }
+  else
+  {
+    csvcell_setstring(self, text);
   }
 }
 
@@ -570,25 +946,49 @@ csvcell_delete_cb(void *self)
 int
 csvcell_compare(const csvcell_t *a, const csvcell_t *b)
 {
-  if( a->cc_string != 0 )
+  const char *sa, *sb;
+
+  if( a->cc_bits == b->cc_bits )
+  {
+    // A = B, same number or same interned string
+    return 0;
+  }
+
+  sa = csvcell_gettext(a);
+  sb = csvcell_gettext(b);
+
+  if( sa != 0 )
   {
-    if( b->cc_string != 0 )
+    if( sb != 0 )
     {
       // A = string, B = string -> mixed alpha-numerical comparison
-      return csvtext_compare(a->cc_string, b->cc_string);
+      return csvtext_compare(sa, sb);
     }
     // A = string > B = number
     return 1;
   }
 
-  if( b->cc_string != 0 )
+  if( sb != 0 )
   {
     // A = number < B = string
     return -1;
   }
 
+  if( csvcell_isint64(a) || csvcell_isint64(b) )
+  {
+    // A or B = large integer -> exact if both are integers
+    int64_t ia, ib;
+
+    if( csvcell_getinteger(a, &ia) && csvcell_getinteger(b, &ib) )
+    {
+      return (ia > ib) - (ia < ib);
+    }
+  }
+
   // A = number, B = number -> numerical comparison
-  return (a->cc_number > b->cc_number) - (a->cc_number < b->cc_number);
+  double na = csvcell_getnumber(a);
+  double nb = csvcell_getnumber(b);
+  return (na > nb) - (na < nb);
 }
 
 /* ------------------------------------------------------------------------- *
@@ -607,25 +1007,28 @@ csvcell_diff(const csvcell_t *a, const csvcell_t *b)
    * for return type {r <= -1.0, 0.0, >= 1.0}.
    * - - - - - - - - - - - - - - - - - - - */
 
-  if( a->cc_string != 0 )
+  const char *sa = csvcell_gettext(a);
+  const char *sb = csvcell_gettext(b);
+
+  if( sa != 0 )
   {
-    if( b->cc_string != 0 )
+    if( sb != 0 )
     {
       // A = string, B = string -> mixed alpha-numerical comparison
-      return csvtext_compare(a->cc_string, b->cc_string);
+      return csvtext_compare(sa, sb);
     }
     // A = string > B = number
     return 1;
   }
 
-  if( b->cc_string != 0 )
+  if( sb != 0 )
   {
     // A = number < B = string
     return -1;
   }
 
   // A = number, B = number -> numerical comparison
-  return a->cc_number - b->cc_number;
+  return csvcell_getnumber(a) - csvcell_getnumber(b);
 }
 
 /* ------------------------------------------------------------------------- *
@@ -767,6 +1170,43 @@ csvrow_create(int cols)
   return self;
 }
 
+/* ------------------------------------------------------------------------- *
+ * csvrow_create_pooled  --  row that is released with the pool
+ *
+ * Room is allocated for size cells, so that columns can be added
+ * up to that without moving the row.
+ * ------------------------------------------------------------------------- */
+
+static csvrow_t *
+csvrow_create_pooled(mem_pool_t *pool, int cols, int size)
+{
+  csvrow_t *self = mem_pool_alloc(pool, csvrow_sizeof(size));
+
+  self->cr_flags = 0;
+  self->cr_cols  = cols;
+
+  for( int c = 0; c < self->cr_cols; ++c )
+  {
+    csvcell_ctor(&self->cr_celltab[c]);
+  }
+
+  return self;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csvrow_copy
+ * ------------------------------------------------------------------------- */
+
+csvrow_t *
+csvrow_copy(const csvrow_t *self)
+{
+  csvrow_t *copy = malloc(csvrow_sizeof(self->cr_cols));
+  if ( copy == NULL ) abort();
+
+  memcpy(copy, self, csvrow_sizeof(self->cr_cols));
+  return copy;
+}
+
 /* ------------------------------------------------------------------------- *
  * csvrow_delete
  * ------------------------------------------------------------------------- */
@@ -884,1148 +1324,3441 @@ csvrow_compare_indirect_cb(const void *row1p, const void *row2p)
 }
 
 /* ========================================================================= *
- * csv_t  --  methods
+ * csvcolumn_t  --  methods
  * ========================================================================= */
 
 /* ------------------------------------------------------------------------- *
- * csv_setseparator
+ * csvcolumn_create  --  gather values of table column
  * ------------------------------------------------------------------------- */
 
-/*static inline*/ void
-csv_setseparator(csv_t *self, const char *sep)
+csvcolumn_t *
+csvcolumn_create(const csv_t *csv, int col)
 {
-  free(self->csv_sepstr);
-  self->csv_sepstr = sep ? strdup(sep) : 0;
-}
+  csvcolumn_t *self = calloc(1, sizeof *self);
+  int          rows = csv->csv_rowcnt;
 
-/* ------------------------------------------------------------------------- *
- * csv_cols
- * ------------------------------------------------------------------------- */
+  self->cl_rows    = rows;
+  self->cl_strings = 0;
+  self->cl_number  = malloc((rows + 1) * sizeof *self->cl_number);
+  self->cl_string  = malloc((rows + 1) * sizeof *self->cl_string);
+  self->cl_isstr   = calloc(rows / 64 + 1, sizeof *self->cl_isstr);
 
-/*static inline*/ int
-csv_cols(const csv_t *self)
-{
-  return self->csv_labtab->cr_cols;
+  if( !self->cl_number || !self->cl_string || !self->cl_isstr ) abort();
+
+  for( int r = 0; r < rows; ++r )
+  {
+    const csvcell_t *cell = csvrow_getcell(csv->csv_rowtab[r], col);
+
+    self->cl_number[r] = csvcell_getnumber(cell);
+    self->cl_string[r] = csvcell_gettext(cell);
+
+    if( self->cl_string[r] != 0 )
+    {
+      self->cl_isstr[r / 64] |= (uint64_t)1 << (r % 64);
+      self->cl_strings += 1;
+    }
+    else if( csvcell_isint64(cell) )
+    {
+      self->cl_string[r] = (const char *)(uintptr_t)(cell->cc_bits &
+                                                     ~CSVCELL_TAG_MASK);
+    }
+  }
+
+  return self;
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_rows
+ * csvcolumn_delete
  * ------------------------------------------------------------------------- */
 
-/*static inline*/ int
-csv_rows(const csv_t *self)
+void
+csvcolumn_delete(csvcolumn_t *self)
 {
-  return self->csv_rowcnt;
+  if( self != 0 )
+  {
+    free(self->cl_number);
+    free(self->cl_string);
+    free(self->cl_isstr);
+    free(self);
+  }
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_colcheck
+ * csvcolumn_isstring
  * ------------------------------------------------------------------------- */
 
 /*static inline*/ int
-csv_colcheck(const csv_t *self, int col)
+csvcolumn_isstring(const csvcolumn_t *self, int row)
 {
-  return 0 <= col && col < csv_cols(self);
+  return (self->cl_isstr[row / 64] >> (row % 64)) & 1;
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_rowcheck
+ * csvcolumn_getcell  --  value of row as cell
  * ------------------------------------------------------------------------- */
 
-/*static inline*/ int
-csv_rowcheck(const csv_t *self, int row)
+/*static inline*/ void
+csvcolumn_getcell(const csvcolumn_t *self, int row, csvcell_t *cell)
 {
-  return 0 <= row && row < csv_rows(self);
+  if( self->cl_string[row] == 0 )
+  {
+    csvcell_setnumber(cell, self->cl_number[row]);
+  }
+  else if( csvcolumn_isstring(self, row) )
+  {
+    csvcell_settext(cell, self->cl_string[row]);
+  }
+  else
+  {
+    cell->cc_bits = CSVCELL_TAG_INT64 | (uint64_t)(uintptr_t)self->cl_string[row];
+  }
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_getcolflags
+ * csvcolumn_store  --  scatter values back to table column
+ *
+ * The table must still have the rows the column was gathered from.
  * ------------------------------------------------------------------------- */
 
-/*static inline*/ unsigned
-csv_getcolflags(const csv_t *self, int col)
+void
+csvcolumn_store(const csvcolumn_t *self, csv_t *csv, int col)
 {
-  if( csv_colcheck(self, col) )
+  for( int r = 0; r < self->cl_rows; ++r )
   {
-    return self->csv_colflags[col];
+    csvcell_t *cell = csvrow_getcell(csv->csv_rowtab[r], col);
+
+    csvcolumn_getcell(self, r, cell);
+
+    if( csvcell_isint64(cell) &&
+        csvcell_getnumber(cell) != self->cl_number[r] )
+    {
+      // large integer changed via cl_number
+      csvcell_setnumber(cell, self->cl_number[r]);
+    }
   }
-  return 0;
 }
 
+/* ========================================================================= *
+ * csvdict_t  --  methods
+ * ========================================================================= */
+
 /* ------------------------------------------------------------------------- *
- * csv_tstcolflags
+ * csvdict_hash  --  slot for interned text pointer
  * ------------------------------------------------------------------------- */
 
-/*static inline*/ unsigned
-csv_tstcolflags(const csv_t *self, int col, unsigned mask)
+static inline uint32_t
+csvdict_hash(const char *text)
 {
-  if( csv_colcheck(self, col) )
-  {
-    return self->csv_colflags[col] & mask;
-  }
-  return 0;
+  uint64_t h = (uintptr_t)text;
+  return (uint32_t)((h * 0x9e3779b97f4a7c15ull) >> 32);
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_setcolflags
+ * csvdict_text_cb  --  qsort callback for interned text pointer arrays
  * ------------------------------------------------------------------------- */
 
-/*static inline*/ void
-csv_setcolflags(const csv_t *self, int col, unsigned mask)
+static int
+csvdict_text_cb(const void *a, const void *b)
 {
-  if( csv_colcheck(self, col) )
-  {
-    self->csv_colflags[col] = mask;
-  }
+  return csvtext_compare(*(const char **)a, *(const char **)b);
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_addcolflags
+ * csvdict_create  --  encode string values of table column
  * ------------------------------------------------------------------------- */
 
-/*static inline*/ void
-csv_addcolflags(const csv_t *self, int col, unsigned mask)
+csvdict_t *
+csvdict_create(const csv_t *csv, int col)
 {
-  if( csv_colcheck(self, col) )
+  csvdict_t *self = calloc(1, sizeof *self);
+  int        rows = csv->csv_rowcnt;
+  int        have = 16;
+
+  if ( self == NULL ) abort();
+
+  self->cd_rows  = rows;
+  self->cd_code  = malloc((rows + 1) * sizeof *self->cd_code);
+  self->cd_count = 0;
+  self->cd_text  = malloc(have * sizeof *self->cd_text);
+  self->cd_rank  = 0;
+  self->cd_mask  = 31;
+  self->cd_slot  = calloc(self->cd_mask + 1, sizeof *self->cd_slot);
+
+  if( !self->cd_code || !self->cd_text || !self->cd_slot ) abort();
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * assign codes in order of appearance
+   * - - - - - - - - - - - - - - - - - - - */
+
+  for( int r = 0; r < rows; ++r )
   {
-    self->csv_colflags[col] |= mask;
+    const char *text = csvcell_gettext(csvrow_getcell(csv->csv_rowtab[r], col));
+    uint32_t    code = 0;
+
+    if( text != 0 && (code = csvdict_lookup(self, text)) == 0 )
+    {
+      if( self->cd_count + 1 >= have )
+      {
+        have *= 2;
+        self->cd_text = realloc(self->cd_text, have * sizeof *self->cd_text);
+        if ( self->cd_text == NULL ) abort();
+      }
+
+      code = ++self->cd_count;
+      self->cd_text[code] = text;
+
+      if( 2 * (uint32_t)self->cd_count > self->cd_mask )
+      {
+        /* keep the hash at most half full */
+        free(self->cd_slot);
+        self->cd_mask = self->cd_mask * 2 + 1;
+        self->cd_slot = calloc(self->cd_mask + 1, sizeof *self->cd_slot);
+        if ( self->cd_slot == NULL ) abort();
+
+        for( uint32_t k = 1; k < code; ++k )
+        {
+          uint32_t i = csvdict_hash(self->cd_text[k]) & self->cd_mask;
+          while( self->cd_slot[i] != 0 ) i = (i + 1) & self->cd_mask;
+          self->cd_slot[i] = k;
+        }
+      }
+
+      uint32_t i = csvdict_hash(text) & self->cd_mask;
+      while( self->cd_slot[i] != 0 ) i = (i + 1) & self->cd_mask;
+      self->cd_slot[i] = code;
+    }
+
+    self->cd_code[r] = code;
+  }
+
+  self->cd_text[0] = 0;
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * sort the distinct strings once to get
+   * ranks for the codes
+   * - - - - - - - - - - - - - - - - - - - */
+
+  int          cnt  = self->cd_count;
+  const char **tmp  = malloc((cnt + 1) * sizeof *tmp);
+  uint32_t     rank = 0;
+
+  self->cd_rank = calloc(cnt + 1, sizeof *self->cd_rank);
+
+  if( !tmp || !self->cd_rank ) abort();
+
+  memcpy(tmp, self->cd_text + 1, cnt * sizeof *tmp);
+  qsort(tmp, cnt, sizeof *tmp, csvdict_text_cb);
+
+  for( int k = 0; k < cnt; ++k )
+  {
+    if( k == 0 || csvtext_compare(tmp[k-1], tmp[k]) != 0 )
+    {
+      ++rank;
+    }
+    self->cd_rank[csvdict_lookup(self, tmp[k])] = rank;
   }
+
+  free(tmp);
+
+  return self;
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_clrcolflags
+ * csvdict_delete
  * ------------------------------------------------------------------------- */
 
-/*static inline*/ void
-csv_clrcolflags(const csv_t *self, int col, unsigned mask)
+void
+csvdict_delete(csvdict_t *self)
 {
-  if( csv_colcheck(self, col) )
+  if( self != 0 )
   {
-    self->csv_colflags[col] &= ~mask;
+    free(self->cd_code);
+    free(self->cd_text);
+    free(self->cd_rank);
+    free(self->cd_slot);
+    free(self);
   }
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_getrowflags
+ * csvdict_lookup  --  code of interned text, 0 if not in the column
  * ------------------------------------------------------------------------- */
 
-/*static inline*/ unsigned
-csv_getrowflags(const csv_t *self, int row)
+uint32_t
+csvdict_lookup(const csvdict_t *self, const char *text)
 {
-  if( csv_rowcheck(self, row) )
+  for( uint32_t i = csvdict_hash(text) & self->cd_mask; self->cd_slot[i] != 0;
+       i = (i + 1) & self->cd_mask )
   {
-    return self->csv_rowtab[row]->cr_flags;
+    if( self->cd_text[self->cd_slot[i]] == text )
+    {
+      return self->cd_slot[i];
+    }
   }
   return 0;
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_setrowflags
+ * csvdict_textrank  --  sort rank of interned text in the column
  * ------------------------------------------------------------------------- */
 
-/*static inline*/ void
-csv_setrowflags(csv_t *self, int row, unsigned mask)
+/*static inline*/ uint32_t
+csvdict_textrank(const csvdict_t *self, const char *text)
 {
-  if( csv_rowcheck(self, row) )
-  {
-    self->csv_rowtab[row]->cr_flags = mask;
-  }
+  return self->cd_rank[csvdict_lookup(self, text)];
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_addrowflags
+ * csvdict_getcode
  * ------------------------------------------------------------------------- */
 
-/*static inline*/ void
-csv_addrowflags(csv_t *self, int row, unsigned mask)
+/*static inline*/ uint32_t
+csvdict_getcode(const csvdict_t *self, int row)
 {
-  if( csv_rowcheck(self, row) )
-  {
-    self->csv_rowtab[row]->cr_flags |= mask;
-  }
+  return self->cd_code[row];
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_clrrowflags
+ * csvdict_getrank
  * ------------------------------------------------------------------------- */
 
-/*static inline*/ void
-csv_clrrowflags(csv_t *self, int row, unsigned mask)
+/*static inline*/ uint32_t
+csvdict_getrank(const csvdict_t *self, int row)
 {
-  if( csv_rowcheck(self, row) )
-  {
-    self->csv_rowtab[row]->cr_flags &= ~mask;
-  }
+  return self->cd_rank[self->cd_code[row]];
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_tstrowflags
+ * csvdict_gettext
  * ------------------------------------------------------------------------- */
 
-/*static inline*/ unsigned
-csv_tstrowflags(const csv_t *self, int row, unsigned mask)
+/*static inline*/ const char *
+csvdict_gettext(const csvdict_t *self, uint32_t code)
 {
-  if( csv_rowcheck(self, row) )
-  {
-    return self->csv_rowtab[row]->cr_flags & mask;
-  }
-  return 0;
+  return self->cd_text[code];
 }
 
+/* ========================================================================= *
+ * csvschema_t  --  methods
+ * ========================================================================= */
+
 /* ------------------------------------------------------------------------- *
- * csv_getrow
+ * csvschema_create
  * ------------------------------------------------------------------------- */
 
-/*static inline*/ csvrow_t *
-csv_getrow(const csv_t *self, int row)
+csvschema_t *
+csvschema_create(void)
 {
-  if( !csv_rowcheck(self, row) )
-  {
-    msg_fatal("csv_t: row access out of bounds [%d/%d]\n",
-              row, self->csv_rowcnt);
-  }
-  // get rid of const status
-  return (csvrow_t *)self->csv_rowtab[row];
+  csvschema_t *self = calloc(1, sizeof *self);
+  if ( self == NULL ) abort();
+
+  self->cs_refs  = 1;
+  self->cs_cols  = 0;
+  self->cs_max   = 0;
+  self->cs_label = 0;
+  self->cs_hval  = 0;
+  self->cs_type  = 0;
+  self->cs_stat  = 0;
+  self->cs_mask  = 15;
+  self->cs_slot  = calloc(self->cs_mask + 1, sizeof *self->cs_slot);
+  if ( self->cs_slot == NULL ) abort();
+
+  return self;
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_getcell
+ * csvschema_delete  --  drop reference, release when last is gone
  * ------------------------------------------------------------------------- */
 
-/*static inline*/ csvcell_t *
-csv_getcell(const csv_t *self, int row, int col)
+void
+csvschema_delete(csvschema_t *self)
 {
-  return csvrow_getcell(csv_getrow(self, row), col);
+  if( self != 0 && --self->cs_refs == 0 )
+  {
+    free(self->cs_label);
+    free(self->cs_hval);
+    free(self->cs_type);
+    free(self->cs_stat);
+    free(self->cs_slot);
+    free(self);
+  }
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_isstring
+ * csvschema_share  --  add reference
  * ------------------------------------------------------------------------- */
 
-/*static inline*/ int
-csv_isstring(const csv_t *self, int row, int col)
+csvschema_t *
+csvschema_share(csvschema_t *self)
 {
-  return csvcell_isstring(csv_getcell(self, row, col));
+  if( self != 0 )
+  {
+    self->cs_refs += 1;
+  }
+  return self;
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_isnumber
+ * csvschema_cols
  * ------------------------------------------------------------------------- */
 
 /*static inline*/ int
-csv_isnumber(const csv_t *self, int row, int col)
+csvschema_cols(const csvschema_t *self)
 {
-  return csvcell_isnumber(csv_getcell(self, row, col));
+  return self->cs_cols;
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_getnumber
+ * csvschema_label
  * ------------------------------------------------------------------------- */
 
-/*static inline*/ double
-csv_getnumber(const csv_t *self, int row, int col)
+/*static inline*/ const char *
+csvschema_label(const csvschema_t *self, int col)
 {
-  return csvcell_getnumber(csv_getcell(self, row, col));
+  return (0 <= col && col < self->cs_cols) ? self->cs_label[col] : 0;
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_getstring
+ * csvschema_insert  --  add column to label index
  * ------------------------------------------------------------------------- */
 
-/*static inline*/ const char *
-csv_getstring(const csv_t *self, int row, int col, char *buff, size_t size)
+static void
+csvschema_insert(csvschema_t *self, int col)
 {
-  return csvcell_getstring(csv_getcell(self, row, col), buff, size);
+  int i = self->cs_hval[col] & self->cs_mask;
+
+  while( self->cs_slot[i] != 0 )
+  {
+    i = (i + 1) & self->cs_mask;
+  }
+  self->cs_slot[i] = col + 1;
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_setstring
+ * csvschema_find  --  column with given label, or -1
  * ------------------------------------------------------------------------- */
 
-/*static inline*/ void
-csv_setstring(csv_t *self, int row, int col, const char *text)
+int
+csvschema_find(const csvschema_t *self, const char *lab)
 {
-  csvcell_setstring(csv_getcell(self, row, col), text);
+  uint32_t h = jhash(lab, strlen(lab), 0);
+
+  for( int i = h & self->cs_mask; self->cs_slot[i] != 0;
+       i = (i + 1) & self->cs_mask )
+  {
+    int c = self->cs_slot[i] - 1;
+
+    if( self->cs_hval[c] == h &&
+        (self->cs_label[c] == lab || !strcmp(self->cs_label[c], lab)) )
+    {
+      return c;
+    }
+  }
+  return -1;
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_setnumber
+ * csvschema_add  --  append column, returns index of column with label
  * ------------------------------------------------------------------------- */
 
-/*static inline*/ void
-csv_setnumber(csv_t *self, int row, int col, double numb)
+int
+csvschema_add(csvschema_t *self, const char *lab)
 {
-  csvcell_setnumber(csv_getcell(self, row, col), numb);
+  int c = csvschema_find(self, lab);
+
+  if( c >= 0 )
+  {
+    return c;
+  }
+
+  if( self->cs_cols == self->cs_max )
+  {
+    self->cs_max   = self->cs_max ? (self->cs_max * 2) : 16;
+    self->cs_label = realloc(self->cs_label, self->cs_max * sizeof *self->cs_label);
+    self->cs_hval  = realloc(self->cs_hval,  self->cs_max * sizeof *self->cs_hval);
+    self->cs_type  = realloc(self->cs_type,  self->cs_max * sizeof *self->cs_type);
+    self->cs_stat  = realloc(self->cs_stat,  self->cs_max * sizeof *self->cs_stat);
+
+    if( !self->cs_label || !self->cs_hval ||
+        !self->cs_type  || !self->cs_stat ) abort();
+  }
+
+  c = self->cs_cols++;
+
+  self->cs_label[c] = csvtext_intern(lab);
+  self->cs_hval[c]  = jhash(lab, strlen(lab), 0);
+  self->cs_type[c]  = 0;
+  memset(&self->cs_stat[c], 0, sizeof self->cs_stat[c]);
+
+  if( 2 * self->cs_cols > self->cs_mask )
+  {
+    // keep load factor below 1/2
+    self->cs_mask = self->cs_mask * 2 + 1;
+    self->cs_slot = realloc(self->cs_slot,
+                            (self->cs_mask + 1) * sizeof *self->cs_slot);
+    if ( self->cs_slot == NULL ) abort();
+    memset(self->cs_slot, 0, (self->cs_mask + 1) * sizeof *self->cs_slot);
+
+    for( int i = 0; i < self->cs_cols; ++i )
+    {
+      csvschema_insert(self, i);
+    }
+  }
+  else
+  {
+    csvschema_insert(self, c);
+  }
+
+  return c;
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_setauto
+ * csvschema_equal  --  check if two schemas have the same labels
  * ------------------------------------------------------------------------- */
 
-/*static inline*/ void
-csv_setauto(csv_t *self, int row, int col, const char *text)
+int
+csvschema_equal(const csvschema_t *self, const csvschema_t *that)
 {
-  csvcell_setauto(csv_getcell(self, row, col), text);
+  if( self == that )
+  {
+    return 1;
+  }
+  if( self->cs_cols != that->cs_cols )
+  {
+    return 0;
+  }
+  for( int c = 0; c < self->cs_cols; ++c )
+  {
+    // labels are interned
+    if( self->cs_label[c] != that->cs_label[c] )
+    {
+      return 0;
+    }
+  }
+  return 1;
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_setsource
+ * csvschema_type  --  CT_xxx flags of column
  * ------------------------------------------------------------------------- */
 
-void
-csv_setsource(csv_t *self, const char *path)
+/*static inline*/ unsigned
+csvschema_type(const csvschema_t *self, int col)
 {
-  free(self->csv_source);
-  self->csv_source = path ? strdup(path) : NULL;
+  return (0 <= col && col < self->cs_cols) ? self->cs_type[col] : 0;
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_getsource
+ * csvschema_stat  --  value statistics of column
  * ------------------------------------------------------------------------- */
 
-const char *
-csv_getsource(const csv_t *self)
+/*static inline*/ const csvstat_t *
+csvschema_stat(const csvschema_t *self, int col)
 {
-  return self->csv_source ? self->csv_source : "<unset>";
+  return (0 <= col && col < self->cs_cols) ? &self->cs_stat[col] : 0;
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_ctor
+ * csvschema_analyze  --  gather column types & statistics from table
+ *
+ * For a shared schema the results describe the table analyzed last.
  * ------------------------------------------------------------------------- */
 
 void
-csv_ctor(csv_t *self)
+csvschema_analyze(csvschema_t *self, const csv_t *csv)
 {
-  array_ctor(&self->csv_head, csvvar_delete_cb);
+  int cols = self->cs_cols;
 
-  self->csv_rowcnt = 0;
-  self->csv_rowmax = 256;
+  for( int c = 0; c < cols; ++c )
+  {
+    self->cs_type[c] = 0;
+    memset(&self->cs_stat[c], 0, sizeof self->cs_stat[c]);
+  }
 
-  self->csv_labtab = csvrow_create(0);
-  self->csv_rowtab = malloc(self->csv_rowmax * sizeof *self->csv_rowtab);
+  for( int r = 0; r < csv->csv_rowcnt; ++r )
+  {
+    const csvrow_t *row = csv->csv_rowtab[r];
 
-  self->csv_sepstr = 0;
-  self->csv_colflags = 0;
-  self->csv_source = 0;
+    for( int c = 0; c < cols && c < row->cr_cols; ++c )
+    {
+      const csvcell_t *cell = &row->cr_celltab[c];
+      csvstat_t       *stat = &self->cs_stat[c];
+      const char      *text = csvcell_gettext(cell);
 
-  self->csv_flags  = 0;
+      if( text == 0 )
+      {
+        double  v = csvcell_getnumber(cell);
+        int64_t i;
+
+        if( stat->st_numbers++ == 0 )
+        {
+          stat->st_min = stat->st_max = v;
+          self->cs_type[c] |= CT_INTEGER;
+        }
+        else if( v < stat->st_min )
+        {
+          stat->st_min = v;
+        }
+        else if( v > stat->st_max )
+        {
+          stat->st_max = v;
+        }
+        stat->st_sum += v;
+        self->cs_type[c] |= CT_NUMBER;
+
+        if( !csvcell_getinteger(cell, &i) )
+        {
+          self->cs_type[c] &= ~CT_INTEGER;
+        }
+      }
+      else
+      {
+        stat->st_strings += 1;
+        self->cs_type[c] |= *text ? CT_STRING : CT_EMPTY;
+      }
+    }
+  }
 }
 
+/* ========================================================================= *
+ * csv_t  --  methods
+ * ========================================================================= */
+
 /* ------------------------------------------------------------------------- *
- * csv_dtor
+ * csv_setthreads  --  set number of threads used for table operations
  * ------------------------------------------------------------------------- */
 
+static int csv_threads = 0;
+
 void
-csv_dtor(csv_t *self)
+csv_setthreads(int count)
 {
-  array_dtor(&self->csv_head);
-  csvrow_delete(self->csv_labtab);
-  for( int r = 0; r < self->csv_rowcnt; ++r )
+  csv_threads = (count < 1) ? 1 : count;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_getthreads  --  number of threads, defaults to online cpu count
+ * ------------------------------------------------------------------------- */
+
+int
+csv_getthreads(void)
+{
+  if( csv_threads == 0 )
   {
-    csvrow_delete(self->csv_rowtab[r]);
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    csv_threads = (cpus < 1) ? 1 : (int)cpus;
   }
-  free(self->csv_rowtab);
+  return csv_threads;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_setseparator
+ * ------------------------------------------------------------------------- */
+
+/*static inline*/ void
+csv_setseparator(csv_t *self, const char *sep)
+{
   free(self->csv_sepstr);
-  free(self->csv_colflags);
-  free(self->csv_source);
+  self->csv_sepstr = sep ? strdup(sep) : 0;
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_create
+ * csv_cols
  * ------------------------------------------------------------------------- */
 
-csv_t *
-csv_create(void)
+/*static inline*/ int
+csv_cols(const csv_t *self)
 {
-  csv_t *self = calloc(1, sizeof *self);
-  csv_ctor(self);
-  return self;
+  return self->csv_labtab->cr_cols;
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_delete
+ * csv_rows
  * ------------------------------------------------------------------------- */
 
-void
-csv_delete(csv_t *self)
+/*static inline*/ int
+csv_rows(const csv_t *self)
 {
-  if( self != 0 )
-  {
-    csv_dtor(self);
-    free(self);
-  }
+  return self->csv_rowcnt;
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_delete_cb
+ * csv_colcheck
  * ------------------------------------------------------------------------- */
 
-void
-csv_delete_cb(void *self)
+/*static inline*/ int
+csv_colcheck(const csv_t *self, int col)
 {
-  csv_delete(self);
+  return 0 <= col && col < csv_cols(self);
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_addvar
+ * csv_rowcheck
  * ------------------------------------------------------------------------- */
 
-void
-csv_addvar(csv_t *self, const char *key, const char *val)
+/*static inline*/ int
+csv_rowcheck(const csv_t *self, int row)
 {
-  array_add(&self->csv_head, csvvar_create(key, val));
+  return 0 <= row && row < csv_rows(self);
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_delrow
+ * csv_getcolflags
  * ------------------------------------------------------------------------- */
 
-void
-csv_delrow(csv_t *self, int row)
+/*static inline*/ unsigned
+csv_getcolflags(const csv_t *self, int col)
 {
-  if( csv_rowcheck(self, row) )
+  if( csv_colcheck(self, col) )
   {
-    csvrow_delete(self->csv_rowtab[row]);
-    for( ; row < self->csv_rowcnt; ++row )
-    {
-      self->csv_rowtab[row+0] = self->csv_rowtab[row+1];
-    }
-    self->csv_rowcnt -= 1;
+    return self->csv_colflags[col];
   }
+  return 0;
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_delrow_nocompact
+ * csv_tstcolflags
  * ------------------------------------------------------------------------- */
 
-void
-csv_delrow_nocompact(csv_t *self, int row)
+/*static inline*/ unsigned
+csv_tstcolflags(const csv_t *self, int col, unsigned mask)
 {
-  if( csv_rowcheck(self, row) )
+  if( csv_colcheck(self, col) )
   {
-    csvrow_delete(self->csv_rowtab[row]);
-    self->csv_rowtab[row] = 0;
+    return self->csv_colflags[col] & mask;
   }
+  return 0;
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_compactrows
+ * csv_setcolflags
  * ------------------------------------------------------------------------- */
 
-void
-csv_compactrows(csv_t *self)
+/*static inline*/ void
+csv_setcolflags(const csv_t *self, int col, unsigned mask)
 {
-  int di = 0, si = 0;
-
-  while( si < self->csv_rowcnt )
+  if( csv_colcheck(self, col) )
   {
-    csvrow_t *r = self->csv_rowtab[si++];
-    if( r != 0 )
-    {
-      self->csv_rowtab[di++] = r;
-    }
+    self->csv_colflags[col] = mask;
   }
-  self->csv_rowcnt = di;
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_newrow
+ * csv_addcolflags
  * ------------------------------------------------------------------------- */
 
-csvrow_t *
-csv_newrow(csv_t *self)
+/*static inline*/ void
+csv_addcolflags(const csv_t *self, int col, unsigned mask)
 {
-  if( self->csv_rowcnt == self->csv_rowmax )
+  if( csv_colcheck(self, col) )
   {
-    self->csv_rowmax = self->csv_rowmax * 4 / 3;
-    self->csv_rowtab = realloc(self->csv_rowtab,
-                               self->csv_rowmax * sizeof *self->csv_rowtab);
+    self->csv_colflags[col] |= mask;
   }
-
-  csvrow_t *r = csvrow_create(csv_cols(self));
-  self->csv_rowtab[self->csv_rowcnt++] = r;
-  return r;
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_addcol  --  find/add column by label name
+ * csv_clrcolflags
  * ------------------------------------------------------------------------- */
 
-int
-csv_addcol(csv_t *self, const char *lab)
+/*static inline*/ void
+csv_clrcolflags(const csv_t *self, int col, unsigned mask)
 {
-  for( int c=0, n = csv_cols(self); c < n; ++c )
+  if( csv_colcheck(self, col) )
   {
-    char t[32];
-    const char *s = csvrow_getstring(self->csv_labtab, c, t, sizeof t);
-
-    if( !strcmp(s, lab) )
-    {
-      return c;
-    }
+    self->csv_colflags[col] &= ~mask;
   }
+}
 
-  for( int r = 0; r < self->csv_rowcnt; ++r )
+/* ------------------------------------------------------------------------- *
+ * csv_getrowflags
+ * ------------------------------------------------------------------------- */
+
+/*static inline*/ unsigned
+csv_getrowflags(const csv_t *self, int row)
+{
+  if( csv_rowcheck(self, row) )
   {
-    csvrow_addcol(&self->csv_rowtab[r]);
+    return self->csv_rowtab[row]->cr_flags;
   }
-
-  int c = csvrow_addcol(&self->csv_labtab);
-  csvrow_setstring(self->csv_labtab, c, lab);
-
-  self->csv_colflags = realloc(self->csv_colflags,
-                               csv_cols(self) * sizeof *self->csv_colflags);
-  self->csv_colflags[c] = 0;
-
-  return c;
+  return 0;
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_remcol
+ * csv_setrowflags
  * ------------------------------------------------------------------------- */
 
-void
-csv_remcol(csv_t *self, int col)
+/*static inline*/ void
+csv_setrowflags(csv_t *self, int row, unsigned mask)
 {
-  if( csv_colcheck(self, col) )
+  if( csv_rowcheck(self, row) )
   {
-    csvrow_remcol(&self->csv_labtab, col);
-    for( int r = 0; r < self->csv_rowcnt; ++r )
-    {
-      csvrow_remcol(&self->csv_rowtab[r], col);
-    }
+    self->csv_rowtab[row]->cr_flags = mask;
   }
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_getcol  --  find column by label name
+ * csv_addrowflags
  * ------------------------------------------------------------------------- */
 
-int
-csv_getcol(csv_t *self, const char *lab)
+/*static inline*/ void
+csv_addrowflags(csv_t *self, int row, unsigned mask)
 {
-  for( int c=0, n = csv_cols(self); c < n; ++c )
+  if( csv_rowcheck(self, row) )
   {
-    char t[32];
-    const char *s = csvrow_getstring(self->csv_labtab, c, t, sizeof t);
-
-    if( !strcmp(s, lab) )
-    {
-      return c;
-    }
+    self->csv_rowtab[row]->cr_flags |= mask;
   }
+}
 
-  char *end = 0;
-  int   col = strtol(lab,&end,0);
+/* ------------------------------------------------------------------------- *
+ * csv_clrrowflags
+ * ------------------------------------------------------------------------- */
 
-  if( end != lab && *end == 0 && csv_colcheck(self, col) )
+/*static inline*/ void
+csv_clrrowflags(csv_t *self, int row, unsigned mask)
+{
+  if( csv_rowcheck(self, row) )
   {
-    return col;
+    self->csv_rowtab[row]->cr_flags &= ~mask;
   }
-
-  return -1;
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_index  --  find column by label name, abort if not existing
+ * csv_tstrowflags
  * ------------------------------------------------------------------------- */
 
-int
-csv_index(csv_t *self, const char *lab)
+/*static inline*/ unsigned
+csv_tstrowflags(const csv_t *self, int row, unsigned mask)
 {
-  int c = csv_getcol(self, lab);
-  if( c == -1 )
+  if( csv_rowcheck(self, row) )
   {
-    msg_fatal("csv_t: access to nonexisting column '%s'\n", lab);
+    return self->csv_rowtab[row]->cr_flags & mask;
   }
-  return c;
+  return 0;
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_label  --  column name lookup, abort if not existing
+ * csv_dropcellflags  --  forget all cell flags
  * ------------------------------------------------------------------------- */
 
-const char *
-csv_label(const csv_t *self, int col)
+static void
+csv_dropcellflags(csv_t *self)
 {
-  if( col < 0 || col >= csv_cols(self) )
+  for( int c = 0; c < self->csv_cellcols; ++c )
   {
-    msg_fatal("csv_t: column access out of boulds [%d / %d]\n",
-              col, csv_cols(self));
+    free(self->csv_cellflags[c]);
   }
-  return csvrow_getstring(self->csv_labtab, col, 0,0);
-}
+  free(self->csv_cellflags);
 
-/* - - - - - - - - - - - - - - - - - - - *
- * CSV parser data
- * - - - - - - - - - - - - - - - - - - - */
-typedef struct {
-  int error;
-  size_t size;
-  char *data;
-  FILE *file;
-  FILE *fnew;
-  int sep;
-  int cols;
-  char **col;
-  int *idx;
-  int cnt;
-  const char *path;
-} parser_t;
+  self->csv_cellflags = 0;
+  self->csv_cellcols  = 0;
+  self->csv_cellrows  = 0;
+}
 
+/* ------------------------------------------------------------------------- *
+ * csv_dropschema  --  detach table from label index
+ * ------------------------------------------------------------------------- */
 
-/* - - - - - - - - - - - - - - - - - - - *
- * initialize CSV parser data
- * - - - - - - - - - - - - - - - - - - - */
 static void
-parser_init(parser_t *self)
+csv_dropschema(csv_t *self)
 {
-  self->error = 0;
-  self->size = 0x1000;
-  self->data = malloc(self->size);
-  if ( self->data == NULL ) abort();
-  self->file = 0;
-  self->fnew = 0;
-  self->sep = ',';
-  self->cols = 1;
-  self->col = 0;
-  self->idx = 0;
-  self->cnt = 0;
-  self->path = 0;
+  csvschema_delete(self->csv_schema);
+  self->csv_schema = 0;
 }
 
-/* - - - - - - - - - - - - - - - - - - - *
- * free resources allocated by CSV parser
- * - - - - - - - - - - - - - - - - - - - */
-static void
-parser_free(parser_t *self)
+/* ------------------------------------------------------------------------- *
+ * csv_cellflags_slot  --  flag storage for cell, allocated on demand
+ * ------------------------------------------------------------------------- */
+
+static unsigned char *
+csv_cellflags_slot(csv_t *self, int row, int col)
 {
-  if ( self )
+  if( col >= self->csv_cellcols )
   {
-    if( self->fnew != 0 ) fclose(self->fnew);
-    if ( self->data ) free(self->data);
-    if ( self->col ) free(self->col);
-    if ( self->idx ) free(self->idx);
-
-    free(self);
-  }
-}
+    int cols = csv_cols(self);
 
-/* - - - - - - - - - - - - - - - - - - - *
- * open CSV file
- *
- * This function creates, initializes
- * parser data structure and opens input
- * CSV file.
- * - - - - - - - - - - - - - - - - - - - */
-static parser_t *
-parser_open(const char* path)
-{
-  parser_t *self = malloc(sizeof(parser_t));
-  if ( self == NULL ) abort();
-  parser_init(self);
+    self->csv_cellflags = realloc(self->csv_cellflags,
+                                  cols * sizeof *self->csv_cellflags);
+    if ( self->csv_cellflags == NULL ) abort();
 
-  if( !path || !strcmp(path, "-") )
-  {
-    self->file = stdin;
-    self->path = "<stdin>";
+    for( int c = self->csv_cellcols; c < cols; ++c )
+    {
+      self->csv_cellflags[c] = 0;
+    }
+    self->csv_cellcols = cols;
   }
-  else
+
+  if( row >= self->csv_cellrows )
   {
-    self->path = path;
-    self->file = self->fnew = fopen(path, "r");
+    int rows = self->csv_rowmax;
+
+    for( int c = 0; c < self->csv_cellcols; ++c )
+    {
+      if( self->csv_cellflags[c] != 0 )
+      {
+        self->csv_cellflags[c] = realloc(self->csv_cellflags[c], rows);
+        if ( self->csv_cellflags[c] == NULL ) abort();
+        memset(self->csv_cellflags[c] + self->csv_cellrows, 0,
+               rows - self->csv_cellrows);
+      }
+    }
+    self->csv_cellrows = rows;
   }
-  if ( !self->file )
+
+  if( self->csv_cellflags[col] == 0 )
   {
-    self->error = -1;
+    self->csv_cellflags[col] = calloc(self->csv_cellrows, 1);
+    if ( self->csv_cellflags[col] == NULL ) abort();
   }
-  return self;
+
+  return &self->csv_cellflags[col][row];
 }
 
-/* - - - - - - - - - - - - - - - - - - - *
- * fetch line of input
- * - - - - - - - - - - - - - - - - - - - */
-static int
-parser_read(parser_t *self)
+/* ------------------------------------------------------------------------- *
+ * csv_getcellflags
+ *
+ * Cells do not have room for flags, so CF_USRx flags are kept in
+ * per column side tables that are allocated only for columns that
+ * have flags set. The tables are indexed by row and column position
+ * and are discarded when rows or columns are deleted or reordered.
+ * ------------------------------------------------------------------------- */
+
+/*static inline*/ unsigned
+csv_getcellflags(const csv_t *self, int row, int col)
 {
-  for( ;; )
+  if( csv_rowcheck(self, row) && csv_colcheck(self, col) &&
+      row < self->csv_cellrows && col < self->csv_cellcols &&
+      self->csv_cellflags[col] != 0 )
   {
-    int n = getline(&self->data, &self->size, self->file);
-    if( n <= 0 )
-    {
-      return 1;
-    }
-
-    if( *self->data == '#' ) continue;
-
-    if( n > 0 && self->data[n-1] == '\n' ) self->data[--n] = 0;
-    if( n > 0 && self->data[n-1] == '\r' ) self->data[--n] = 0;
-
-    //printf(">>%s<<\n", data);
-    return 0;
+    return self->csv_cellflags[col][row];
   }
   return 0;
 }
 
-/* - - - - - - - - - - - - - - - - - - - *
- * slice line of input
- * - - - - - - - - - - - - - - - - - - - */
+/* ------------------------------------------------------------------------- *
+ * csv_tstcellflags
+ * ------------------------------------------------------------------------- */
 
-static void
-parser_slice(parser_t *self)
+/*static inline*/ unsigned
+csv_tstcellflags(const csv_t *self, int row, int col, unsigned mask)
 {
-  char *pos = self->data;
-  self->cnt = 0;
-  self->col[self->cnt++] = pos;
+  return csv_getcellflags(self, row, col) & mask;
+}
 
-  for( ;; )
-  {
-    switch( *pos )
-    {
-    case '\t': case ',': case ';':
-      if( *pos == self->sep )
-      {
-        *pos++ = 0, self->col[self->cnt] = pos;
-        if( self->cnt++ == self->cols ) return;
-        break;
-      }
-    default:
-      ++pos;
-      break;
+/* ------------------------------------------------------------------------- *
+ * csv_setcellflags
+ * ------------------------------------------------------------------------- */
 
-    case 0x00: case '\r': case '\n':
-      return;
-    }
+/*static inline*/ void
+csv_setcellflags(csv_t *self, int row, int col, unsigned mask)
+{
+  if( csv_rowcheck(self, row) && csv_colcheck(self, col) )
+  {
+    *csv_cellflags_slot(self, row, col) = mask;
   }
 }
 
+/* ------------------------------------------------------------------------- *
+ * csv_addcellflags
+ * ------------------------------------------------------------------------- */
 
-/* - - - - - - - - - - - - - - - - - - - *
- * parse the input data
- * - - - - - - - - - - - - - - - - - - - */
-
-static void
-csv_parse(csv_t *self, parser_t *parser)
+/*static inline*/ void
+csv_addcellflags(csv_t *self, int row, int col, unsigned mask)
 {
-  csv_setsource(self, parser->path);
-
-  /* - - - - - - - - - - - - - - - - - - - *
-   * parse header
-   * - - - - - - - - - - - - - - - - - - - */
-
-  for( ;; )
+  if( csv_rowcheck(self, row) && csv_colcheck(self, col) )
   {
-    if( parser_read(parser) )
-    {
-      msg_warning("%s: EOF while reading CSV header\n", parser->path);
-      return;
-    }
-
-    if( *parser->data == 0 )
-    {
-      if( parser_read(parser) )
-      {
-        msg_warning("%s: EOF after reading CSV header\n", parser->path);
-        return;
-      }
-      break;
-    }
-
-    char *value = strchr(parser->data, '=');
-
-    if( value == 0 )
-    {
-      msg_warning("%s: missing CSV header terminator\n", parser->path);
-      break;
-    }
-
-    *value++ = 0;
-    csv_addvar(self, cstring_strip(parser->data), cstring_strip(value));
+    *csv_cellflags_slot(self, row, col) |= mask;
   }
+}
 
-  /* - - - - - - - - - - - - - - - - - - - *
-   * separator autodetect
-   * - - - - - - - - - - - - - - - - - - - */
-
-  if( *parser->data == 0 )
-  {
-    msg_warning("%s: empty CSV label row\n", parser->path);
-    return;
-  }
+/* ------------------------------------------------------------------------- *
+ * csv_clrcellflags
+ * ------------------------------------------------------------------------- */
 
+/*static inline*/ void
+csv_clrcellflags(csv_t *self, int row, int col, unsigned mask)
+{
+  if( csv_tstcellflags(self, row, col, mask) )
   {
-    int sem = 1;
-    int tab = 1;
-    for( const char *s = parser->data; *s; ++s )
-    {
-      switch( *s )
-      {
-      case ',': ++parser->cols;  break;
-      case ';': ++sem;  break;
-      case '\t': ++tab; break;
-      }
-    }
-    if( parser->cols < sem ) parser->cols = sem, parser->sep = ';';
-    if( parser->cols < tab ) parser->cols = tab, parser->sep = '\t';
+    *csv_cellflags_slot(self, row, col) &= ~mask;
   }
+}
 
-  parser->col = calloc(parser->cols+1, sizeof *parser->col);
-  parser->idx = calloc(parser->cols+0, sizeof *parser->idx);
-
-  /* - - - - - - - - - - - - - - - - - - - *
-   * handle label row
-   * - - - - - - - - - - - - - - - - - - - */
-
-  parser_slice(parser);
+/* ------------------------------------------------------------------------- *
+ * csv_getrow
+ * ------------------------------------------------------------------------- */
 
-  for( int i = 0; i < parser->cnt; ++i )
+/*static inline*/ csvrow_t *
+csv_getrow(const csv_t *self, int row)
+{
+  if( !csv_rowcheck(self, row) )
   {
-    parser->idx[i] = csv_addcol(self, parser->col[i]);
-    //printf("[%3d] '%s'\n", parser->idx[i], parser->col[i]);
+    msg_fatal("csv_t: row access out of bounds [%d/%d]\n",
+              row, self->csv_rowcnt);
   }
+  // get rid of const status
+  return (csvrow_t *)self->csv_rowtab[row];
+}
 
-  /* - - - - - - - - - - - - - - - - - - - *
-   * handle data rows
-   * - - - - - - - - - - - - - - - - - - - */
-
-  for( ;; )
-  {
-    if( parser_read(parser) )
-    {
-      msg_warning("%s: missing CSV table terminator\n", parser->path);
-      return;
-    }
+/* ------------------------------------------------------------------------- *
+ * csv_getcell
+ * ------------------------------------------------------------------------- */
 
-    if( *parser->data == 0 )
-    {
-      break;
-    }
+/*static inline*/ csvcell_t *
+csv_getcell(const csv_t *self, int row, int col)
+{
+  return csvrow_getcell(csv_getrow(self, row), col);
+}
 
-    parser_slice(parser);
+/* ------------------------------------------------------------------------- *
+ * csv_isstring
+ * ------------------------------------------------------------------------- */
 
-    csvrow_t *row = csv_newrow(self);
+/*static inline*/ int
+csv_isstring(const csv_t *self, int row, int col)
+{
+  return csvcell_isstring(csv_getcell(self, row, col));
+}
 
-    for( int i = 0; i < parser->cnt; ++i )
-    {
-      double val;
-      const char *pos = parser->col[i];
+/* ------------------------------------------------------------------------- *
+ * csv_isnumber
+ * ------------------------------------------------------------------------- */
 
-      switch( *pos )
-      {
-      case '+':  case '-':  case '.':  case '0' ... '9':
-        val = csv_float_parse(&pos);
-        if( *pos == 0 )
-        {
-          csvrow_setnumber(row, parser->idx[i], val);
-          break;
-        }
-        // fall through
+/*static inline*/ int
+csv_isnumber(const csv_t *self, int row, int col)
+{
+  return csvcell_isnumber(csv_getcell(self, row, col));
+}
 
-      default:
-        csvrow_setstring(row, parser->idx[i], parser->col[i]);
-        break;
-      }
+/* ------------------------------------------------------------------------- *
+ * csv_getnumber
+ * ------------------------------------------------------------------------- */
 
-      //cellcnt += 1;
-      //numeric += csvrow_isnumber(row, idx[i]);
-    }
+/*static inline*/ double
+csv_getnumber(const csv_t *self, int row, int col)
+{
+  return csvcell_getnumber(csv_getcell(self, row, col));
+}
 
-    if( parser->cnt != parser->cols )
-    {
-      msg_warning("%s: too %s columns\n", parser->path,
-                  (parser->cnt < parser->cols) ? "few" : "much");
-    }
-  }
+/* ------------------------------------------------------------------------- *
+ * csv_getstring
+ * ------------------------------------------------------------------------- */
 
-  /* - - - - - - - - - - - - - - - - - - - *
-   * file parsed
-   * - - - - - - - - - - - - - - - - - - - */
+/*static inline*/ const char *
+csv_getstring(const csv_t *self, int row, int col, char *buff, size_t size)
+{
+  return csvcell_getstring(csv_getcell(self, row, col), buff, size);
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_load
+ * csv_setstring
  * ------------------------------------------------------------------------- */
-int
-csv_load(csv_t *self, const char *path)
-{
-  /* - - - - - - - - - - - - - - - - - - - *
-   * open file
-   * - - - - - - - - - - - - - - - - - - - */
-  parser_t *parser = parser_open(path);
 
-  if ( parser->error )
-  {
-    perror(path);
-  }
-  else
-  {
-    csv_parse(self, parser);
-  }
-  int rc = parser->error;
+/*static inline*/ void
+csv_setstring(csv_t *self, int row, int col, const char *text)
+{
+  csvcell_setstring(csv_getcell(self, row, col), text);
+}
 
-  /* - - - - - - - - - - - - - - - - - - - *
-   * cleanup
-   * - - - - - - - - - - - - - - - - - - - */
-  parser_free(parser);
+/* ------------------------------------------------------------------------- *
+ * csv_setnumber
+ * ------------------------------------------------------------------------- */
 
-  return rc;
+/*static inline*/ void
+csv_setnumber(csv_t *self, int row, int col, double numb)
+{
+  csvcell_setnumber(csv_getcell(self, row, col), numb);
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_save
+ * csv_setauto
  * ------------------------------------------------------------------------- */
 
-/* - - - - - - - - - - - - - - - - - - - *
- * CSV writer data
- * - - - - - - - - - - - - - - - - - - - */
-typedef struct {
-  int error;
-  FILE *file;
-  FILE *newf;
-  char *data;
-  int used;
-  int size;
-  const char *path;
-} writer_t;
-
-/* - - - - - - - - - - - - - - - - - - - *
- * initialize CSV writer data
- * - - - - - - - - - - - - - - - - - - - */
-static void
-writer_init(writer_t *self)
+/*static inline*/ void
+csv_setauto(csv_t *self, int row, int col, const char *text)
 {
-  self->size = 0x8000;
-  self->error = 0;
-  self->file = NULL;
-  self->newf = NULL;
-  self->data = malloc(self->size);
-  if (!self->data) abort();
-  self->used = 0;
-  self->path = NULL;
+  csvcell_setauto(csv_getcell(self, row, col), text);
 }
 
-/* - - - - - - - - - - - - - - - - - - - *
- * free resources allocated by CSV writer
- * - - - - - - - - - - - - - - - - - - - */
-static void
-writer_free(writer_t *self)
-{
-  if ( self->newf ) fclose(self->newf);
-  if ( self->data ) free(self->data);
+/* ------------------------------------------------------------------------- *
+ * csv_setsource
+ * ------------------------------------------------------------------------- */
 
-  free(self);
+void
+csv_setsource(csv_t *self, const char *path)
+{
+  free(self->csv_source);
+  self->csv_source = path ? strdup(path) : NULL;
 }
 
+/* ------------------------------------------------------------------------- *
+ * csv_getsource
+ * ------------------------------------------------------------------------- */
 
-/* - - - - - - - - - - - - - - - - - - - *
- * flush writer buffer to file
- * - - - - - - - - - - - - - - - - - - - */
-static void
-writer_flush(writer_t *self)
+const char *
+csv_getsource(const csv_t *self)
 {
-  fwrite(self->data, 1, self->used, self->file);
-  self->used = 0;
+  return self->csv_source ? self->csv_source : "<unset>";
 }
 
-/* - - - - - - - - - - - - - - - - - - - *
- * store text into writer buffer
- * - - - - - - - - - - - - - - - - - - - */
-static void
-writer_emit(writer_t *self, const char *str)
-{
-  while( *str )
-  {
-    if( self->used == self->size ) writer_flush(self);
-    self->data[self->used++] = *str++;
-  }
+/* ------------------------------------------------------------------------- *
+ * csv_ctor
+ * ------------------------------------------------------------------------- */
+
+enum { CSV_ROWPOOL_CHUNK = 1 << 20 };
+
+void
+csv_ctor(csv_t *self)
+{
+  array_ctor(&self->csv_head, csvvar_delete_cb);
+
+  self->csv_rowcnt = 0;
+  self->csv_rowmax = 256;
+  self->csv_colmax = 0;
+
+  self->csv_labtab = csvrow_create(0);
+  self->csv_rowtab = malloc(self->csv_rowmax * sizeof *self->csv_rowtab);
+
+  mem_pool_ctor(&self->csv_rowpool);
+  self->csv_rowpool.alloc = CSV_ROWPOOL_CHUNK;
+
+  self->csv_sepstr = 0;
+  self->csv_colflags = 0;
+  self->csv_source = 0;
+
+  self->csv_schema    = 0;
+  self->csv_cellflags = 0;
+  self->csv_cellcols  = 0;
+  self->csv_cellrows  = 0;
+
+  self->csv_flags  = 0;
 }
 
-/* - - - - - - - - - - - - - - - - - - - *
- * creates new CSV output file and
- * initializes writer data
- * - - - - - - - - - - - - - - - - - - - */
-static writer_t *
-writer_open(const char *path)
+/* ------------------------------------------------------------------------- *
+ * csv_dtor
+ * ------------------------------------------------------------------------- */
+
+void
+csv_dtor(csv_t *self)
 {
-  writer_t *self = malloc(sizeof(writer_t));
-  if ( !self ) abort();
-  writer_init(self);
+  array_dtor(&self->csv_head);
+  csvrow_delete(self->csv_labtab);
+  mem_pool_dtor(&self->csv_rowpool);
+  free(self->csv_rowtab);
+  free(self->csv_sepstr);
+  free(self->csv_colflags);
+  free(self->csv_source);
+  csv_dropcellflags(self);
+  csv_dropschema(self);
+}
 
-  if( path == NULL || !strcmp(path, "-") )
-  {
-    self->file = stdout;
-    self->path = "<stdout>";
-  }
-  else
-  {
-    self->file = self->newf = fopen(path, "w");
-  }
-  if ( !self->file ) {
-    self->error = -1;
-  }
+/* ------------------------------------------------------------------------- *
+ * csv_create
+ * ------------------------------------------------------------------------- */
+
+csv_t *
+csv_create(void)
+{
+  csv_t *self = calloc(1, sizeof *self);
+  csv_ctor(self);
   return self;
 }
 
-/* - - - - - - - - - - - - - - - - - - - *
- * writes data to CSV file
- * - - - - - - - - - - - - - - - - - - - */
-static void
-csv_write(csv_t *self, writer_t *writer)
+/* ------------------------------------------------------------------------- *
+ * csv_copy  --  create independent copy of a table
+ * ------------------------------------------------------------------------- */
+
+csv_t *
+csv_copy(const csv_t *self)
 {
-  csv_setsource(self, writer->path);
-  /* - - - - - - - - - - - - - - - - - - - *
-   * output header
-   * - - - - - - - - - - - - - - - - - - - */
+  csv_t *copy = csv_create();
+  int    cols = csv_cols(self);
 
-  if( !(self->csv_flags & CTF_NO_HEADER) )
+  for( int i = 0, n = array_size(&self->csv_head); i < n; ++i )
   {
-    for( int i=0, n=array_size(&self->csv_head); i < n; ++i )
-    {
-      csvvar_t *var = array_get(&self->csv_head, i);
-      writer_emit(writer, var->cv_key);
-      writer_emit(writer, "=");
-      writer_emit(writer, var->cv_val);
-      writer_emit(writer, "\n");
-    }
-    writer_emit(writer, "\n");
+    csvvar_t *var = array_get(&self->csv_head, i);
+    csv_addvar(copy, var->cv_key, var->cv_val);
   }
 
-  /* - - - - - - - - - - - - - - - - - - - *
-   * output table labels
-   * - - - - - - - - - - - - - - - - - - - */
-
-  if( !(self->csv_flags & CTF_NO_LABELS) )
-  {
-    csvrow_t *row = self->csv_labtab;
+  copy->csv_flags = self->csv_flags;
 
-    for( int c=0, n=csv_cols(self); c < n; ++c )
-    {
-      csvcell_t *cell = csvrow_getcell(row, c);
+  csvrow_delete(copy->csv_labtab);
+  copy->csv_labtab = csvrow_copy(self->csv_labtab);
+  copy->csv_schema = csvschema_share(self->csv_schema);
 
-      if( c != 0 )
-      {
-        writer_emit(writer, ",");
-      }
-      if( cell->cc_string )
-      {
-        writer_emit(writer, cell->cc_string);
-      }
-      else
-      {
-        char t[32];
-        writer_emit(writer, csv_float_to_string(cell->cc_number, t, sizeof t));
-      }
-    }
-    writer_emit(writer, "\n");
+  copy->csv_colflags = calloc(cols + 1, sizeof *copy->csv_colflags);
+  if( cols > 0 )
+  {
+    memcpy(copy->csv_colflags, self->csv_colflags,
+           cols * sizeof *copy->csv_colflags);
   }
 
-  /* - - - - - - - - - - - - - - - - - - - *
-   * output table body
-   * - - - - - - - - - - - - - - - - - - - */
+  copy->csv_rowmax = self->csv_rowcnt + 256;
+  copy->csv_rowtab = realloc(copy->csv_rowtab,
+                             copy->csv_rowmax * sizeof *copy->csv_rowtab);
+
+  copy->csv_colmax = self->csv_colmax;
 
   for( int r = 0; r < self->csv_rowcnt; ++r )
   {
     const csvrow_t *row = self->csv_rowtab[r];
 
-    for( int c = 0; c < row->cr_cols; ++c )
-    {
-      csvcell_t *cell = csvrow_getcell(row, c);
+    copy->csv_rowtab[r] = mem_pool_alloc(&copy->csv_rowpool,
+                                         csvrow_sizeof(copy->csv_colmax));
+    memcpy(copy->csv_rowtab[r], row, csvrow_sizeof(row->cr_cols));
+  }
+  copy->csv_rowcnt = self->csv_rowcnt;
 
-      if( c != 0 )
-      {
-        writer_emit(writer, ",");
-      }
-      if( cell->cc_string )
-      {
-        writer_emit(writer, cell->cc_string);
-      }
-      else
+  for( int c = 0; c < self->csv_cellcols; ++c )
+  {
+    for( int r = 0; self->csv_cellflags[c] && r < self->csv_rowcnt; ++r )
+    {
+      if( self->csv_cellflags[c][r] != 0 )
       {
-        char t[32];
-        writer_emit(writer, csv_float_to_string(cell->cc_number, t, sizeof t));
+        csv_setcellflags(copy, r, c, self->csv_cellflags[c][r]);
       }
     }
-    writer_emit(writer, "\n");
   }
 
-  if( !(self->csv_flags & CTF_NO_TERMINATOR) )
-  {
-    writer_emit(writer, "\n");
-  }
+  csv_setseparator(copy, self->csv_sepstr);
+  csv_setsource(copy, self->csv_source);
 
-  writer_flush(writer);
+  return copy;
+}
 
-  if( ferror(writer->file) )
+/* ------------------------------------------------------------------------- *
+ * csv_delete
+ * ------------------------------------------------------------------------- */
+
+void
+csv_delete(csv_t *self)
+{
+  if( self != 0 )
   {
-    perror(writer->path);
-    return;
+    csv_dtor(self);
+    free(self);
   }
-  writer->error = 0;
 }
 
-int
-csv_save(csv_t *self, const char *path)
-{
+/* ------------------------------------------------------------------------- *
+ * csv_delete_cb
+ * ------------------------------------------------------------------------- */
 
+void
+csv_delete_cb(void *self)
+{
+  csv_delete(self);
+}
 
-// QUARANTINE   auto void emitf(const char *fmt, ...)
-// QUARANTINE   {
-// QUARANTINE     char tmp[1024];
-// QUARANTINE     va_list va;
-// QUARANTINE     va_start(va, fmt);
-// QUARANTINE     vsnprintf(tmp, sizeof tmp, fmt, va);
-// QUARANTINE     va_end(va);
-// QUARANTINE     emit(tmp);
-// QUARANTINE   }
+/* ------------------------------------------------------------------------- *
+ * csv_addvar
+ * ------------------------------------------------------------------------- */
 
-  /* - - - - - - - - - - - - - - - - - - - *
-   * open output
-   * - - - - - - - - - - - - - - - - - - - */
+void
+csv_addvar(csv_t *self, const char *key, const char *val)
+{
+  array_add(&self->csv_head, csvvar_create(key, val));
+}
 
-  writer_t *writer = writer_open(path);
+/* ------------------------------------------------------------------------- *
+ * csv_delrow
+ * ------------------------------------------------------------------------- */
 
-  if( !writer )
+void
+csv_delrow(csv_t *self, int row)
+{
+  if( csv_rowcheck(self, row) )
   {
-    perror(path);
+    csv_dropcellflags(self);
+    for( ; row < self->csv_rowcnt; ++row )
+    {
+      self->csv_rowtab[row+0] = self->csv_rowtab[row+1];
+    }
+    self->csv_rowcnt -= 1;
   }
-  else
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_delrow_nocompact
+ * ------------------------------------------------------------------------- */
+
+void
+csv_delrow_nocompact(csv_t *self, int row)
+{
+  if( csv_rowcheck(self, row) )
   {
-    csv_write(self, writer);
+    self->csv_rowtab[row] = 0;
   }
+}
 
-  int rc = writer->error;
-  writer_free(writer);
+/* ------------------------------------------------------------------------- *
+ * csv_compactrows
+ * ------------------------------------------------------------------------- */
 
-  return rc;
+void
+csv_compactrows(csv_t *self)
+{
+  int di = 0, si = 0;
+
+  csv_dropcellflags(self);
+
+  while( si < self->csv_rowcnt )
+  {
+    csvrow_t *r = self->csv_rowtab[si++];
+    if( r != 0 )
+    {
+      self->csv_rowtab[di++] = r;
+    }
+  }
+  self->csv_rowcnt = di;
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_load
+ * csv_rebuildrows  --  copy rows to fresh storage with new column layout
+ *
+ * Column c of the new rows gets the value of old column map[c], or
+ * an empty cell if map[c] is negative, and room is left for size
+ * cells in total. Done in one pass over the rows, after which the
+ * old storage is released as a whole.
  * ------------------------------------------------------------------------- */
 
-// QUARANTINE static int count(const char *s, int c)
-// QUARANTINE {
-// QUARANTINE   int n = 0;
-// QUARANTINE   while( *s )
-// QUARANTINE   {
-// QUARANTINE     if( *s++ == c ) ++n;
-// QUARANTINE   }
-// QUARANTINE   return n;
-// QUARANTINE }
-// QUARANTINE
-// QUARANTINE static int slice(char ***pv, int *pn, char *s, int c)
-// QUARANTINE {
-// QUARANTINE   int i = 0;
-// QUARANTINE   int n = *pn;
-// QUARANTINE   char **v = *pv;
-// QUARANTINE
-// QUARANTINE   for( ;; )
-// QUARANTINE   {
-// QUARANTINE     if( i == n )
-// QUARANTINE     {
-// QUARANTINE       v = realloc(v, ++n * sizeof *v);
-// QUARANTINE     }
-// QUARANTINE     v[i++] = s;
+static void
+csv_rebuildrows(csv_t *self, int cols, int size, const int *map)
+{
+  mem_pool_t pool;
+
+  self->csv_colmax = size;
+
+  if( self->csv_rowcnt == 0 )
+  {
+    return;
+  }
+
+  mem_pool_ctor(&pool);
+  pool.alloc = self->csv_rowpool.alloc;
+
+  for( int r = 0; r < self->csv_rowcnt; ++r )
+  {
+    csvrow_t *src = self->csv_rowtab[r];
+    csvrow_t *dst = 0;
+
+    if( src == 0 )
+    {
+      continue;
+    }
+
+    dst = mem_pool_alloc(&pool, csvrow_sizeof(size));
+    dst->cr_flags = src->cr_flags;
+    dst->cr_cols  = cols;
+
+    for( int c = 0; c < cols; ++c )
+    {
+      if( map[c] < 0 || map[c] >= src->cr_cols )
+      {
+        csvcell_ctor(&dst->cr_celltab[c]);
+      }
+      else
+      {
+        dst->cr_celltab[c] = src->cr_celltab[map[c]];
+      }
+    }
+    self->csv_rowtab[r] = dst;
+  }
+
+  mem_pool_dtor(&self->csv_rowpool);
+  self->csv_rowpool = pool;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_reserve  --  make room for rows and columns in advance
+ *
+ * Rows added after this do not need to grow the row table until
+ * there are more than the given number, and columns can be added
+ * until there are more than the given number without moving rows.
+ * ------------------------------------------------------------------------- */
+
+void
+csv_reserve(csv_t *self, int rows, int cols)
+{
+  if( rows > self->csv_rowmax )
+  {
+    self->csv_rowmax = rows;
+    self->csv_rowtab = realloc(self->csv_rowtab,
+                               self->csv_rowmax * sizeof *self->csv_rowtab);
+    if ( self->csv_rowtab == NULL ) abort();
+  }
+
+  if( cols > self->csv_colmax )
+  {
+    int have = csv_cols(self);
+    int map[have + 1];
+
+    for( int c = 0; c < have; ++c )
+    {
+      map[c] = c;
+    }
+    csv_rebuildrows(self, have, cols, map);
+  }
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_newrow
+ * ------------------------------------------------------------------------- */
+
+csvrow_t *
+csv_newrow(csv_t *self)
+{
+  if( self->csv_rowcnt == self->csv_rowmax )
+  {
+    self->csv_rowmax = self->csv_rowmax * 4 / 3;
+    self->csv_rowtab = realloc(self->csv_rowtab,
+                               self->csv_rowmax * sizeof *self->csv_rowtab);
+  }
+
+  if( self->csv_colmax < csv_cols(self) )
+  {
+    self->csv_colmax = csv_cols(self);
+  }
+
+  csvrow_t *r = csvrow_create_pooled(&self->csv_rowpool, csv_cols(self),
+                                     self->csv_colmax);
+  self->csv_rowtab[self->csv_rowcnt++] = r;
+  return r;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_memstats  --  account bytes held by table
+ * ------------------------------------------------------------------------- */
+
+void
+csv_memstats(const csv_t *self, csvmemstat_t *stats)
+{
+  size_t used;
+
+  memset(stats, 0, sizeof *stats);
+
+  stats->ms_rows   = self->csv_rowcnt;
+  stats->ms_cols   = csv_cols(self);
+  stats->ms_rowtab = self->csv_rowmax * sizeof *self->csv_rowtab;
+
+  for( int r = 0; r < self->csv_rowcnt; ++r )
+  {
+    const csvrow_t *row = self->csv_rowtab[r];
+
+    stats->ms_rowhead += sizeof *row;
+    stats->ms_cells   += row->cr_cols * sizeof *row->cr_celltab;
+
+    for( int c = 0; c < row->cr_cols; ++c )
+    {
+      stats->ms_strcells += csvcell_isstring(&row->cr_celltab[c]);
+    }
+  }
+
+  mem_pool_usage(&self->csv_rowpool, &used, &stats->ms_rowpool);
+
+  if( stats->ms_rowpool > stats->ms_rowhead + stats->ms_cells )
+  {
+    stats->ms_slack = stats->ms_rowpool - stats->ms_rowhead - stats->ms_cells;
+  }
+
+  if( self->csv_labtab != 0 )
+  {
+    stats->ms_labels = csvrow_sizeof(self->csv_labtab->cr_cols);
+  }
+
+  stats->ms_head = self->csv_head.alloc * sizeof *self->csv_head.data;
+
+  for( size_t i = 0; i < array_size(&self->csv_head); ++i )
+  {
+    const csvvar_t *var = array_get((array_t *)&self->csv_head, i);
+
+    stats->ms_head += sizeof *var;
+    stats->ms_head += strlen(var->cv_key) + 1 + strlen(var->cv_val) + 1;
+  }
+
+  stats->ms_flags = (stats->ms_cols + 1) * sizeof *self->csv_colflags;
+
+  for( int c = 0; c < self->csv_cellcols; ++c )
+  {
+    stats->ms_flags += sizeof *self->csv_cellflags;
+    if( self->csv_cellflags[c] != 0 )
+    {
+      stats->ms_flags += self->csv_cellrows;
+    }
+  }
+
+  const csvschema_t *schema = self->csv_schema;
+
+  if( schema != 0 && schema->cs_refs == 1 )
+  {
+    stats->ms_schema = (sizeof *schema +
+                        schema->cs_max * (sizeof *schema->cs_label +
+                                          sizeof *schema->cs_hval +
+                                          sizeof *schema->cs_type +
+                                          sizeof *schema->cs_stat) +
+                        (schema->cs_mask + 1) * sizeof *schema->cs_slot);
+  }
+
+  stats->ms_total = (stats->ms_rowtab + stats->ms_rowpool + stats->ms_labels +
+                     stats->ms_head + stats->ms_flags + stats->ms_schema);
+
+  if( stats->ms_rowpool < stats->ms_rowhead + stats->ms_cells )
+  {
+    // rows allocated outside the pool
+    stats->ms_total += stats->ms_rowhead + stats->ms_cells - stats->ms_rowpool;
+  }
+}
+
+/* ------------------------------------------------------------------------- *
+ * csvmemstat_emit  --  print table memory statistics
+ * ------------------------------------------------------------------------- */
+
+void
+csvmemstat_emit(const csvmemstat_t *self, FILE *file)
+{
+  fprintf(file, "table:    %zu rows, %zu columns, %zu string cells\n",
+          self->ms_rows, self->ms_cols, self->ms_strcells);
+  fprintf(file, "  rowtab  %12zu bytes\n", self->ms_rowtab);
+  fprintf(file, "  rows    %12zu bytes\n", self->ms_rowhead);
+  fprintf(file, "  cells   %12zu bytes\n", self->ms_cells);
+  fprintf(file, "  slack   %12zu bytes of %zu in row pool\n",
+          self->ms_slack, self->ms_rowpool);
+  fprintf(file, "  labels  %12zu bytes\n", self->ms_labels);
+  fprintf(file, "  header  %12zu bytes\n", self->ms_head);
+  fprintf(file, "  flags   %12zu bytes\n", self->ms_flags);
+  fprintf(file, "  schema  %12zu bytes\n", self->ms_schema);
+  fprintf(file, "  total   %12zu bytes\n", self->ms_total);
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_getschema  --  label index of table, built on first use
+ * ------------------------------------------------------------------------- */
+
+csvschema_t *
+csv_getschema(csv_t *self)
+{
+  if( self->csv_schema == 0 )
+  {
+    self->csv_schema = csvschema_create();
+
+    for( int c = 0, n = csv_cols(self); c < n; ++c )
+    {
+      char t[32];
+      csvschema_add(self->csv_schema,
+                    csvrow_getstring(self->csv_labtab, c, t, sizeof t));
+    }
+  }
+  return self->csv_schema;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_setschema  --  share schema of another table with same labels
+ *
+ * Returns 0 if the schema was taken into use, or -1 if the labels
+ * do not match the table.
+ * ------------------------------------------------------------------------- */
+
+int
+csv_setschema(csv_t *self, csvschema_t *schema)
+{
+  if( !csvschema_equal(csv_getschema(self), schema) )
+  {
+    return -1;
+  }
+  if( self->csv_schema != schema )
+  {
+    csv_dropschema(self);
+    self->csv_schema = csvschema_share(schema);
+  }
+  return 0;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_addcol  --  find/add column by label name
+ * ------------------------------------------------------------------------- */
+
+int
+csv_addcol(csv_t *self, const char *lab)
+{
+  csvschema_t *schema = csv_getschema(self);
+  int          c      = csvschema_find(schema, lab);
+
+  if( c >= 0 )
+  {
+    return c;
+  }
+
+  if( schema->cs_refs > 1 )
+  {
+    // copy on write
+    csv_dropschema(self);
+    schema = csv_getschema(self);
+  }
+
+  c = csv_cols(self);
+
+  if( c >= self->csv_colmax )
+  {
+    // grow geometrically, so that columns added one at a time
+    // do not need to move all rows for every addition
+    csv_reserve(self, 0, c + 1 + c / 2);
+  }
+
+  for( int r = 0; r < self->csv_rowcnt; ++r )
+  {
+    csvrow_t *row = self->csv_rowtab[r];
+
+    if( row != 0 )
+    {
+      csvcell_ctor(&row->cr_celltab[row->cr_cols++]);
+    }
+  }
+
+  csvrow_addcol(&self->csv_labtab);
+  csvrow_setstring(self->csv_labtab, c, lab);
+  csvschema_add(schema, lab);
+
+  self->csv_colflags = realloc(self->csv_colflags,
+                               csv_cols(self) * sizeof *self->csv_colflags);
+  self->csv_colflags[c] = 0;
+
+  return c;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_remcol
+ * ------------------------------------------------------------------------- */
+
+void
+csv_remcol(csv_t *self, int col)
+{
+  if( csv_colcheck(self, col) )
+  {
+    csv_dropcellflags(self);
+    csv_dropschema(self);
+
+    for( int r = 0; r < self->csv_rowcnt; ++r )
+    {
+      csvrow_t *row = self->csv_rowtab[r];
+
+      if( row != 0 && col < row->cr_cols )
+      {
+        // the row keeps its room for the removed cell
+        memmove(&row->cr_celltab[col], &row->cr_celltab[col + 1],
+                (row->cr_cols - col - 1) * sizeof *row->cr_celltab);
+        row->cr_cols -= 1;
+      }
+    }
+    csvrow_remcol(&self->csv_labtab, col);
+  }
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_getcol  --  find column by label name
+ * ------------------------------------------------------------------------- */
+
+int
+csv_getcol(csv_t *self, const char *lab)
+{
+  int c = csvschema_find(csv_getschema(self), lab);
+
+  if( c >= 0 )
+  {
+    return c;
+  }
+
+  char *end = 0;
+  int   col = strtol(lab,&end,0);
+
+  if( end != lab && *end == 0 && csv_colcheck(self, col) )
+  {
+    return col;
+  }
+
+  return -1;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_index  --  find column by label name, abort if not existing
+ * ------------------------------------------------------------------------- */
+
+int
+csv_index(csv_t *self, const char *lab)
+{
+  int c = csv_getcol(self, lab);
+  if( c == -1 )
+  {
+    msg_fatal("csv_t: access to nonexisting column '%s'\n", lab);
+  }
+  return c;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_label  --  column name lookup, abort if not existing
+ * ------------------------------------------------------------------------- */
+
+const char *
+csv_label(const csv_t *self, int col)
+{
+  if( col < 0 || col >= csv_cols(self) )
+  {
+    msg_fatal("csv_t: column access out of boulds [%d / %d]\n",
+              col, csv_cols(self));
+  }
+  return csvrow_getstring(self->csv_labtab, col, 0,0);
+}
+
+/* - - - - - - - - - - - - - - - - - - - *
+ * CSV parser data
+ * - - - - - - - - - - - - - - - - - - - */
+typedef struct {
+  int error;
+  size_t size;
+  char *data;
+  FILE *file;
+  FILE *fnew;
+  int sep;
+  int cols;
+  const char **col;
+  size_t *len;
+  int *idx;
+  int cnt;
+  const char *path;
+
+  reader_t *map;     // mmap backend, used for zero-copy parsing
+  const char *curr;  // next unparsed byte in mapped data
+  const char *tail;  // end of mapped data
+  const char *fill;  // end of data read from followed input
+
+  const char *line;  // current line, not necessarily zero terminated
+  size_t llen;       // length of current line
+
+  csv_scan_t scan;   // block scanner over mapped table body
+
+  csv_t *csv;        // parsed rows are added to table, or ...
+  csvrow_t **rowtab; // ... collected here by parallel workers
+  mem_pool_t rowpool; // storage for collected rows
+  int width;         // number of cells in collected rows
+  int cells;         // cells allocated for collected rows
+  int rowcnt;
+  int rowmax;
+
+  int few;           // rows with too few columns
+  int much;          // rows with too much columns
+
+  int limit;         // max rows to parse per call, or zero
+
+  calc_t *where;     // rows not satisfying this are skipped, or NULL
+  const char *wexpr; // predicate source, compiled again for workers
+  int *wfld;         // table column -> last input field, shared
+  char **wbuf;       // zero terminated copies of string fields
+  size_t *wcap;      // allocated sizes of the copies
+} parser_t;
+
+
+/* - - - - - - - - - - - - - - - - - - - *
+ * initialize CSV parser data
+ * - - - - - - - - - - - - - - - - - - - */
+static void
+parser_init(parser_t *self)
+{
+  self->error = 0;
+  self->size = 0x1000;
+  self->data = malloc(self->size);
+  if ( self->data == NULL ) abort();
+  self->file = 0;
+  self->fnew = 0;
+  self->sep = ',';
+  self->cols = 1;
+  self->col = 0;
+  self->len = 0;
+  self->idx = 0;
+  self->cnt = 0;
+  self->path = 0;
+  self->map = 0;
+  self->curr = 0;
+  self->tail = 0;
+  self->fill = 0;
+  self->line = 0;
+  self->llen = 0;
+  csv_scan_init(&self->scan, 0, 0, 0);
+  self->csv = 0;
+  self->rowtab = 0;
+  mem_pool_ctor(&self->rowpool);
+  self->rowpool.alloc = CSV_ROWPOOL_CHUNK;
+  self->width = 0;
+  self->cells = 0;
+  self->rowcnt = 0;
+  self->rowmax = 0;
+  self->few = 0;
+  self->much = 0;
+  self->limit = 0;
+  self->where = 0;
+  self->wexpr = 0;
+  self->wfld = 0;
+  self->wbuf = 0;
+  self->wcap = 0;
+}
+
+/* - - - - - - - - - - - - - - - - - - - *
+ * release row predicate of the parser
+ * - - - - - - - - - - - - - - - - - - - */
+static void
+parser_unwhere(parser_t *self)
+{
+  if( self->wbuf != 0 )
+  {
+    for( int i = 0; i < self->cols; ++i )
+    {
+      free(self->wbuf[i]);
+    }
+  }
+  free(self->wbuf), self->wbuf = 0;
+  free(self->wcap), self->wcap = 0;
+
+  calc_delete(self->where), self->where = 0;
+}
+
+/* - - - - - - - - - - - - - - - - - - - *
+ * free resources allocated by CSV parser
+ * - - - - - - - - - - - - - - - - - - - */
+static void
+parser_free(parser_t *self)
+{
+  if ( self )
+  {
+    if( self->fnew != 0 ) fclose(self->fnew);
+    if ( self->map ) reader_delete(self->map);
+    if ( self->data ) free(self->data);
+    if ( self->col ) free(self->col);
+    if ( self->len ) free(self->len);
+    if ( self->idx ) free(self->idx);
+
+    parser_unwhere(self);
+    free(self->wfld);
+    mem_pool_dtor(&self->rowpool);
+
+    free(self);
+  }
+}
+
+/* - - - - - - - - - - - - - - - - - - - *
+ * map CSV file to memory
+ *
+ * Regular files are parsed directly from
+ * the mmapped content via reader_t. If the
+ * file does not end in a newline, the
+ * number parser could run past the end of
+ * the mapping, so stdio is used instead.
+ * - - - - - - - - - - - - - - - - - - - */
+static void
+parser_map(parser_t *self, const char *path)
+{
+  struct stat st;
+  int fd = path ? -1 : STDIN_FILENO;
+
+  if( path != 0 && stat(path, &st) != 0 )
+  {
+    return;
+  }
+  if( path == 0 && (fstat(fd, &st) != 0 || lseek(fd, 0, SEEK_CUR) != 0) )
+  {
+    return;
+  }
+  if( !S_ISREG(st.st_mode) || st.st_size == 0 )
+  {
+    return;
+  }
+
+  self->map = reader_create();
+
+  if( reader_attach(self->map, path) == 0 && self->map->head != 0 &&
+      self->map->tail[-1] == '\n' )
+  {
+    self->curr = self->map->head;
+    self->tail = self->map->tail;
+  }
+  else
+  {
+    reader_delete(self->map), self->map = 0;
+  }
+}
+
+/* - - - - - - - - - - - - - - - - - - - *
+ * open CSV file
+ *
+ * This function creates, initializes
+ * parser data structure and opens input
+ * CSV file.
+ * - - - - - - - - - - - - - - - - - - - */
+static parser_t *
+parser_open(const char* path, int use_mmap)
+{
+  parser_t *self = malloc(sizeof(parser_t));
+  if ( self == NULL ) abort();
+  parser_init(self);
+
+  if( !path || !strcmp(path, "-") )
+  {
+    self->path = "<stdin>";
+    if( use_mmap ) parser_map(self, 0);
+    if( !self->map ) self->file = stdin;
+  }
+  else
+  {
+    self->path = path;
+    if( use_mmap ) parser_map(self, path);
+    if( !self->map ) self->file = self->fnew = fopen(path, "r");
+  }
+  if ( !self->file && !self->map )
+  {
+    self->error = -1;
+  }
+  return self;
+}
+
+/* - - - - - - - - - - - - - - - - - - - *
+ * fetch line of input
+ *
+ * The line is left in self->line. From
+ * mmapped input the data is not copied,
+ * thus it is not zero terminated either.
+ * - - - - - - - - - - - - - - - - - - - */
+static int
+parser_next(parser_t *self)
+{
+  for( ;; )
+  {
+    ssize_t n;
+
+    if( self->map != 0 )
+    {
+      const char *beg = self->curr;
+      const char *end;
+
+      if( beg == self->tail )
+      {
+        return 1;
+      }
+
+      end = memchr(beg, '\n', self->tail - beg);
+      self->curr = end + 1;
+
+      if( *beg == '#' ) continue;
+
+      if( end > beg && end[-1] == '\r' ) --end;
+
+      self->line = beg;
+      self->llen = end - beg;
+      return 0;
+    }
+
+    n = getline(&self->data, &self->size, self->file);
+    if( n <= 0 )
+    {
+      return 1;
+    }
+
+    if( *self->data == '#' ) continue;
+
+    if( n > 0 && self->data[n-1] == '\n' ) self->data[--n] = 0;
+    if( n > 0 && self->data[n-1] == '\r' ) self->data[--n] = 0;
+
+    //printf(">>%s<<\n", data);
+    self->line = self->data;
+    self->llen = n;
+    return 0;
+  }
+  return 0;
+}
+
+/* - - - - - - - - - - - - - - - - - - - *
+ * fetch line of input as modifiable and
+ * zero terminated string in self->data
+ * - - - - - - - - - - - - - - - - - - - */
+static int
+parser_read(parser_t *self)
+{
+  if( parser_next(self) )
+  {
+    return 1;
+  }
+
+  if( self->line != self->data )
+  {
+    if( self->llen >= self->size )
+    {
+      self->size = self->llen + 256;
+      self->data = realloc(self->data, self->size);
+      if ( self->data == NULL ) abort();
+    }
+    memcpy(self->data, self->line, self->llen);
+    self->data[self->llen] = 0;
+    self->line = self->data;
+  }
+  return 0;
+}
+
+/* - - - - - - - - - - - - - - - - - - - *
+ * split fields using block scanner
+ *
+ * Fields are located in place, the input
+ * is not modified. Columns in excess are
+ * ignored, but are reflected in the field
+ * count. Scanning continues up to the end
+ * of line / scanned data, which is
+ * returned.
+ * - - - - - - - - - - - - - - - - - - - */
+
+static const char *
+parser_split(parser_t *self, csv_scan_t *scan, const char *beg)
+{
+  int stop = 0;
+
+  self->cnt = 0;
+  self->col[self->cnt] = beg;
+
+  for( ;; )
+  {
+    size_t      offs = csv_scan_next(scan);
+    const char *pos  = scan->cs_data + offs;
+
+    if( offs == scan->cs_size || *pos == '\n' )
+    {
+      if( !stop )
+      {
+        self->len[self->cnt] = pos - self->col[self->cnt];
+        self->cnt += 1;
+      }
+      return pos;
+    }
+
+    if( stop )
+    {
+      continue;
+    }
+
+    self->len[self->cnt] = pos - self->col[self->cnt];
+
+    if( *pos != self->sep )
+    {
+      /* '\r' or '\0' ends the last field */
+      self->cnt += 1;
+      stop = 1;
+    }
+    else if( ++self->cnt == self->cols )
+    {
+      self->cnt += 1;
+      stop = 1;
+    }
+    else
+    {
+      self->col[self->cnt] = pos + 1;
+    }
+  }
+}
+
+/* - - - - - - - - - - - - - - - - - - - *
+ * slice line of input
+ * - - - - - - - - - - - - - - - - - - - */
+
+static void
+parser_slice(parser_t *self)
+{
+  csv_scan_t scan;
+
+  csv_scan_init(&scan, self->line, self->llen, self->sep);
+  parser_split(self, &scan, self->line);
+}
+
+/* - - - - - - - - - - - - - - - - - - - *
+ * fetch and slice line of mapped input
+ *
+ * Lines and fields are located in one pass
+ * over the data with the block scanner
+ * instead of parser_next + parser_slice.
+ * - - - - - - - - - - - - - - - - - - - */
+
+static int
+parser_scan(parser_t *self)
+{
+  for( ;; )
+  {
+    const char *beg = self->curr;
+    const char *end;
+
+    if( beg == self->tail )
+    {
+      return 1;
+    }
+
+    if( *beg == '#' )
+    {
+      do
+      {
+        end = self->scan.cs_data + csv_scan_next(&self->scan);
+      } while( *end != '\n' );
+
+      self->curr = end + 1;
+      continue;
+    }
+
+    end = parser_split(self, &self->scan, beg);
+    self->curr = end + 1;
+
+    if( end > beg && end[-1] == '\r' ) --end;
+
+    self->line = beg;
+    self->llen = end - beg;
+    return 0;
+  }
+}
+
+/* - - - - - - - - - - - - - - - - - - - *
+ * convert sliced field to cell value
+ * - - - - - - - - - - - - - - - - - - - */
+
+static void
+parser_cell(parser_t *self, csvcell_t *cell, const char *text, size_t size)
+{
+  double      val;
+  const char *pos = text;
+
+  switch( size ? *text : 0 )
+  {
+  case '+':  case '-':  case '.':  case '0' ... '9':
+    val = csv_float_parse(&pos);
+    if( pos == text + size )
+    {
+      csvcell_setdigits(cell, val, text, size);
+      break;
+    }
+    // fall through
+
+  default:
+    csvcell_settext(cell, csvtext_intern_ex(text, size));
+    break;
+  }
+}
+
+/* - - - - - - - - - - - - - - - - - - - *
+ * allocate row for parsed data
+ * - - - - - - - - - - - - - - - - - - - */
+
+static csvrow_t *
+parser_newrow(parser_t *self)
+{
+  if( self->csv != 0 )
+  {
+    return csv_newrow(self->csv);
+  }
+
+  if( self->rowcnt == self->rowmax )
+  {
+    self->rowmax = self->rowmax ? (self->rowmax * 2) : 1024;
+    self->rowtab = realloc(self->rowtab, self->rowmax * sizeof *self->rowtab);
+    if ( self->rowtab == NULL ) abort();
+  }
+  return self->rowtab[self->rowcnt++] = csvrow_create_pooled(&self->rowpool,
+                                                             self->width,
+                                                             self->cells);
+}
+
+/* - - - - - - - - - - - - - - - - - - - *
+ * input field stored to table column
+ *
+ * The last field mapped to a column wins,
+ * unless the line is too short to have it.
+ * - - - - - - - - - - - - - - - - - - - */
+
+static int
+parser_field(const parser_t *self, int col)
+{
+  int fld = self->wfld[col];
+
+  if( fld >= self->cnt )
+  {
+    fld = (self->cnt < self->cols) ? self->cnt : self->cols;
+
+    while( --fld >= 0 && self->idx[fld] != col ) { }
+  }
+  return fld;
+}
+
+/* - - - - - - - - - - - - - - - - - - - *
+ * calculator hook: value of current line
+ *
+ * Fields are converted only when the row
+ * predicate needs them, and strings are
+ * not interned, so rejected lines leave
+ * nothing behind.
+ * - - - - - - - - - - - - - - - - - - - */
+
+static void
+parser_getvar(calc_t *calc, void *user, calctok_t *tok)
+{
+  parser_t   *self = user;
+  csvcell_t  *cell = &tok->tok_val;
+  int         fld  = parser_field(self, tok->tok_col);
+  const char *text = 0;
+  const char *pos  = 0;
+  size_t      size = 0;
+  double      val;
+
+  if( fld < 0 )
+  {
+    csvcell_ctor(cell);
+    return;
+  }
+
+  pos = text = self->col[fld];
+  size = self->len[fld];
+
+  switch( size ? *text : 0 )
+  {
+  case '+':  case '-':  case '.':  case '0' ... '9':
+    val = csv_float_parse(&pos);
+    if( pos == text + size )
+    {
+      csvcell_setdigits(cell, val, text, size);
+      break;
+    }
+    // fall through
+
+  default:
+    if( self->wcap[fld] <= size )
+    {
+      self->wcap[fld] = size + 64;
+      self->wbuf[fld] = realloc(self->wbuf[fld], self->wcap[fld]);
+      if ( self->wbuf[fld] == NULL ) abort();
+      csvtext_checkaddr(self->wbuf[fld]);
+    }
+    memcpy(self->wbuf[fld], text, size);
+    self->wbuf[fld][size] = 0;
+
+    csvcell_settext(cell, self->wbuf[fld]);
+    break;
+  }
+}
+
+/* - - - - - - - - - - - - - - - - - - - *
+ * compile row predicate for the parser
+ *
+ * Only expressions that do not assign to
+ * anything and refer to existing columns
+ * only are accepted, others could modify
+ * the table. Returns 0 on success.
+ * - - - - - - - - - - - - - - - - - - - */
+
+static int
+parser_where(parser_t *self, const csv_t *csv, const char *expr)
+{
+  calc_t *calc = calc_create();
+  int     err  = -1;
+
+  calc->calc_quiet    = 1;
+  calc->calc_getvar   = parser_getvar;
+  calc->calc_userdata = self;
+
+  if( calc_compile(calc, expr) == 0 )
+  {
+    goto cleanup;
+  }
+
+  for( int i = 0; i < calc->calc_fifo.stk_tail; ++i )
+  {
+    calctok_t *tok = calc->calc_fifo.stk_data[i];
+
+    if( tok->tok_code == tc_set )
+    {
+      goto cleanup;
+    }
+    if( tok->tok_code == tc_var && !csvcell_isstring(&tok->tok_sym) )
+    {
+      goto cleanup;
+    }
+    if( tok->tok_code == tc_var )
+    {
+      const char *sym = calctok_getsymbol(tok);
+
+      tok->tok_col = -1;
+
+      for( int c = 0; c < csv_cols(csv); ++c )
+      {
+        char t[32];
+        if( !strcmp(csvrow_getstring(csv->csv_labtab, c, t, sizeof t), sym) )
+        {
+          tok->tok_col = c;
+          break;
+        }
+      }
+      if( tok->tok_col < 0 )
+      {
+        goto cleanup;
+      }
+    }
+  }
+
+  if( self->wfld == 0 )
+  {
+    self->wfld = calloc(csv_cols(csv) + 1, sizeof *self->wfld);
+
+    for( int c = 0; c < csv_cols(csv); ++c )
+    {
+      self->wfld[c] = -1;
+    }
+    for( int i = 0; i < self->cols; ++i )
+    {
+      if( self->idx[i] >= 0 )
+      {
+        self->wfld[self->idx[i]] = i;
+      }
+    }
+  }
+
+  self->where = calc, calc = 0;
+  self->wexpr = expr;
+  self->wbuf  = calloc(self->cols + 1, sizeof *self->wbuf);
+  self->wcap  = calloc(self->cols + 1, sizeof *self->wcap);
+
+  err = 0;
+  cleanup:
+
+  calc_delete(calc);
+
+  return err;
+}
+
+/* - - - - - - - - - - - - - - - - - - - *
+ * parse data rows up to table terminator
+ *
+ * Returns 0 if terminator was found, 1 on
+ * end of input, or -1 if row limit was
+ * reached.
+ * - - - - - - - - - - - - - - - - - - - */
+
+static int
+parser_rows(parser_t *self)
+{
+  for( int rows = 0; ; )
+  {
+    if( self->limit != 0 && rows++ == self->limit )
+    {
+      return -1;
+    }
+
+    if( self->scan.cs_data != 0 )
+    {
+      if( parser_scan(self) )
+      {
+        return 1;
+      }
+    }
+    else if( parser_next(self) )
+    {
+      return 1;
+    }
+
+    if( self->llen == 0 )
+    {
+      return 0;
+    }
+
+    if( self->scan.cs_data == 0 )
+    {
+      parser_slice(self);
+    }
+
+    if( self->cnt < self->cols )
+    {
+      self->few += 1;
+    }
+    else if( self->cnt > self->cols )
+    {
+      self->much += 1;
+    }
+    if( self->cnt != self->cols && self->csv != 0 )
+    {
+      msg_warning("%s: too %s columns\n", self->path,
+                  (self->cnt < self->cols) ? "few" : "much");
+    }
+
+    if( self->where != 0 &&
+        fabs(calc_evaluate(self->where)) < CSV_EPSILON )
+    {
+      continue;
+    }
+
+    csvrow_t *row = parser_newrow(self);
+
+    for( int i = 0; i < self->cnt && i < self->cols; ++i )
+    {
+      if( self->idx[i] < 0 )
+      {
+        continue;
+      }
+      parser_cell(self, &row->cr_celltab[self->idx[i]],
+                  self->col[i], self->len[i]);
+
+      //cellcnt += 1;
+      //numeric += csvrow_isnumber(row, idx[i]);
+    }
+  }
+}
+
+/* - - - - - - - - - - - - - - - - - - - *
+ * read data appended to followed input
+ *
+ * Only complete lines are made available
+ * for parsing, the partial last line is
+ * kept in the buffer until the rest of
+ * it has been written. Returns number of
+ * bytes read, or -1 if the file has been
+ * truncated.
+ * - - - - - - - - - - - - - - - - - - - */
+
+enum { PARSER_FOLLOW_CHUNK = 1 << 20 };
+
+static ssize_t
+parser_fill(parser_t *self)
+{
+  struct stat st;
+  size_t      keep = self->fill - self->curr;
+  size_t      done = 0;
+
+  if( fstat(fileno(self->file), &st) == 0 && S_ISREG(st.st_mode) &&
+      st.st_size < ftello(self->file) )
+  {
+    msg_warning("%s: file truncated\n", self->path);
+    return -1;
+  }
+
+  if( keep != 0 )
+  {
+    memmove(self->data, self->curr, keep);
+  }
+
+  if( self->size < keep + PARSER_FOLLOW_CHUNK )
+  {
+    self->size = keep + PARSER_FOLLOW_CHUNK;
+    self->data = realloc(self->data, self->size);
+    if ( self->data == NULL ) abort();
+  }
+
+  clearerr(self->file);
+  done = fread(self->data + keep, 1, PARSER_FOLLOW_CHUNK, self->file);
+
+  const char *end = memrchr(self->data, '\n', keep + done);
+
+  self->curr = self->data;
+  self->tail = end ? (end + 1) : self->data;
+  self->fill = self->data + keep + done;
+
+  csv_scan_init(&self->scan, self->curr, self->tail - self->curr, self->sep);
+
+  return done;
+}
+
+/* - - - - - - - - - - - - - - - - - - - *
+ * parse rows appended to followed input
+ *
+ * Returns 0 if terminator was found or
+ * the input can not be followed further,
+ * 1 when all available complete rows
+ * have been parsed, or -1 if row limit
+ * was reached.
+ * - - - - - - - - - - - - - - - - - - - */
+
+static int
+parser_follow(parser_t *self)
+{
+  for( ;; )
+  {
+    if( self->curr == self->tail )
+    {
+      ssize_t done = parser_fill(self);
+
+      if( done < 0 )
+      {
+        return 0;
+      }
+      if( done == 0 )
+      {
+        return 1;
+      }
+    }
+
+    int rc = parser_rows(self);
+
+    if( rc <= 0 )
+    {
+      return rc;
+    }
+  }
+}
+
+/* - - - - - - - - - - - - - - - - - - - *
+ * parallel parsing of mmapped data
+ *
+ * The table body is split into chunks at
+ * line boundaries and each chunk is parsed
+ * by a worker thread using a private copy
+ * of the parser state. Rows are then added
+ * to the table in chunk order, so that the
+ * result is identical to serial parsing.
+ * - - - - - - - - - - - - - - - - - - - */
+
+enum { PARSER_CHUNK_MIN = 1 << 20 };
+
+/* - - - - - - - - - - - - - - - - - - - *
+ * set while csv_load_many() loads files
+ * one per thread, single files are then
+ * not split into chunks
+ * - - - - - - - - - - - - - - - - - - - */
+
+static int csv_loading_many = 0;
+
+static void *
+parser_worker(void *aptr)
+{
+  parser_t *self = aptr;
+  self->error = parser_rows(self);
+  return 0;
+}
+
+static int
+csv_parse_parallel(csv_t *self, parser_t *parser)
+{
+  size_t size = parser->tail - parser->curr;
+  int    todo = csv_getthreads();
+  int    cols = csv_cols(self);
+  int    done = 1;
+
+  if( (size_t)todo > size / PARSER_CHUNK_MIN )
+  {
+    todo = size / PARSER_CHUNK_MIN;
+  }
+  if( todo < 2 || parser->map == 0 || csv_loading_many )
+  {
+    /* files loaded in parallel already
+     * keep all threads busy */
+    return -1;
+  }
+
+  parser_t  *work = calloc(todo, sizeof *work);
+  pthread_t *tids = calloc(todo, sizeof *tids);
+  int       *live = calloc(todo, sizeof *live);
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * split at line boundaries & start
+   * - - - - - - - - - - - - - - - - - - - */
+
+  const char *beg = parser->curr;
+
+  for( int i = 0; i < todo; ++i )
+  {
+    const char *end = parser->curr + size / todo * (i + 1);
+
+    if( end < beg )
+    {
+      end = beg;
+    }
+    if( i == todo - 1 )
+    {
+      end = parser->tail;
+    }
+    else
+    {
+      end = memchr(end - 1, '\n', parser->tail - end + 1);
+      end += 1;
+    }
+
+    parser_init(&work[i]);
+    free(work[i].data), work[i].data = 0;
+
+    work[i].path = parser->path;
+    work[i].sep  = parser->sep;
+    work[i].cols = parser->cols;
+    work[i].idx  = parser->idx;
+    work[i].map  = parser->map;
+    work[i].curr = beg;
+    work[i].tail = end;
+    work[i].col  = calloc(parser->cols+1, sizeof *work[i].col);
+    work[i].len  = calloc(parser->cols+1, sizeof *work[i].len);
+    work[i].width = cols;
+    work[i].cells = (self->csv_colmax > cols) ? self->csv_colmax : cols;
+    work[i].wfld = parser->wfld;
+    csv_scan_init(&work[i].scan, beg, end - beg, parser->sep);
+
+    if( parser->where != 0 )
+    {
+      parser_where(&work[i], self, parser->wexpr);
+    }
+
+    live[i] = !pthread_create(&tids[i], 0, parser_worker, &work[i]);
+    if( !live[i] )
+    {
+      parser_worker(&work[i]);
+    }
+    beg = end;
+  }
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * stitch results in original order,
+   * ignoring data after table terminator
+   * - - - - - - - - - - - - - - - - - - - */
+
+  for( int i = 0; i < todo; ++i )
+  {
+    parser_t *chunk = &work[i];
+
+    if( live[i] )
+    {
+      pthread_join(tids[i], 0);
+    }
+
+    if( done != 0 )
+    {
+      if( self->csv_rowmax < self->csv_rowcnt + chunk->rowcnt )
+      {
+        self->csv_rowmax = self->csv_rowcnt + chunk->rowcnt;
+        self->csv_rowtab = realloc(self->csv_rowtab,
+                                   self->csv_rowmax *
+                                   sizeof *self->csv_rowtab);
+      }
+      memcpy(self->csv_rowtab + self->csv_rowcnt, chunk->rowtab,
+             chunk->rowcnt * sizeof *chunk->rowtab);
+      self->csv_rowcnt += chunk->rowcnt;
+      mem_pool_splice(&self->csv_rowpool, &chunk->rowpool);
+
+      for( int k = 0; k < chunk->few; ++k )
+      {
+        msg_warning("%s: too few columns\n", parser->path);
+      }
+      for( int k = 0; k < chunk->much; ++k )
+      {
+        msg_warning("%s: too much columns\n", parser->path);
+      }
+
+      parser->curr = chunk->curr;
+      done = chunk->error;
+    }
+
+    mem_pool_dtor(&chunk->rowpool);
+
+    parser_unwhere(chunk);
+    free(chunk->rowtab);
+    free(chunk->col);
+    free(chunk->len);
+  }
+
+  free(work);
+  free(tids);
+  free(live);
+
+  return done;
+}
+
+/* - - - - - - - - - - - - - - - - - - - *
+ * parse header variables and labels
+ *
+ * Returns 0 if data rows can follow.
+ * - - - - - - - - - - - - - - - - - - - */
+
+static int
+csv_parse_head(csv_t *self, parser_t *parser)
+{
+  csv_setsource(self, parser->path);
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * parse header
+   * - - - - - - - - - - - - - - - - - - - */
+
+  for( ;; )
+  {
+    if( parser_read(parser) )
+    {
+      msg_warning("%s: EOF while reading CSV header\n", parser->path);
+      return -1;
+    }
+
+    if( *parser->data == 0 )
+    {
+      if( parser_read(parser) )
+      {
+        msg_warning("%s: EOF after reading CSV header\n", parser->path);
+        return -1;
+      }
+      break;
+    }
+
+    char *value = strchr(parser->data, '=');
+
+    if( value == 0 )
+    {
+      msg_warning("%s: missing CSV header terminator\n", parser->path);
+      break;
+    }
+
+    *value++ = 0;
+    csv_addvar(self, cstring_strip(parser->data), cstring_strip(value));
+  }
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * separator autodetect
+   * - - - - - - - - - - - - - - - - - - - */
+
+  if( *parser->data == 0 )
+  {
+    msg_warning("%s: empty CSV label row\n", parser->path);
+    return -1;
+  }
+
+  {
+    int sem = 1;
+    int tab = 1;
+    for( const char *s = parser->data; *s; ++s )
+    {
+      switch( *s )
+      {
+      case ',': ++parser->cols;  break;
+      case ';': ++sem;  break;
+      case '\t': ++tab; break;
+      }
+    }
+    if( parser->cols < sem ) parser->cols = sem, parser->sep = ';';
+    if( parser->cols < tab ) parser->cols = tab, parser->sep = '\t';
+  }
+
+  parser->col = calloc(parser->cols+1, sizeof *parser->col);
+  parser->len = calloc(parser->cols+1, sizeof *parser->len);
+  parser->idx = calloc(parser->cols+0, sizeof *parser->idx);
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * handle label row
+   * - - - - - - - - - - - - - - - - - - - */
+
+  parser->llen = strlen(parser->data);
+  parser_slice(parser);
+
+  for( int i = 0; i < parser->cnt && i < parser->cols; ++i )
+  {
+    const char *lab = csvtext_intern_ex(parser->col[i], parser->len[i]);
+    parser->idx[i] = csv_addcol(self, lab);
+    //printf("[%3d] '%s'\n", parser->idx[i], lab);
+  }
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * prepare for data rows
+   * - - - - - - - - - - - - - - - - - - - */
+
+  if( parser->map != 0 )
+  {
+    csv_scan_init(&parser->scan, parser->curr,
+                  parser->tail - parser->curr, parser->sep);
+  }
+  parser->csv = self;
+
+  return 0;
+}
+
+/* - - - - - - - - - - - - - - - - - - - *
+ * restrict columns to parse
+ *
+ * The usecols / remcols operation is done
+ * on the still empty table and the input
+ * fields of dropped columns are mapped to
+ * index -1 so that they are not converted
+ * nor stored at all.
+ * - - - - - - - - - - - - - - - - - - - */
+
+static void
+csv_project(csv_t *self, parser_t *parser, const char *labels, int remove)
+{
+  int         cols = csv_cols(self);
+  const char *lab[cols + 1];
+  int         map[cols + 1];
+
+  if( labels == 0 || parser->idx == 0 )
+  {
+    return;
+  }
+
+  for( int c = 0; c < cols; ++c )
+  {
+    lab[c] = csv_label(self, c);
+    map[c] = -1;
+  }
+
+  if( remove )
+  {
+    csv_op_remcols(self, labels);
+  }
+  else
+  {
+    csv_op_usecols(self, labels);
+  }
+
+  for( int n = 0; n < csv_cols(self); ++n )
+  {
+    for( int c = 0; c < cols; ++c )
+    {
+      if( lab[c] == csv_label(self, n) )
+      {
+        map[c] = n;
+        break;
+      }
+    }
+  }
+
+  for( int i = 0; i < parser->cols; ++i )
+  {
+    if( parser->idx[i] >= 0 )
+    {
+      parser->idx[i] = map[parser->idx[i]];
+    }
+  }
+}
+
+/* - - - - - - - - - - - - - - - - - - - *
+ * parse the input data
+ * - - - - - - - - - - - - - - - - - - - */
+
+static void
+csv_parse(csv_t *self, parser_t *parser, const char *labels, int remove,
+          const char *where)
+{
+  if( csv_parse_head(self, parser) != 0 )
+  {
+    return;
+  }
+
+  csv_project(self, parser, labels, remove);
+  csv_reserve(self, 0, csv_cols(self));
+
+  if( where != 0 )
+  {
+    parser_where(parser, self, where);
+  }
+
+  int eof = csv_parse_parallel(self, parser);
+
+  if( eof < 0 )
+  {
+    eof = parser_rows(parser);
+  }
+
+  if( eof != 0 )
+  {
+    msg_warning("%s: missing CSV table terminator\n", parser->path);
+  }
+}
+
+/* - - - - - - - - - - - - - - - - - - - *
+ * load table with optional pushdowns
+ * - - - - - - - - - - - - - - - - - - - */
+static int
+csv_load_ex(csv_t *self, const char *path, const char *labels, int remove,
+            const char *where)
+{
+  /* - - - - - - - - - - - - - - - - - - - *
+   * open file
+   * - - - - - - - - - - - - - - - - - - - */
+  parser_t *parser = parser_open(path, !(self->csv_flags & CTF_NO_MMAP));
+
+  if ( parser->error )
+  {
+    perror(path);
+  }
+  else
+  {
+    csv_parse(self, parser, labels, remove, where);
+  }
+  int rc = parser->error;
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * cleanup
+   * - - - - - - - - - - - - - - - - - - - */
+  parser_free(parser);
+
+  return rc;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_load_cols  --  load only given columns, or all but given columns
+ *
+ * Gives the same result as csv_load() followed by csv_op_usecols()
+ * or csv_op_remcols(), but the fields of dropped columns are skipped
+ * while parsing.
+ * ------------------------------------------------------------------------- */
+int
+csv_load_cols(csv_t *self, const char *path, const char *labels, int remove)
+{
+  return csv_load_ex(self, path, labels, remove, 0);
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_load_where  --  load only rows satisfying given expression
+ *
+ * Gives the same result as csv_load() followed by csv_op_select(),
+ * but rejected lines are never stored and only the fields referred
+ * to by the expression are converted for them. Expressions that
+ * assign values or refer to unknown columns are not applied, and
+ * all rows are loaded, leaving the selection to csv_op_select().
+ * ------------------------------------------------------------------------- */
+int
+csv_load_where(csv_t *self, const char *path, const char *expr)
+{
+  return csv_load_ex(self, path, 0, 0, expr);
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_load
+ * ------------------------------------------------------------------------- */
+int
+csv_load(csv_t *self, const char *path)
+{
+  return csv_load_ex(self, path, 0, 0, 0);
+}
+
+/* - - - - - - - - - - - - - - - - - - - *
+ * files are handed out to threads in
+ * order, each is loaded to a table of
+ * its own
+ * - - - - - - - - - - - - - - - - - - - */
+
+typedef struct
+{
+  pthread_mutex_t lock;
+  const char    **path;
+  csv_t         **table;
+  int            *error;
+  int             count;
+  int             next;
+} csv_loader_t;
+
+static void *
+csv_loader_worker(void *aptr)
+{
+  csv_loader_t *self = aptr;
+
+  for( ;; )
+  {
+    pthread_mutex_lock(&self->lock);
+    int i = self->next++;
+    pthread_mutex_unlock(&self->lock);
+
+    if( i >= self->count )
+    {
+      break;
+    }
+    self->error[i] = csv_load(self->table[i], self->path[i]);
+  }
+  return 0;
+}
+
+/* - - - - - - - - - - - - - - - - - - - *
+ * merge header variables, the first
+ * value wins if values differ
+ * - - - - - - - - - - - - - - - - - - - */
+
+static void
+csv_merge_head(csv_t *self, const csv_t *from)
+{
+  for( int i = 0, n = array_size(&from->csv_head); i < n; ++i )
+  {
+    const csvvar_t *var = array_get(&from->csv_head, i);
+    const csvvar_t *old = 0;
+
+    for( int k = 0, m = array_size(&self->csv_head); k < m; ++k )
+    {
+      old = array_get(&self->csv_head, k);
+
+      if( !strcmp(old->cv_key, var->cv_key) )
+      {
+        break;
+      }
+      old = 0;
+    }
+
+    if( old == 0 )
+    {
+      csv_addvar(self, var->cv_key, var->cv_val);
+    }
+    else if( strcmp(old->cv_val, var->cv_val) )
+    {
+      msg_warning("%s: header '%s=%s' conflicts with '%s=%s'\n",
+                  csv_getsource(from), var->cv_key, var->cv_val,
+                  old->cv_key, old->cv_val);
+    }
+  }
+}
+
+/* - - - - - - - - - - - - - - - - - - - *
+ * move rows to table with label union
+ * - - - - - - - - - - - - - - - - - - - */
+
+static void
+csv_merge_rows(csv_t *self, csv_t *from, int srccol)
+{
+  int cols = csv_cols(from);
+  int map[cols + 1];
+  int same = csvschema_equal(csv_getschema(self), csv_getschema(from));
+
+  for( int c = 0; c < cols; ++c )
+  {
+    map[c] = same ? c : csv_addcol(self, csv_label(from, c));
+    same = same && (map[c] == c);
+  }
+
+  if( self->csv_colmax < csv_cols(self) )
+  {
+    csv_reserve(self, 0, csv_cols(self));
+  }
+  same = same && (from->csv_colmax >= self->csv_colmax);
+
+  csvcell_t src;
+
+  csvcell_setstring(&src, csv_getsource(from));
+
+  for( int r = 0; r < from->csv_rowcnt; ++r )
+  {
+    csvrow_t *row = from->csv_rowtab[r];
+
+    if( !same )
+    {
+      csvrow_t *tmp = row;
+
+      row = csvrow_create_pooled(&self->csv_rowpool, csv_cols(self),
+                                 self->csv_colmax);
+      row->cr_flags = tmp->cr_flags;
+
+      for( int c = 0; c < cols; ++c )
+      {
+        row->cr_celltab[map[c]] = tmp->cr_celltab[c];
+      }
+    }
+
+    if( srccol >= 0 )
+    {
+      row->cr_celltab[srccol] = src;
+    }
+
+    if( self->csv_rowcnt == self->csv_rowmax )
+    {
+      self->csv_rowmax = self->csv_rowmax * 4 / 3 + from->csv_rowcnt;
+      self->csv_rowtab = realloc(self->csv_rowtab,
+                                 self->csv_rowmax * sizeof *self->csv_rowtab);
+    }
+    self->csv_rowtab[self->csv_rowcnt++] = row;
+  }
+
+  if( same )
+  {
+    mem_pool_splice(&self->csv_rowpool, &from->csv_rowpool);
+  }
+  from->csv_rowcnt = 0;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_load_many  --  load several files into one table
+ *
+ * Files are loaded in parallel, using up to csv_getthreads() threads,
+ * and then appended to the table in given order. The columns are the
+ * union of all label rows, cells missing from a file are left empty.
+ * Conflicting header variables are reported, the first value is kept.
+ * If srclab is given, a column of that name is added and set to the
+ * path each row was loaded from. Returns 0 if all files were loaded.
+ * ------------------------------------------------------------------------- */
+
+int
+csv_load_many(csv_t *self, const char **path, int count, const char *srclab)
+{
+  int           todo = csv_getthreads();
+  int           err  = 0;
+  pthread_t     tids[todo > 0 ? todo : 1];
+  int           live[todo > 0 ? todo : 1];
+  csv_loader_t  work;
+
+  pthread_mutex_init(&work.lock, 0);
+  work.path  = path;
+  work.table = calloc(count + 1, sizeof *work.table);
+  work.error = calloc(count + 1, sizeof *work.error);
+  work.count = count;
+  work.next  = 0;
+
+  for( int i = 0; i < count; ++i )
+  {
+    work.table[i] = csv_create();
+    work.table[i]->csv_flags = self->csv_flags;
+  }
+
+  if( todo > count )
+  {
+    todo = count;
+  }
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * load
+   * - - - - - - - - - - - - - - - - - - - */
+
+  csv_loading_many = (todo > 1);
+
+  for( int i = 1; i < todo; ++i )
+  {
+    live[i] = !pthread_create(&tids[i], 0, csv_loader_worker, &work);
+  }
+  csv_loader_worker(&work);
+
+  for( int i = 1; i < todo; ++i )
+  {
+    if( live[i] )
+    {
+      pthread_join(tids[i], 0);
+    }
+  }
+
+  csv_loading_many = 0;
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * merge
+   * - - - - - - - - - - - - - - - - - - - */
+
+  for( int i = 0; i < count; ++i )
+  {
+    csvschema_t *schema = csv_getschema(work.table[i]);
+
+    // files with the same layout share one schema
+    for( int k = 0; k < i; ++k )
+    {
+      if( !csv_setschema(work.table[i], work.table[k]->csv_schema) )
+      {
+        schema = 0;
+        break;
+      }
+    }
+
+    for( int c = 0; schema && c < csvschema_cols(schema); ++c )
+    {
+      csv_addcol(self, csvschema_label(schema, c));
+    }
+  }
+
+  int srccol = srclab ? csv_addcol(self, srclab) : -1;
+
+  for( int i = 0; i < count; ++i )
+  {
+    if( work.error[i] != 0 )
+    {
+      err = -1;
+    }
+    csv_merge_head(self, work.table[i]);
+    csv_merge_rows(self, work.table[i], srccol);
+    csv_delete(work.table[i]);
+  }
+
+  if( count == 1 )
+  {
+    csv_setsource(self, path[0]);
+  }
+
+  pthread_mutex_destroy(&work.lock);
+  free(work.table);
+  free(work.error);
+
+  return err;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_save
+ * ------------------------------------------------------------------------- */
+
+/* - - - - - - - - - - - - - - - - - - - *
+ * CSV writer data
+ * - - - - - - - - - - - - - - - - - - - */
+typedef struct {
+  int error;
+  FILE *file;
+  FILE *newf;
+  char *data;
+  int used;
+  int size;
+  const char *path;
+} writer_t;
+
+/* - - - - - - - - - - - - - - - - - - - *
+ * initialize CSV writer data
+ * - - - - - - - - - - - - - - - - - - - */
+static void
+writer_init(writer_t *self)
+{
+  self->size = 0x8000;
+  self->error = 0;
+  self->file = NULL;
+  self->newf = NULL;
+  self->data = malloc(self->size);
+  if (!self->data) abort();
+  self->used = 0;
+  self->path = NULL;
+}
+
+/* - - - - - - - - - - - - - - - - - - - *
+ * free resources allocated by CSV writer
+ * - - - - - - - - - - - - - - - - - - - */
+static void
+writer_free(writer_t *self)
+{
+  if ( self->newf ) fclose(self->newf);
+  if ( self->data ) free(self->data);
+
+  free(self);
+}
+
+
+/* - - - - - - - - - - - - - - - - - - - *
+ * flush writer buffer to file
+ * - - - - - - - - - - - - - - - - - - - */
+static void
+writer_flush(writer_t *self)
+{
+  fwrite(self->data, 1, self->used, self->file);
+  self->used = 0;
+}
+
+/* - - - - - - - - - - - - - - - - - - - *
+ * store text into writer buffer
+ * - - - - - - - - - - - - - - - - - - - */
+static void
+writer_emit(writer_t *self, const char *str)
+{
+  while( *str )
+  {
+    if( self->used == self->size ) writer_flush(self);
+    self->data[self->used++] = *str++;
+  }
+}
+
+/* - - - - - - - - - - - - - - - - - - - *
+ * creates new CSV output file and
+ * initializes writer data
+ * - - - - - - - - - - - - - - - - - - - */
+static writer_t *
+writer_open(const char *path)
+{
+  writer_t *self = malloc(sizeof(writer_t));
+  if ( !self ) abort();
+  writer_init(self);
+
+  if( path == NULL || !strcmp(path, "-") )
+  {
+    self->file = stdout;
+    self->path = "<stdout>";
+  }
+  else
+  {
+    self->file = self->newf = fopen(path, "w");
+  }
+  if ( !self->file ) {
+    self->error = -1;
+  }
+  return self;
+}
+
+/* - - - - - - - - - - - - - - - - - - - *
+ * store cell value into writer buffer
+ * - - - - - - - - - - - - - - - - - - - */
+static void
+writer_cell(writer_t *self, const csvcell_t *cell)
+{
+  const char *text = csvcell_gettext(cell);
+
+  if( text )
+  {
+    writer_emit(self, text);
+  }
+  else
+  {
+    char t[32];
+    writer_emit(self, csvcell_format(cell, t, sizeof t));
+  }
+}
+
+/* - - - - - - - - - - - - - - - - - - - *
+ * writes header and labels to CSV file
+ * - - - - - - - - - - - - - - - - - - - */
+static void
+csv_write_head(csv_t *self, writer_t *writer)
+{
+  csv_setsource(self, writer->path);
+  /* - - - - - - - - - - - - - - - - - - - *
+   * output header
+   * - - - - - - - - - - - - - - - - - - - */
+
+  if( !(self->csv_flags & CTF_NO_HEADER) )
+  {
+    for( int i=0, n=array_size(&self->csv_head); i < n; ++i )
+    {
+      csvvar_t *var = array_get(&self->csv_head, i);
+      writer_emit(writer, var->cv_key);
+      writer_emit(writer, "=");
+      writer_emit(writer, var->cv_val);
+      writer_emit(writer, "\n");
+    }
+    writer_emit(writer, "\n");
+  }
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * output table labels
+   * - - - - - - - - - - - - - - - - - - - */
+
+  if( !(self->csv_flags & CTF_NO_LABELS) )
+  {
+    csvrow_t *row = self->csv_labtab;
+
+    for( int c=0, n=csv_cols(self); c < n; ++c )
+    {
+      if( c != 0 )
+      {
+        writer_emit(writer, ",");
+      }
+      writer_cell(writer, csvrow_getcell(row, c));
+    }
+    writer_emit(writer, "\n");
+  }
+}
+
+/* - - - - - - - - - - - - - - - - - - - *
+ * writes table rows to CSV file
+ *
+ * If map is given, output column c is
+ * taken from table column map[c], or
+ * left empty if map[c] is negative.
+ * - - - - - - - - - - - - - - - - - - - */
+static void
+csv_write_body(csv_t *self, writer_t *writer, const int *map, int cols)
+{
+  for( int r = 0; r < self->csv_rowcnt; ++r )
+  {
+    const csvrow_t *row = self->csv_rowtab[r];
+
+    if( map == 0 )
+    {
+      cols = row->cr_cols;
+    }
+
+    for( int c = 0; c < cols; ++c )
+    {
+      if( c != 0 )
+      {
+        writer_emit(writer, ",");
+      }
+      if( map == 0 )
+      {
+        writer_cell(writer, csvrow_getcell(row, c));
+      }
+      else if( map[c] >= 0 )
+      {
+        writer_cell(writer, csvrow_getcell(row, map[c]));
+      }
+    }
+    writer_emit(writer, "\n");
+  }
+}
+
+/* - - - - - - - - - - - - - - - - - - - *
+ * writes table terminator to CSV file
+ * - - - - - - - - - - - - - - - - - - - */
+static void
+csv_write_tail(csv_t *self, writer_t *writer)
+{
+  if( !(self->csv_flags & CTF_NO_TERMINATOR) )
+  {
+    writer_emit(writer, "\n");
+  }
+
+  writer_flush(writer);
+
+  if( ferror(writer->file) )
+  {
+    perror(writer->path);
+    return;
+  }
+  writer->error = 0;
+}
+
+/* - - - - - - - - - - - - - - - - - - - *
+ * writes data to CSV file
+ * - - - - - - - - - - - - - - - - - - - */
+static void
+csv_write(csv_t *self, writer_t *writer)
+{
+  csv_write_head(self, writer);
+  csv_write_body(self, writer, 0, 0);
+  csv_write_tail(self, writer);
+}
+
+int
+csv_save(csv_t *self, const char *path)
+{
+
+
+// QUARANTINE   auto void emitf(const char *fmt, ...)
+// QUARANTINE   {
+// QUARANTINE     char tmp[1024];
+// QUARANTINE     va_list va;
+// QUARANTINE     va_start(va, fmt);
+// QUARANTINE     vsnprintf(tmp, sizeof tmp, fmt, va);
+// QUARANTINE     va_end(va);
+// QUARANTINE     emit(tmp);
+// QUARANTINE   }
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * open output
+   * - - - - - - - - - - - - - - - - - - - */
+
+  writer_t *writer = writer_open(path);
+
+  if( !writer )
+  {
+    perror(path);
+  }
+  else
+  {
+    csv_write(self, writer);
+  }
+
+  int rc = writer->error;
+  writer_free(writer);
+
+  return rc;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_load
+ * ------------------------------------------------------------------------- */
+
+// QUARANTINE static int count(const char *s, int c)
+// QUARANTINE {
+// QUARANTINE   int n = 0;
+// QUARANTINE   while( *s )
+// QUARANTINE   {
+// QUARANTINE     if( *s++ == c ) ++n;
+// QUARANTINE   }
+// QUARANTINE   return n;
+// QUARANTINE }
+// QUARANTINE
+// QUARANTINE static int slice(char ***pv, int *pn, char *s, int c)
+// QUARANTINE {
+// QUARANTINE   int i = 0;
+// QUARANTINE   int n = *pn;
+// QUARANTINE   char **v = *pv;
+// QUARANTINE
+// QUARANTINE   for( ;; )
+// QUARANTINE   {
+// QUARANTINE     if( i == n )
+// QUARANTINE     {
+// QUARANTINE       v = realloc(v, ++n * sizeof *v);
+// QUARANTINE     }
+// QUARANTINE     v[i++] = s;
 // QUARANTINE
 // QUARANTINE     if( (s = strchr(s,c)) == 0 )
 // QUARANTINE     {
@@ -2251,662 +4984,3862 @@ csv_save(csv_t *self, const char *path)
 // QUARANTINE
 
 /* ------------------------------------------------------------------------- *
- * csv_save
+ * csv_save
+ * ------------------------------------------------------------------------- */
+
+// QUARANTINE int
+// QUARANTINE csv_save(csv_t *self, const char *path)
+// QUARANTINE {
+// QUARANTINE   int     error = -1;
+// QUARANTINE   FILE   *file  = NULL;
+// QUARANTINE   FILE   *newf  = NULL;
+// QUARANTINE
+// QUARANTINE   /* - - - - - - - - - - - - - - - - - - - *
+// QUARANTINE    * open output
+// QUARANTINE    * - - - - - - - - - - - - - - - - - - - */
+// QUARANTINE
+// QUARANTINE   if( path == NULL || !strcmp(path, "-") )
+// QUARANTINE   {
+// QUARANTINE     file = stdout;
+// QUARANTINE     path = "<stdout>";
+// QUARANTINE   }
+// QUARANTINE   else
+// QUARANTINE   {
+// QUARANTINE     file = newf = fopen(path, "w");
+// QUARANTINE   }
+// QUARANTINE
+// QUARANTINE   csv_setsource(self, path);
+// QUARANTINE
+// QUARANTINE   if( file == NULL )
+// QUARANTINE   {
+// QUARANTINE     perror(path); goto cleanup;
+// QUARANTINE   }
+// QUARANTINE
+// QUARANTINE   /* - - - - - - - - - - - - - - - - - - - *
+// QUARANTINE    * output header
+// QUARANTINE    * - - - - - - - - - - - - - - - - - - - */
+// QUARANTINE
+// QUARANTINE
+// QUARANTINE   if( !(self->csv_flags & CTF_NO_HEADER) )
+// QUARANTINE   {
+// QUARANTINE     for( int i=0, n=array_size(&self->csv_head); i < n; ++i )
+// QUARANTINE     {
+// QUARANTINE       csvvar_t *var = array_get(&self->csv_head, i);
+// QUARANTINE       fprintf(file, "%s=%s\n", var->cv_key, var->cv_val);
+// QUARANTINE     }
+// QUARANTINE     fprintf(file, "\n");
+// QUARANTINE   }
+// QUARANTINE
+// QUARANTINE   /* - - - - - - - - - - - - - - - - - - - *
+// QUARANTINE    * output table labels
+// QUARANTINE    * - - - - - - - - - - - - - - - - - - - */
+// QUARANTINE
+// QUARANTINE
+// QUARANTINE   if( !(self->csv_flags & CTF_NO_LABELS) )
+// QUARANTINE   {
+// QUARANTINE     for( int i=0, n=csv_cols(self); i < n; ++i )
+// QUARANTINE     {
+// QUARANTINE       char t[32];
+// QUARANTINE       const char *s = csvrow_getstring(self->csv_labtab, i, t, sizeof t);
+// QUARANTINE       fprintf(file, "%s%s", i ? "," : "", s);
+// QUARANTINE     }
+// QUARANTINE     fprintf(file, "\n");
+// QUARANTINE   }
+// QUARANTINE
+// QUARANTINE   /* - - - - - - - - - - - - - - - - - - - *
+// QUARANTINE    * output table body
+// QUARANTINE    * - - - - - - - - - - - - - - - - - - - */
+// QUARANTINE
+// QUARANTINE   for( int r = 0; r < self->csv_rowcnt; ++r )
+// QUARANTINE   {
+// QUARANTINE     const csvrow_t *row = self->csv_rowtab[r];
+// QUARANTINE
+// QUARANTINE     for( int c = 0; c < row->cr_cols; ++c )
+// QUARANTINE     {
+// QUARANTINE       char t[32];
+// QUARANTINE       const char *s = csvrow_getstring(row, c, t, sizeof t);
+// QUARANTINE       fprintf(file, "%s%s", c ? "," : "", s);
+// QUARANTINE     }
+// QUARANTINE     fprintf(file, "\n");
+// QUARANTINE   }
+// QUARANTINE
+// QUARANTINE   if( !(self->csv_flags & CTF_NO_TERMINATOR) )
+// QUARANTINE   {
+// QUARANTINE     fprintf(file, "\n");
+// QUARANTINE   }
+// QUARANTINE
+// QUARANTINE   if( ferror(file) )
+// QUARANTINE   {
+// QUARANTINE     perror(path); goto cleanup;
+// QUARANTINE   }
+// QUARANTINE
+// QUARANTINE   error = 0;
+// QUARANTINE
+// QUARANTINE   /* - - - - - - - - - - - - - - - - - - - *
+// QUARANTINE    * cleanup
+// QUARANTINE    * - - - - - - - - - - - - - - - - - - - */
+// QUARANTINE
+// QUARANTINE   cleanup:
+// QUARANTINE
+// QUARANTINE   if( newf != NULL )
+// QUARANTINE   {
+// QUARANTINE     fclose(newf);
+// QUARANTINE   }
+// QUARANTINE
+// QUARANTINE   return error;
+// QUARANTINE }
+// QUARANTINE
+
+
+/* - - - - - - - - - - - - - - - - - - - *
+ * csv_save_as_html emit functions
+ * - - - - - - - - - - - - - - - - - - - */
+static void
+csv_write_escaped(FILE *file, const char* text)
+{
+  while( text && *text )
+  {
+    int c = (unsigned char)*text++;
+    switch( c )
+    {
+    case '<': fputs("&lt;",  file); break;
+    case '>': fputs("&gt;",  file); break;
+    case '&': fputs("&gamp", file); break;
+    default: putc(c, file); break;
+    }
+  }
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_save_as_html
+ * ------------------------------------------------------------------------- */
+int
+csv_save_as_html(csv_t *self, const char *path)
+{
+  int     error = -1;
+  FILE   *file  = NULL;
+  FILE   *newf  = NULL;
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * open output
+   * - - - - - - - - - - - - - - - - - - - */
+
+  if( path == NULL || !strcmp(path, "-") )
+  {
+    file = stdout;
+    path = "<stdout>";
+  }
+  else
+  {
+    file = newf = fopen(path, "w");
+  }
+
+  //csv_setsource(self, path);
+
+  if( file == NULL )
+  {
+    perror(path); goto cleanup;
+  }
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * output header
+   * - - - - - - - - - - - - - - - - - - - */
+
+  fprintf(file, "<html>\n<head><title>");
+  csv_write_escaped(file, self->csv_source ?
+         cstring_basename(self->csv_source) :
+         "<unnamed csv data>");
+  fprintf(file, "</title></head>\n<body>\n");
+
+  if( !(self->csv_flags & CTF_NO_HEADER) )
+  {
+    int n = array_size(&self->csv_head);
+
+    if( n > 0 )
+    {
+      fprintf(file, "<table border=1>\n");
+      for( int i=0; i < n; ++i )
+      {
+        csvvar_t *var = array_get(&self->csv_head, i);
+        fprintf(file, "<tr><th>");
+        csv_write_escaped(file, var->cv_key);
+        fprintf(file, "<td>");
+        csv_write_escaped(file, var->cv_val);
+        fprintf(file, "\n");
+      }
+      fprintf(file, "</table>\n<hr>\n");
+    }
+  }
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * output table labels
+   * - - - - - - - - - - - - - - - - - - - */
+
+  fprintf(file, "<table border=1>\n");
+
+  if( !(self->csv_flags & CTF_NO_LABELS) )
+  {
+    const csvrow_t *row = self->csv_labtab;
+    fprintf(file, "<tr>\n");
+    for( int c = 0; c < row->cr_cols; ++c )
+    {
+      const csvcell_t *cell = csvrow_getcell(row, c);
+      if( csvcell_isnumber(cell) )
+      {
+        fprintf(file, "<th align=right>"CELL_FMT"\n", csvcell_getnumber(cell));
+      }
+      else
+      {
+        fprintf(file, "<th>");
+        csv_write_escaped(file, csvcell_getstring(cell,0,0));
+        fprintf(file, "\n");
+      }
+    }
+  }
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * output table body
+   * - - - - - - - - - - - - - - - - - - - */
+
+  for( int r = 0; r < self->csv_rowcnt; ++r )
+  {
+    const csvrow_t *row = self->csv_rowtab[r];
+
+    fprintf(file, "<tr>\n");
+    for( int c = 0; c < row->cr_cols; ++c )
+    {
+      const csvcell_t *cell = csvrow_getcell(row, c);
+      if( csvcell_isnumber(cell) )
+      {
+        fprintf(file, "<td align=right>"CELL_FMT"\n", csvcell_getnumber(cell));
+      }
+      else
+      {
+        fprintf(file, "<td>");
+        csv_write_escaped(file, csvcell_getstring(cell,0,0));
+        fprintf(file, "\n");
+      }
+    }
+  }
+
+  fprintf(file, "</table>\n</body>\n</html>");
+
+  if( ferror(file) )
+  {
+    perror(path); goto cleanup;
+  }
+
+  error = 0;
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * cleanup
+   * - - - - - - - - - - - - - - - - - - - */
+
+  cleanup:
+
+  if( newf != NULL )
+  {
+    fclose(newf);
+  }
+
+  return error;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csvsort_t  --  row sorting via normalized keys
+ *
+ * Rows are ordered as with csvrow_compare(), but instead of comparing
+ * cells pairwise each cell is turned into an unsigned 64 bit key that
+ * orders the same way:
+ *
+ *   numbers  ->  IEEE bits flipped so that unsigned order equals
+ *                numerical order, -0 folded to 0, NaNs after +inf
+ *   strings  ->  above all numbers, low bits hold the rank of the
+ *                text in a dictionary of the column, which gives
+ *                csvtext_compare() order
+ *
+ * Large integers that round to the same double get a second key
+ * holding the exact value.
+ *
+ * Sorting proceeds most significant column first: keys of one column
+ * are made for a range of rows, sorted with a stable LSD radix sort
+ * and then ranges that are still tied are sorted by the next column.
+ * Only the row pointers move, and only rows that actually tie on
+ * earlier columns ever have their later cells looked at.
+ * ------------------------------------------------------------------------- */
+
+#define CSVSORT_NAN    0xfff0000000000001ull // just above +inf
+#define CSVSORT_STRING 0xfff8000000000000ull // above all numbers
+#define CSVSORT_SMALL  48                    // insertion sort below
+#define CSVSORT_CHUNK  (1 << 16)             // min rows per thread
+
+typedef struct
+{
+  uint64_t        sk_key;
+  csvrow_t       *sk_row;
+} csvsortkey_t;
+
+typedef struct
+{
+  csv_t          *csv;
+  int             levels;  // number of columns to sort by
+  const int      *order;   // table column for each level
+  csvdict_t     **dict;    // per table column, made on first use
+  csvsortkey_t   *base;    // start of the key array
+  csvsortkey_t   *temp;    // radix sort scratch, same size
+  unsigned char  *same;    // key equal to previous on all levels
+  pthread_mutex_t lock;    // guards dict
+} csvsort_t;
+
+static inline uint64_t
+csvsort_numkey(double d)
+{
+  uint64_t u;
+
+  if( d != d )
+  {
+    return CSVSORT_NAN;
+  }
+  if( d == 0 )
+  {
+    // -0 sorts equal to 0
+    return 1ull << 63;
+  }
+  memcpy(&u, &d, sizeof u);
+  return (u >> 63) ? ~u : (u | (1ull << 63));
+}
+
+static inline uint64_t
+csvsort_intkey(const csvcell_t *cell)
+{
+  int64_t v;
+
+  if( !csvcell_getinteger(cell, &v) )
+  {
+    // -0, fractions and doubles out of integer range
+    double d = csvcell_getnumber(cell);
+    v = (d >= 0x1p63) ? INT64_MAX : (d < -0x1p63) ? INT64_MIN : (int64_t)d;
+  }
+  return (uint64_t)v ^ (1ull << 63);
+}
+
+/* ------------------------------------------------------------------------- *
+ * csvsort_radix  --  stable sort of key array by sk_key
+ * ------------------------------------------------------------------------- */
+
+static void
+csvsort_radix(csvsortkey_t *key, csvsortkey_t *temp, int n)
+{
+  if( n < CSVSORT_SMALL )
+  {
+    for( int i = 1; i < n; ++i )
+    {
+      csvsortkey_t k = key[i];
+      int          j = i;
+
+      for( ; j > 0 && key[j-1].sk_key > k.sk_key; --j )
+      {
+        key[j] = key[j-1];
+      }
+      key[j] = k;
+    }
+    return;
+  }
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * histograms of all bytes in one pass,
+   * passes where all keys have the same
+   * byte are skipped
+   * - - - - - - - - - - - - - - - - - - - */
+
+  uint32_t      hist[8][256];
+  csvsortkey_t *src = key;
+  csvsortkey_t *dst = temp;
+
+  memset(hist, 0, sizeof hist);
+
+  for( int i = 0; i < n; ++i )
+  {
+    uint64_t k = key[i].sk_key;
+    for( int b = 0; b < 8; ++b, k >>= 8 )
+    {
+      hist[b][k & 255] += 1;
+    }
+  }
+
+  for( int b = 0; b < 8; ++b )
+  {
+    uint32_t *h = hist[b];
+    uint32_t  o = 0;
+
+    if( h[(src[0].sk_key >> (8*b)) & 255] == (uint32_t)n )
+    {
+      continue;
+    }
+
+    for( int v = 0; v < 256; ++v )
+    {
+      uint32_t c = h[v]; h[v] = o; o += c;
+    }
+
+    for( int i = 0; i < n; ++i )
+    {
+      dst[h[(src[i].sk_key >> (8*b)) & 255]++] = src[i];
+    }
+
+    csvsortkey_t *t = src; src = dst; dst = t;
+  }
+
+  if( src != key )
+  {
+    memcpy(key, src, n * sizeof *key);
+  }
+}
+
+/* ------------------------------------------------------------------------- *
+ * csvsort_dict  --  dictionary of column, made on first use
+ * ------------------------------------------------------------------------- */
+
+static csvdict_t *
+csvsort_dict(csvsort_t *self, int col)
+{
+  pthread_mutex_lock(&self->lock);
+  if( self->dict[col] == 0 )
+  {
+    self->dict[col] = csvdict_create(self->csv, col);
+  }
+  csvdict_t *dict = self->dict[col];
+  pthread_mutex_unlock(&self->lock);
+
+  return dict;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csvsort_keys  --  make keys of given level for range of rows
+ *
+ * Returns nonzero if the column has large integers in the range.
+ * ------------------------------------------------------------------------- */
+
+static int
+csvsort_keys(csvsort_t *self, csvsortkey_t *key, int n, int level)
+{
+  int        col   = self->order[level];
+  int        exact = 0;
+  csvdict_t *dict  = 0;
+
+  for( int i = 0; i < n; ++i )
+  {
+    const csvcell_t *cell = &key[i].sk_row->cr_celltab[col];
+    const char      *text = csvcell_gettext(cell);
+
+    if( text != 0 )
+    {
+      if( dict == 0 )
+      {
+        dict = csvsort_dict(self, col);
+      }
+      key[i].sk_key = CSVSORT_STRING | csvdict_textrank(dict, text);
+    }
+    else
+    {
+      key[i].sk_key = csvsort_numkey(csvcell_getnumber(cell));
+      exact |= csvcell_isint64(cell);
+    }
+  }
+  return exact;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csvsort_range  --  sort range of keys by given level onwards
+ * ------------------------------------------------------------------------- */
+
+static void csvsort_range(csvsort_t *self, csvsortkey_t *key, int n, int level);
+
+static void
+csvsort_ties(csvsort_t *self, csvsortkey_t *key, int n, int level)
+{
+  for( int i = 0, j = 0; i < n; i = j )
+  {
+    for( j = i + 1; j < n && key[j].sk_key == key[i].sk_key; ++j ) {}
+
+    if( j - i > 1 )
+    {
+      csvsort_range(self, key + i, j - i, level);
+    }
+  }
+}
+
+static void
+csvsort_split(csvsort_t *self, csvsortkey_t *key, int n, int level, int exact)
+{
+  if( !exact )
+  {
+    csvsort_ties(self, key, n, level + 1);
+    return;
+  }
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * large integers rounding to the same
+   * double are sorted by exact value
+   * - - - - - - - - - - - - - - - - - - - */
+
+  int col = self->order[level];
+
+  for( int i = 0, j = 0; i < n; i = j )
+  {
+    for( j = i + 1; j < n && key[j].sk_key == key[i].sk_key; ++j ) {}
+
+    if( j - i > 1 && key[i].sk_key < CSVSORT_NAN )
+    {
+      for( int k = i; k < j; ++k )
+      {
+        key[k].sk_key = csvsort_intkey(&key[k].sk_row->cr_celltab[col]);
+      }
+      csvsort_radix(key + i, self->temp + (key + i - self->base), j - i);
+      csvsort_ties(self, key + i, j - i, level + 1);
+    }
+    else if( j - i > 1 )
+    {
+      csvsort_range(self, key + i, j - i, level + 1);
+    }
+  }
+}
+
+static void
+csvsort_range(csvsort_t *self, csvsortkey_t *key, int n, int level)
+{
+  if( level >= self->levels )
+  {
+    // equal on all columns
+    memset(self->same + (key - self->base) + 1, 1, n - 1);
+    return;
+  }
+
+  int exact = csvsort_keys(self, key, n, level);
+  csvsort_radix(key, self->temp + (key - self->base), n);
+  csvsort_split(self, key, n, level, exact);
+}
+
+/* - - - - - - - - - - - - - - - - - - - *
+ * parallel sorting of large tables
+ *
+ * The range is cut into one chunk per
+ * thread and each chunk gets its keys
+ * made and radix sorted. The chunks are
+ * merged pairwise, every merge split
+ * into pieces at co-ranked positions so
+ * that all threads stay busy also in the
+ * last rounds. Finally ties are resolved
+ * in segments cut at key boundaries;
+ * ties spanning many rows are sorted in
+ * parallel by the next level.
+ *
+ * Merges take the left element on equal
+ * keys, so the result is the same stable
+ * order as the serial sort gives.
+ * - - - - - - - - - - - - - - - - - - - */
+
+enum { CSVSORT_KEYS, CSVSORT_MERGE, CSVSORT_SPLIT };
+
+typedef struct
+{
+  int                 op;
+  csvsortkey_t       *key;    // range to sort, or merge output
+  int                 rows;
+  int                 level;
+  int                 exact;
+  const csvsortkey_t *a;      // merge inputs
+  const csvsortkey_t *b;
+  int                 alen;
+  int                 blen;
+} csvsortjob_t;
+
+typedef struct
+{
+  csvsort_t          *sort;
+  csvsortjob_t       *job;
+  int                 jobs;
+  int                 next;
+  pthread_mutex_t     lock;
+} csvsortpool_t;
+
+static void
+csvsort_merge(const csvsortkey_t *a, int alen,
+              const csvsortkey_t *b, int blen, csvsortkey_t *out)
+{
+  int i = 0, j = 0;
+
+  while( i < alen && j < blen )
+  {
+    *out++ = (b[j].sk_key < a[i].sk_key) ? b[j++] : a[i++];
+  }
+  memcpy(out, a + i, (alen - i) * sizeof *out), out += alen - i;
+  memcpy(out, b + j, (blen - j) * sizeof *out);
+}
+
+static int
+csvsort_corank(const csvsortkey_t *a, int alen,
+               const csvsortkey_t *b, int blen, int k)
+{
+  // number of elements from a among first k of the merge
+  int lo = (k > blen) ? (k - blen) : 0;
+  int hi = (k < alen) ? k : alen;
+
+  while( lo < hi )
+  {
+    int i = (lo + hi) / 2;
+
+    if( a[i].sk_key <= b[k - i - 1].sk_key )
+    {
+      lo = i + 1;
+    }
+    else
+    {
+      hi = i;
+    }
+  }
+  return lo;
+}
+
+static void *
+csvsort_worker(void *aptr)
+{
+  csvsortpool_t *pool = aptr;
+  csvsort_t     *self = pool->sort;
+
+  for( ;; )
+  {
+    pthread_mutex_lock(&pool->lock);
+    int i = pool->next++;
+    pthread_mutex_unlock(&pool->lock);
+
+    if( i >= pool->jobs )
+    {
+      break;
+    }
+
+    csvsortjob_t *job = &pool->job[i];
+
+    switch( job->op )
+    {
+    case CSVSORT_KEYS:
+      job->exact = csvsort_keys(self, job->key, job->rows, job->level);
+      csvsort_radix(job->key, self->temp + (job->key - self->base),
+                    job->rows);
+      break;
+
+    case CSVSORT_MERGE:
+      csvsort_merge(job->a, job->alen, job->b, job->blen, job->key);
+      break;
+
+    case CSVSORT_SPLIT:
+      csvsort_split(self, job->key, job->rows, job->level, job->exact);
+      break;
+    }
+  }
+  return 0;
+}
+
+static void
+csvsort_runjobs(csvsort_t *self, csvsortjob_t *job, int jobs, int todo)
+{
+  csvsortpool_t pool;
+  pthread_t     tids[todo > 0 ? todo : 1];
+  int           live[todo > 0 ? todo : 1];
+
+  pool.sort = self;
+  pool.job  = job;
+  pool.jobs = jobs;
+  pool.next = 0;
+  pthread_mutex_init(&pool.lock, 0);
+
+  for( int i = 1; i < todo && i < jobs; ++i )
+  {
+    live[i] = !pthread_create(&tids[i], 0, csvsort_worker, &pool);
+  }
+
+  csvsort_worker(&pool);
+
+  for( int i = 1; i < todo && i < jobs; ++i )
+  {
+    if( live[i] )
+    {
+      pthread_join(tids[i], 0);
+    }
+  }
+
+  pthread_mutex_destroy(&pool.lock);
+}
+
+static void
+csvsort_parallel(csvsort_t *self, csvsortkey_t *key, int n, int level,
+                 int threads)
+{
+  int todo = threads;
+
+  if( todo > n / CSVSORT_CHUNK )
+  {
+    todo = n / CSVSORT_CHUNK;
+  }
+  if( todo < 2 || level >= self->levels )
+  {
+    csvsort_range(self, key, n, level);
+    return;
+  }
+
+  // merges are split in at most 2 * todo pieces, tie segments
+  // are closed also by each large tied range
+  int           have  = 2 * todo + n / (2 * CSVSORT_CHUNK) + 2;
+  csvsortjob_t *job   = calloc(have, sizeof *job);
+  int          *bound = calloc(todo + 1, sizeof *bound);
+  int           jobs  = 0;
+  int           exact = 0;
+
+  if( !job || !bound ) abort();
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * make keys & sort chunks
+   * - - - - - - - - - - - - - - - - - - - */
+
+  for( int i = 0; i <= todo; ++i )
+  {
+    bound[i] = (int)((int64_t)n * i / todo);
+  }
+
+  for( int i = 0; i < todo; ++i )
+  {
+    job[i].op    = CSVSORT_KEYS;
+    job[i].key   = key + bound[i];
+    job[i].rows  = bound[i+1] - bound[i];
+    job[i].level = level;
+  }
+  csvsort_runjobs(self, job, todo, todo);
+
+  for( int i = 0; i < todo; ++i )
+  {
+    exact |= job[i].exact;
+  }
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * merge sorted chunks pairwise
+   * - - - - - - - - - - - - - - - - - - - */
+
+  csvsortkey_t *src  = key;
+  csvsortkey_t *dst  = self->temp + (key - self->base);
+
+  for( int runs = todo; runs > 1; runs = (runs + 1) / 2 )
+  {
+    int pairs  = runs / 2;
+    int pieces = (todo + pairs - 1) / pairs;
+
+    jobs = 0;
+
+    for( int p = 0; p < runs; p += 2 )
+    {
+      const csvsortkey_t *a    = src + bound[p];
+      int                 alen = bound[p+1] - bound[p];
+      const csvsortkey_t *b    = a + alen;
+      int                 blen = (p + 1 < runs) ? bound[p+2] - bound[p+1] : 0;
+      int                 ai   = 0;
+
+      for( int q = 1; q <= pieces; ++q )
+      {
+        int k  = (int)((int64_t)(alen + blen) * q / pieces);
+        int ak = blen ? csvsort_corank(a, alen, b, blen, k) : k;
+        int ko = (int)((int64_t)(alen + blen) * (q - 1) / pieces);
+
+        if( k == ko )
+        {
+          continue;
+        }
+
+        job[jobs].op   = CSVSORT_MERGE;
+        job[jobs].key  = dst + bound[p] + ko;
+        job[jobs].a    = a + ai;
+        job[jobs].alen = ak - ai;
+        job[jobs].b    = b + (ko - ai);
+        job[jobs].blen = (k - ak) - (ko - ai);
+        ++jobs;
+
+        ai = ak;
+      }
+    }
+    csvsort_runjobs(self, job, jobs, todo);
+
+    int r = 0;
+    for( int p = 0; p < runs; p += 2 )
+    {
+      bound[r++] = bound[p];
+    }
+    bound[r] = bound[runs];
+
+    csvsortkey_t *t = src; src = dst; dst = t;
+  }
+
+  if( src != key )
+  {
+    memcpy(key, src, n * sizeof *key);
+  }
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * resolve ties in segments, large tied
+   * ranges get sorted in parallel
+   * - - - - - - - - - - - - - - - - - - - */
+
+  int beg = 0;
+  int big = 0;
+
+  jobs = 0;
+
+  for( int i = 0, j = 0; i < n; i = j )
+  {
+    for( j = i + 1; j < n && key[j].sk_key == key[i].sk_key; ++j ) {}
+
+    int large = (j - i >= 2 * CSVSORT_CHUNK) && !exact;
+
+    if( large || j == n || j - beg >= n / todo )
+    {
+      int end = large ? i : j;
+
+      if( end > beg )
+      {
+        job[jobs].op    = CSVSORT_SPLIT;
+        job[jobs].key   = key + beg;
+        job[jobs].rows  = end - beg;
+        job[jobs].level = level;
+        job[jobs].exact = exact;
+        ++jobs;
+      }
+      beg = j;
+      big |= large;
+    }
+  }
+  csvsort_runjobs(self, job, jobs, todo);
+
+  for( int i = 0, j = 0; big && i < n; i = j )
+  {
+    for( j = i + 1; j < n && key[j].sk_key == key[i].sk_key; ++j ) {}
+
+    if( j - i >= 2 * CSVSORT_CHUNK )
+    {
+      csvsort_parallel(self, key + i, j - i, level + 1, threads);
+    }
+  }
+
+  free(job);
+  free(bound);
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_sortuniq  --  sort rows by given columns, optionally drop duplicates
+ *
+ * Columns are compared in the order given, NULL order means all
+ * columns left to right. With uniq set rows that are equal on all
+ * the compared columns are dropped, first one is kept.
+ * ------------------------------------------------------------------------- */
+
+static void
+csv_sortuniq(csv_t *self, const int *order, int levels, int uniq)
+{
+  csvsort_t sort;
+  int       rows = self->csv_rowcnt;
+  int       cols = csv_cols(self);
+  int      *ident = 0;
+
+  if( rows < 2 )
+  {
+    return;
+  }
+
+  csv_dropcellflags(self);
+
+  if( order == 0 )
+  {
+    ident = malloc((cols + 1) * sizeof *ident);
+    if ( ident == NULL ) abort();
+
+    for( int c = 0; c < cols; ++c )
+    {
+      ident[c] = c;
+    }
+    order  = ident;
+    levels = cols;
+  }
+
+  sort.csv    = self;
+  sort.levels = levels;
+  sort.order  = order;
+  sort.dict   = calloc(cols + 1, sizeof *sort.dict);
+  sort.base   = malloc(rows * sizeof *sort.base);
+  sort.temp   = malloc(rows * sizeof *sort.temp);
+  sort.same   = calloc(rows, 1);
+
+  if( !sort.dict || !sort.base || !sort.temp || !sort.same ) abort();
+
+  pthread_mutex_init(&sort.lock, 0);
+
+  for( int r = 0; r < rows; ++r )
+  {
+    sort.base[r].sk_row = self->csv_rowtab[r];
+  }
+
+  csvsort_parallel(&sort, sort.base, rows, 0, csv_getthreads());
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * permute the rows
+   * - - - - - - - - - - - - - - - - - - - */
+
+  int di = 0;
+
+  for( int si = 0; si < rows; ++si )
+  {
+    if( !uniq || !sort.same[si] )
+    {
+      // storage of dropped rows is released with the table
+      self->csv_rowtab[di++] = sort.base[si].sk_row;
+    }
+  }
+  self->csv_rowcnt = di;
+
+  for( int c = 0; c < cols; ++c )
+  {
+    csvdict_delete(sort.dict[c]);
+  }
+  free(sort.dict);
+  free(sort.base);
+  free(sort.temp);
+  free(sort.same);
+  free(ident);
+  pthread_mutex_destroy(&sort.lock);
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_sortrows  --  sort rows in table
+ * ------------------------------------------------------------------------- */
+
+void
+csv_sortrows(csv_t *self)
+{
+  csv_sortuniq(self, 0, 0, 0);
+}
+
+/* ------------------------------------------------------------------------- *
+ * csvgroup_t  --  rows grouped by equal values in key columns
+ *
+ * Each row is hashed once over the key columns and looked up from a
+ * table of groups seen so far, rows are equal as with csvcell_compare().
+ * Groups are numbered in order of their first row.
+ *
+ * Large tables are split into one hash partition per thread: every
+ * thread hashes a slice of the rows and then groups the rows of its
+ * partition, visiting them in table order. As equal rows always fall
+ * into the same partition, per group results do not depend on the
+ * number of threads.
+ *
+ * Strings are normally hashed by their rank in a dictionary of the
+ * column. Natural hashing uses the text itself, so that rows of other
+ * tables can be looked up from the groups, see csvgroup_probe().
+ * ------------------------------------------------------------------------- */
+
+typedef struct csvgroup_t csvgroup_t;
+
+struct csvgroup_t
+{
+  csv_t        *csv;
+  const int    *key;     // key columns
+  int           keys;
+  csvdict_t   **dict;    // per key column, NULL if no strings
+  int           natural; // hash strings by text instead of dict
+  int           parts;   // hash partitions
+  uint64_t     *hash;    // per row
+  int          *group;   // per row, group index
+  int          *first;   // per group, first row
+  int           groups;
+  int         **pfirst;  // per partition, first rows of local groups
+  int          *pcount;  // per partition, number of local groups
+  uint32_t    **pslot;   // per partition, hash table of groups
+  uint32_t     *pmask;
+
+  void        (*job)(csvgroup_t *self, int part, void *user);
+  void         *user;
+  int           next;
+  pthread_mutex_t lock;
+};
+
+static inline uint64_t
+csvgroup_mix(uint64_t h, uint64_t k)
+{
+  h ^= k + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+  return h * 0xff51afd7ed558ccdull;
+}
+
+static uint64_t
+csvgroup_textkey(const char *text)
+{
+  // digit runs as numbers, as in csvtext_compare()
+  uint64_t h = 0;
+
+  while( *text )
+  {
+    if( '0' <= *text && *text <= '9' )
+    {
+      unsigned u = strtoul(text, (char **)&text, 10);
+      h = csvgroup_mix(h, (1ull << 32) | u);
+    }
+    else
+    {
+      h = csvgroup_mix(h, (unsigned char)*text++);
+    }
+  }
+  return h;
+}
+
+static inline uint64_t
+csvgroup_cellkey(const csvcell_t *cell, const csvdict_t *dict, int row)
+{
+  /* - - - - - - - - - - - - - - - - - - - *
+   * equal cells must give equal keys:
+   * strings equal by csvtext_compare() by
+   * rank, integers (including -0 and large
+   * ones) by value, other numbers by bits
+   * - - - - - - - - - - - - - - - - - - - */
+
+  int64_t v;
+
+  if( csvcell_isstring(cell) )
+  {
+    if( dict == 0 )
+    {
+      return csvgroup_textkey(csvcell_gettext(cell));
+    }
+    return CSVSORT_STRING | csvdict_getrank(dict, row);
+  }
+  if( csvcell_getnumber(cell) == 0 )
+  {
+    v = 0;
+  }
+  else if( !csvcell_getinteger(cell, &v) )
+  {
+    return csvsort_numkey(csvcell_getnumber(cell));
+  }
+  return (uint64_t)v ^ 0x5555555555555555ull;
+}
+
+/* - - - - - - - - - - - - - - - - - - - *
+ * jobs are handed out to threads by
+ * partition index
+ * - - - - - - - - - - - - - - - - - - - */
+
+static void *
+csvgroup_worker(void *aptr)
+{
+  csvgroup_t *self = aptr;
+
+  for( ;; )
+  {
+    pthread_mutex_lock(&self->lock);
+    int part = self->next++;
+    pthread_mutex_unlock(&self->lock);
+
+    if( part >= self->parts )
+    {
+      break;
+    }
+    self->job(self, part, self->user);
+  }
+  return 0;
+}
+
+static void
+csvgroup_run(csvgroup_t *self,
+             void (*job)(csvgroup_t *self, int part, void *user),
+             void *user)
+{
+  int       todo = self->parts;
+  pthread_t tids[todo];
+  int       live[todo];
+
+  self->job  = job;
+  self->user = user;
+  self->next = 0;
+
+  for( int i = 1; i < todo; ++i )
+  {
+    live[i] = !pthread_create(&tids[i], 0, csvgroup_worker, self);
+  }
+
+  csvgroup_worker(self);
+
+  for( int i = 1; i < todo; ++i )
+  {
+    if( live[i] )
+    {
+      pthread_join(tids[i], 0);
+    }
+  }
+}
+
+static inline uint64_t
+csvgroup_rowkey(const csvgroup_t *self, const csvrow_t *row, const int *key,
+                int r)
+{
+  uint64_t h = 0;
+
+  for( int k = 0; k < self->keys; ++k )
+  {
+    h = csvgroup_mix(h, csvgroup_cellkey(&row->cr_celltab[key[k]],
+                                         self->dict[k], r));
+  }
+  return h;
+}
+
+static void
+csvgroup_hash_job(csvgroup_t *self, int part, void *user)
+{
+  int rows = self->csv->csv_rowcnt;
+  int lo   = (int)((int64_t)rows * part / self->parts);
+  int hi   = (int)((int64_t)rows * (part + 1) / self->parts);
+
+  for( int r = lo; r < hi; ++r )
+  {
+    self->hash[r] = csvgroup_rowkey(self, self->csv->csv_rowtab[r],
+                                    self->key, r);
+  }
+}
+
+static void
+csvgroup_part_job(csvgroup_t *self, int part, void *user)
+{
+  int        rows  = self->csv->csv_rowcnt;
+  csvrow_t **tab   = self->csv->csv_rowtab;
+  uint32_t   mask  = 255;
+  uint32_t  *slot  = calloc(mask + 1, sizeof *slot);
+  int        have  = 256;
+  int       *first = malloc(have * sizeof *first);
+  int        cnt   = 0;
+
+  if( !slot || !first ) abort();
+
+  for( int r = 0; r < rows; ++r )
+  {
+    uint64_t h = self->hash[r];
+
+    if( (int)(h % self->parts) != part )
+    {
+      continue;
+    }
+
+    uint32_t i = (uint32_t)(h >> 32) & mask;
+
+    for( ; slot[i] != 0; i = (i + 1) & mask )
+    {
+      int u = first[slot[i] - 1];
+      int k = 0;
+
+      if( self->hash[u] != h )
+      {
+        continue;
+      }
+      for( ; k < self->keys; ++k )
+      {
+        if( csvcell_compare(&tab[u]->cr_celltab[self->key[k]],
+                            &tab[r]->cr_celltab[self->key[k]]) != 0 )
+        {
+          break;
+        }
+      }
+      if( k == self->keys )
+      {
+        break;
+      }
+    }
+
+    if( slot[i] != 0 )
+    {
+      self->group[r] = slot[i] - 1;
+      continue;
+    }
+
+    if( cnt == have )
+    {
+      have *= 2;
+      first = realloc(first, have * sizeof *first);
+      if ( first == NULL ) abort();
+    }
+    first[cnt] = r;
+    self->group[r] = cnt;
+    slot[i] = ++cnt;
+
+    if( 2 * (uint32_t)cnt > mask )
+    {
+      /* keep the hash at most half full */
+      free(slot);
+      mask = mask * 2 + 1;
+      slot = calloc(mask + 1, sizeof *slot);
+      if ( slot == NULL ) abort();
+
+      for( int u = 0; u < cnt; ++u )
+      {
+        uint32_t j = (uint32_t)(self->hash[first[u]] >> 32) & mask;
+        while( slot[j] != 0 ) j = (j + 1) & mask;
+        slot[j] = u + 1;
+      }
+    }
+  }
+
+  self->pslot[part]  = slot;
+  self->pmask[part]  = mask;
+  self->pfirst[part] = first;
+  self->pcount[part] = cnt;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csvgroup_ctor  --  group rows of table by key columns
+ * ------------------------------------------------------------------------- */
+
+static void
+csvgroup_ctor(csvgroup_t *self, csv_t *csv, const int *key, int keys,
+              int natural)
+{
+  int rows = csv->csv_rowcnt;
+  int todo = csv_getthreads();
+
+  if( todo > rows / CSVSORT_CHUNK )
+  {
+    todo = rows / CSVSORT_CHUNK;
+  }
+  if( todo < 1 )
+  {
+    todo = 1;
+  }
+
+  self->csv    = csv;
+  self->key    = key;
+  self->keys   = keys;
+  self->natural = natural;
+  self->parts  = todo;
+  self->dict   = calloc(keys + 1, sizeof *self->dict);
+  self->hash   = malloc((rows + 1) * sizeof *self->hash);
+  self->group  = malloc((rows + 1) * sizeof *self->group);
+  self->first  = malloc((rows + 1) * sizeof *self->first);
+  self->groups = 0;
+  self->pfirst = calloc(todo, sizeof *self->pfirst);
+  self->pcount = calloc(todo, sizeof *self->pcount);
+  self->pslot  = calloc(todo, sizeof *self->pslot);
+  self->pmask  = calloc(todo, sizeof *self->pmask);
+  pthread_mutex_init(&self->lock, 0);
+
+  if( !self->dict || !self->hash || !self->group || !self->first ||
+      !self->pfirst || !self->pcount || !self->pslot || !self->pmask ) abort();
+
+  csv_dropcellflags(csv);
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * dictionaries for string key columns
+   * - - - - - - - - - - - - - - - - - - - */
+
+  for( int k = 0; k < keys && !natural; ++k )
+  {
+    for( int r = 0; r < rows; ++r )
+    {
+      if( csvcell_isstring(csvrow_getcell(csv->csv_rowtab[r], key[k])) )
+      {
+        self->dict[k] = csvdict_create(csv, key[k]);
+        break;
+      }
+    }
+  }
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * hash & group partitions, then number
+   * groups by first row
+   * - - - - - - - - - - - - - - - - - - - */
+
+  csvgroup_run(self, csvgroup_hash_job, 0);
+  csvgroup_run(self, csvgroup_part_job, 0);
+
+  int *base = calloc(todo, sizeof *base);
+  int *gmap = 0;
+
+  if( base == NULL ) abort();
+
+  for( int p = 0, n = 0; p < todo; ++p )
+  {
+    base[p] = n, n += self->pcount[p];
+  }
+  gmap = malloc((base[todo-1] + self->pcount[todo-1] + 1) * sizeof *gmap);
+  if ( gmap == NULL ) abort();
+
+  for( int r = 0; r < rows; ++r )
+  {
+    int p = (int)(self->hash[r] % todo);
+    int l = self->group[r];
+
+    if( self->pfirst[p][l] == r )
+    {
+      self->first[self->groups] = r;
+      gmap[base[p] + l] = self->groups++;
+    }
+    self->group[r] = gmap[base[p] + l];
+  }
+
+  // hash tables refer to global groups from now on
+  for( int p = 0; p < todo; ++p )
+  {
+    for( uint32_t i = 0; i <= self->pmask[p]; ++i )
+    {
+      if( self->pslot[p][i] != 0 )
+      {
+        self->pslot[p][i] = gmap[base[p] + self->pslot[p][i] - 1] + 1;
+      }
+    }
+  }
+
+  free(gmap);
+  free(base);
+}
+
+/* ------------------------------------------------------------------------- *
+ * csvgroup_dtor
+ * ------------------------------------------------------------------------- */
+
+static void
+csvgroup_dtor(csvgroup_t *self)
+{
+  for( int k = 0; k < self->keys; ++k )
+  {
+    csvdict_delete(self->dict[k]);
+  }
+  for( int p = 0; p < self->parts; ++p )
+  {
+    free(self->pfirst[p]);
+    free(self->pslot[p]);
+  }
+  free(self->dict);
+  free(self->hash);
+  free(self->group);
+  free(self->first);
+  free(self->pfirst);
+  free(self->pcount);
+  free(self->pslot);
+  free(self->pmask);
+  pthread_mutex_destroy(&self->lock);
+}
+
+/* ------------------------------------------------------------------------- *
+ * csvgroup_probe  --  group having same keys as row of another table
+ *
+ * Groups must have been made with natural hashing. Returns group
+ * index, or -1 if there is no such group.
+ * ------------------------------------------------------------------------- */
+
+static int
+csvgroup_probe(const csvgroup_t *self, const csvrow_t *row, const int *key)
+{
+  uint64_t         h    = csvgroup_rowkey(self, row, key, -1);
+  int              p    = (int)(h % self->parts);
+  const uint32_t  *slot = self->pslot[p];
+  uint32_t         mask = self->pmask[p];
+
+  for( uint32_t i = (uint32_t)(h >> 32) & mask; slot[i] != 0;
+       i = (i + 1) & mask )
+  {
+    int             g    = slot[i] - 1;
+    const csvrow_t *have = self->csv->csv_rowtab[self->first[g]];
+    int             k    = 0;
+
+    if( self->hash[self->first[g]] != h )
+    {
+      continue;
+    }
+    for( ; k < self->keys; ++k )
+    {
+      if( csvcell_compare(&have->cr_celltab[self->key[k]],
+                          &row->cr_celltab[key[k]]) != 0 )
+      {
+        break;
+      }
+    }
+    if( k == self->keys )
+    {
+      return g;
+    }
+  }
+  return -1;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csvgroup_compact  --  keep only first row of each group
+ * ------------------------------------------------------------------------- */
+
+static void
+csvgroup_compact(csvgroup_t *self)
+{
+  csv_t *csv = self->csv;
+
+  // first rows are ascending and never before their slot
+  for( int g = 0; g < self->groups; ++g )
+  {
+    // storage of dropped rows is released with the table
+    csv->csv_rowtab[g] = csv->csv_rowtab[self->first[g]];
+  }
+  csv->csv_rowcnt = self->groups;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_distinct  --  drop rows with duplicate values in given columns
+ *
+ * The first row of each set of rows with equal key columns is kept in
+ * input order and the table is then reduced to the key columns, all
+ * columns if labels is empty.
+ *
+ * With CSV_DISTINCT_COUNT a "count" column tells how many rows each
+ * remaining row stands for.
+ * With CSV_DISTINCT_SORT the rows are sorted by the key columns, which
+ * gives the same result as sorting first and then dropping adjacent
+ * duplicates.
+ *
+ * Returns 0 on success, -1 if the count column would replace a key
+ * column; the table is then left unchanged.
+ * ------------------------------------------------------------------------- */
+
+int
+csv_distinct(csv_t *self, const char *labels, unsigned flags)
+{
+  int         proj = (labels != 0 && *labels != 0);
+  csvord_t   *ord  = csvord_create(self, proj ? labels : "", proj);
+  int         keys = ord->co_cols;
+  csvgroup_t  grp;
+
+  for( int k = 0; k < keys && (flags & CSV_DISTINCT_COUNT); ++k )
+  {
+    if( !strcmp(csv_label(self, ord->co_forw[k]), "count") )
+    {
+      msg_error("count: result column 'count' is also a key\n");
+      csvord_delete(ord);
+      return -1;
+    }
+  }
+
+  csvgroup_ctor(&grp, self, ord->co_forw, keys, 0);
+
+  double *count = calloc(grp.groups + 1, sizeof *count);
+  if ( count == NULL ) abort();
+
+  for( int r = 0; r < self->csv_rowcnt; ++r )
+  {
+    count[grp.group[r]] += 1;
+  }
+
+  csvgroup_compact(&grp);
+  csvgroup_dtor(&grp);
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * only key columns remain, in order
+   * - - - - - - - - - - - - - - - - - - - */
+
+  if( proj )
+  {
+    csvord_apply(ord, self);
+  }
+  csvord_delete(ord);
+
+  if( flags & CSV_DISTINCT_COUNT )
+  {
+    int col = csv_addcol(self, "count");
+
+    for( int g = 0; g < self->csv_rowcnt; ++g )
+    {
+      csvcell_setnumber(csv_getcell(self, g, col), count[g]);
+    }
+  }
+  free(count);
+
+  if( flags & CSV_DISTINCT_SORT )
+  {
+    int *order = malloc((keys + 1) * sizeof *order);
+    if ( order == NULL ) abort();
+
+    for( int k = 0; k < keys; ++k )
+    {
+      order[k] = k;
+    }
+    csv_sortuniq(self, order, keys, 0);
+    free(order);
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_op_group  --  aggregate values over groups of rows
+ *
+ * Rows are grouped by the key columns as with csv_distinct() and the
+ * table is replaced by one row per group, holding the key columns
+ * followed by one column per aggregate. Aggregates are given as comma
+ * separated list of
+ *
+ *   count            rows in group
+ *   count(col)       non-empty values
+ *   sum(col)         sum of numbers, exact for integers
+ *   mean(col)        mean of numbers
+ *   stddev(col)      sample standard deviation of numbers
+ *   min(col)         smallest value, as with csvcell_compare()
+ *   max(col)         largest value
+ *   first(col)       first non-empty value
+ *   last(col)        last non-empty value
+ *
+ * and the result columns are labeled "count" and "<func>_<col>".
+ * Empty values are ignored, so are strings by sum, mean and stddev.
+ * An empty list means count. Returns 0 on success, -1 if a column is
+ * missing, an aggregate is invalid or repeated, or its label is that
+ * of a key column; the table is then left unchanged.
+ * ------------------------------------------------------------------------- */
+
+enum
+{
+  CSVAGG_COUNT, CSVAGG_SUM, CSVAGG_MEAN, CSVAGG_STDDEV,
+  CSVAGG_MIN, CSVAGG_MAX, CSVAGG_FIRST, CSVAGG_LAST,
+};
+
+static const char * const csvagg_name[] =
+{
+  "count", "sum", "mean", "stddev", "min", "max", "first", "last", 0
+};
+
+typedef struct
+{
+  int         ag_func;
+  int         ag_col;    // source column, -1 = none
+  char       *ag_label;  // result column
+} csvagg_t;
+
+typedef struct
+{
+  double      av_count;  // values seen
+  double      av_mean;   // running mean & sum of squared
+  double      av_m2;     // deviations of numbers
+  double      av_sum;
+  int64_t     av_isum;   // exact sum while all are integers
+  int         av_exact;
+  csvcell_t   av_cell;   // min, max, first or last value
+} csvaggval_t;
+
+typedef struct
+{
+  csvagg_t    *agg;
+  int          aggs;
+  csvaggval_t *val;      // aggs values per group
+} csvaggwork_t;
+
+static void
+csvagg_fold(csvaggval_t *v, int func, const csvcell_t *cell)
+{
+  int64_t i;
+  double  d;
+
+  switch( func )
+  {
+  case CSVAGG_COUNT:
+    v->av_count += 1;
+    break;
+
+  case CSVAGG_SUM:
+  case CSVAGG_MEAN:
+  case CSVAGG_STDDEV:
+    if( csvcell_isstring(cell) )
+    {
+      break;
+    }
+    d = csvcell_getnumber(cell);
+    v->av_count += 1;
+    v->av_sum   += d;
+    if( v->av_exact &&
+        !(csvcell_getinteger(cell, &i) &&
+          !__builtin_add_overflow(v->av_isum, i, &v->av_isum)) )
+    {
+      v->av_exact = 0;
+    }
+    if( func == CSVAGG_STDDEV )
+    {
+      double delta = d - v->av_mean;
+      v->av_mean += delta / v->av_count;
+      v->av_m2   += delta * (d - v->av_mean);
+    }
+    break;
+
+  case CSVAGG_MIN:
+  case CSVAGG_MAX:
+    if( v->av_count++ == 0 )
+    {
+      v->av_cell = *cell;
+    }
+    else if( (func == CSVAGG_MIN) ?
+             (csvcell_compare(cell, &v->av_cell) < 0) :
+             (csvcell_compare(cell, &v->av_cell) > 0) )
+    {
+      v->av_cell = *cell;
+    }
+    break;
+
+  case CSVAGG_FIRST:
+    if( v->av_count++ == 0 )
+    {
+      v->av_cell = *cell;
+    }
+    break;
+
+  case CSVAGG_LAST:
+    v->av_count += 1;
+    v->av_cell   = *cell;
+    break;
+  }
+}
+
+static void
+csvagg_result(const csvaggval_t *v, int func, csvcell_t *cell)
+{
+  if( v->av_count == 0 && func != CSVAGG_COUNT )
+  {
+    // leave empty
+    return;
+  }
+
+  switch( func )
+  {
+  case CSVAGG_COUNT:
+    csvcell_setnumber(cell, v->av_count);
+    break;
+
+  case CSVAGG_SUM:
+    if( v->av_exact )
+    {
+      csvcell_setinteger(cell, v->av_isum);
+    }
+    else
+    {
+      csvcell_setnumber(cell, v->av_sum);
+    }
+    break;
+
+  case CSVAGG_MEAN:
+    csvcell_setnumber(cell, (v->av_exact ? (double)v->av_isum : v->av_sum) /
+                      v->av_count);
+    break;
+
+  case CSVAGG_STDDEV:
+    if( v->av_count >= 2 )
+    {
+      // undefined for one value: leave empty
+      csvcell_setnumber(cell, sqrt(v->av_m2 / (v->av_count - 1)));
+    }
+    break;
+
+  default:
+    *cell = v->av_cell;
+    break;
+  }
+}
+
+static void
+csvagg_fold_job(csvgroup_t *grp, int part, void *user)
+{
+  csvaggwork_t *work = user;
+  csv_t        *csv  = grp->csv;
+
+  for( int r = 0; r < csv->csv_rowcnt; ++r )
+  {
+    if( (int)(grp->hash[r] % grp->parts) != part )
+    {
+      continue;
+    }
+
+    const csvrow_t *row = csv->csv_rowtab[r];
+    csvaggval_t    *val = work->val + (size_t)grp->group[r] * work->aggs;
+
+    for( int a = 0; a < work->aggs; ++a )
+    {
+      const csvagg_t  *agg  = &work->agg[a];
+      const csvcell_t *cell = 0;
+
+      if( agg->ag_col >= 0 )
+      {
+        cell = &row->cr_celltab[agg->ag_col];
+        if( csvcell_isempty(cell) )
+        {
+          continue;
+        }
+      }
+      csvagg_fold(&val[a], agg->ag_func, cell);
+    }
+  }
+}
+
+static int
+csvagg_parse(csv_t *csv, const char *aggs, csvagg_t **pagg)
+{
+  char     *work = strdup(aggs);
+  csvagg_t *agg  = 0;
+  int       cnt  = 0;
+  int       err  = 0;
+
+  for( char *pos = work; *pos && !err; )
+  {
+    char *fun = cstring_split_at_char(pos, &pos, ',');
+    char *lab = 0;
+    int   f   = 0;
+    int   c   = -1;
+
+    if( *fun == 0 )
+    {
+      continue;
+    }
+
+    if( (lab = strchr(fun, '(')) != 0 )
+    {
+      *lab++ = 0;
+      lab[strcspn(lab, ")")] = 0;
+    }
+
+    while( csvagg_name[f] && strcmp(csvagg_name[f], fun) ) ++f;
+
+    if( csvagg_name[f] == 0 )
+    {
+      msg_error("group: unknown aggregate '%s'\n", fun);
+      err = -1;
+      break;
+    }
+    if( lab == 0 && f != CSVAGG_COUNT )
+    {
+      msg_error("group: aggregate '%s' needs a column\n", fun);
+      err = -1;
+      break;
+    }
+    if( lab != 0 && (c = csv_getcol(csv, lab)) == -1 )
+    {
+      msg_error("group: unknown column '%s'\n", lab);
+      err = -1;
+      break;
+    }
+
+    agg = realloc(agg, (cnt + 1) * sizeof *agg);
+    if ( agg == NULL ) abort();
+
+    agg[cnt].ag_func = f;
+    agg[cnt].ag_col  = c;
+    if( lab == 0 )
+    {
+      agg[cnt].ag_label = strdup(fun);
+    }
+    else if( asprintf(&agg[cnt].ag_label, "%s_%s", fun, lab) < 0 )
+    {
+      abort();
+    }
+    ++cnt;
+
+    for( int a = 0; a < cnt - 1; ++a )
+    {
+      if( !strcmp(agg[a].ag_label, agg[cnt-1].ag_label) )
+      {
+        msg_error("group: duplicate aggregate '%s'\n", agg[a].ag_label);
+        err = -1;
+        break;
+      }
+    }
+  }
+
+  if( err != 0 )
+  {
+    for( int a = 0; a < cnt; ++a )
+    {
+      free(agg[a].ag_label);
+    }
+    free(agg), agg = 0, cnt = -1;
+  }
+
+  free(work);
+  *pagg = agg;
+  return cnt;
+}
+
+int
+csv_op_group(csv_t *self, const char *keys, const char *aggs)
+{
+  csvaggwork_t work;
+  char        *lab = strdup(keys);
+  int          err = 0;
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * resolve columns before changing table
+   * - - - - - - - - - - - - - - - - - - - */
+
+  for( char *pos = lab; *pos && !err; )
+  {
+    char *key = cstring_split_at_char(pos, &pos, ',');
+
+    if( *key != 0 && csv_getcol(self, key) == -1 )
+    {
+      msg_error("group: unknown key column '%s'\n", key);
+      err = -1;
+    }
+  }
+  free(lab);
+
+  if( err != 0 )
+  {
+    return -1;
+  }
+
+  if( aggs == 0 || *aggs == 0 )
+  {
+    aggs = "count";
+  }
+
+  if( (work.aggs = csvagg_parse(self, aggs, &work.agg)) < 0 )
+  {
+    return -1;
+  }
+
+  csvord_t   *ord = csvord_create(self, keys, 1);
+  csvgroup_t  grp;
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * result columns are added after keys,
+   * they must not replace them
+   * - - - - - - - - - - - - - - - - - - - */
+
+  const char *clash = 0;
+
+  for( int a = 0; a < work.aggs && !clash; ++a )
+  {
+    for( int k = 0; k < ord->co_cols && !clash; ++k )
+    {
+      if( !strcmp(csv_label(self, ord->co_forw[k]), work.agg[a].ag_label) )
+      {
+        clash = work.agg[a].ag_label;
+      }
+    }
+  }
+
+  if( clash != 0 )
+  {
+    msg_error("group: result column '%s' is also a key\n", clash);
+
+    for( int a = 0; a < work.aggs; ++a )
+    {
+      free(work.agg[a].ag_label);
+    }
+    free(work.agg);
+    csvord_delete(ord);
+    return -1;
+  }
+
+  csvgroup_ctor(&grp, self, ord->co_forw, ord->co_cols, 0);
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * fold rows into per group values, each
+   * partition is handled by one thread
+   * - - - - - - - - - - - - - - - - - - - */
+
+  work.val = calloc((size_t)grp.groups * work.aggs + 1, sizeof *work.val);
+  if ( work.val == NULL ) abort();
+
+  for( size_t i = 0; i < (size_t)grp.groups * work.aggs; ++i )
+  {
+    work.val[i].av_exact = 1;
+  }
+
+  csvgroup_run(&grp, csvagg_fold_job, &work);
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * one row per group: keys & aggregates
+   * - - - - - - - - - - - - - - - - - - - */
+
+  csvgroup_compact(&grp);
+  csvgroup_dtor(&grp);
+
+  csvord_apply(ord, self);
+  csvord_delete(ord);
+
+  for( int a = 0; a < work.aggs; ++a )
+  {
+    int col = csv_addcol(self, work.agg[a].ag_label);
+
+    for( int g = 0; g < self->csv_rowcnt; ++g )
+    {
+      csvagg_result(&work.val[(size_t)g * work.aggs + a],
+                    work.agg[a].ag_func, csv_getcell(self, g, col));
+    }
+    free(work.agg[a].ag_label);
+  }
+
+  free(work.agg);
+  free(work.val);
+
+  return 0;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_join  --  add columns of matching rows from another table
+ *
+ * Rows of self are matched to rows of other having equal values in
+ * the key columns, compared as with csvcell_compare(). Each match
+ * gives one result row: the columns of self followed by the non-key
+ * columns of other. Labels already in use get "_2", "_3" ... suffix.
+ * Result rows are in order of self, matches of one row in order of
+ * other. Rows without matches are dropped, or with CSV_JOIN_LEFT kept
+ * with empty values in the added columns.
+ *
+ * Groups of equal keys are made of the smaller table, which is then
+ * probed with the rows of the larger one, both in parallel on large
+ * tables. Other can be the table itself. Returns 0 on success, -1 if
+ * no key columns are given or a key column is missing.
+ * ------------------------------------------------------------------------- */
+
+typedef struct
+{
+  csv_t     *csv;
+  const int *key;
+  int       *match; // per row, group or -1
+} csvjoin_t;
+
+static void
+csvjoin_probe_job(csvgroup_t *grp, int part, void *user)
+{
+  csvjoin_t *join = user;
+  int        rows = join->csv->csv_rowcnt;
+  int        lo   = (int)((int64_t)rows * part / grp->parts);
+  int        hi   = (int)((int64_t)rows * (part + 1) / grp->parts);
+
+  for( int r = lo; r < hi; ++r )
+  {
+    join->match[r] = csvgroup_probe(grp, join->csv->csv_rowtab[r], join->key);
+  }
+}
+
+int
+csv_join(csv_t *self, csv_t *other, const char *keys, unsigned flags)
+{
+  int   lcols = csv_cols(self);
+  int   rcols = csv_cols(other);
+  int  *lkey  = calloc(rcols + 1, sizeof *lkey);
+  int  *rkey  = calloc(rcols + 1, sizeof *rkey);
+  int  *iskey = calloc(rcols + 1, sizeof *iskey);
+  char *work  = strdup(keys);
+  int   cnt   = 0;
+  int   err   = -1;
+
+  if( !lkey || !rkey || !iskey || !work ) abort();
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * key columns must exist in both tables
+   * - - - - - - - - - - - - - - - - - - - */
+
+  for( char *pos = work; *pos; )
+  {
+    char *lab = cstring_split_at_char(pos, &pos, ',');
+    int   lc, rc;
+
+    if( *lab == 0 )
+    {
+      continue;
+    }
+    if( (lc = csv_getcol(self, lab)) == -1 ||
+        (rc = csv_getcol(other, lab)) == -1 )
+    {
+      msg_error("join: key column '%s' missing\n", lab);
+      goto cleanup;
+    }
+    if( !iskey[rc] && cnt < rcols )
+    {
+      iskey[rc] = 1;
+      lkey[cnt] = lc;
+      rkey[cnt] = rc;
+      ++cnt;
+    }
+  }
+
+  if( cnt == 0 )
+  {
+    msg_error("join: no key columns\n");
+    goto cleanup;
+  }
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * group smaller table, probe with rows
+   * of the larger one
+   * - - - - - - - - - - - - - - - - - - - */
+
+  int        lrows = self->csv_rowcnt;
+  int        rrows = other->csv_rowcnt;
+  int        build = (rrows <= lrows); // 1 = groups of other
+  int       *lgrp  = malloc((lrows + 1) * sizeof *lgrp);
+  int       *rgrp  = malloc((rrows + 1) * sizeof *rgrp);
+  csvgroup_t grp;
+  csvjoin_t  join;
+
+  if( !lgrp || !rgrp ) abort();
+
+  csv_dropcellflags(self);
+
+  if( build )
+  {
+    csvgroup_ctor(&grp, other, rkey, cnt, 1);
+    memcpy(rgrp, grp.group, rrows * sizeof *rgrp);
+    join.csv = self, join.key = lkey, join.match = lgrp;
+  }
+  else
+  {
+    csvgroup_ctor(&grp, self, lkey, cnt, 1);
+    memcpy(lgrp, grp.group, lrows * sizeof *lgrp);
+    join.csv = other, join.key = rkey, join.match = rgrp;
+  }
+  csvgroup_run(&grp, csvjoin_probe_job, &join);
+
+  int groups = grp.groups;
+  csvgroup_dtor(&grp);
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * rows of other per group, in order
+   * - - - - - - - - - - - - - - - - - - - */
+
+  int *start = calloc(groups + 2, sizeof *start);
+  int *list  = malloc((rrows + 1) * sizeof *list);
+
+  if( !start || !list ) abort();
+
+  for( int r = 0; r < rrows; ++r )
+  {
+    if( rgrp[r] >= 0 )
+    {
+      start[rgrp[r] + 2] += 1;
+    }
+  }
+  for( int g = 0; g < groups; ++g )
+  {
+    start[g + 2] += start[g + 1];
+  }
+  for( int r = 0; r < rrows; ++r )
+  {
+    if( rgrp[r] >= 0 )
+    {
+      list[start[rgrp[r] + 1]++] = r;
+    }
+  }
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * make result rows, with room for the
+   * columns of other
+   * - - - - - - - - - - - - - - - - - - - */
+
+  int    size  = lcols + rcols - cnt;
+  size_t total = 0;
+
+  for( int l = 0; l < lrows; ++l )
+  {
+    int g = lgrp[l];
+    int n = (g >= 0) ? start[g + 1] - start[g] : 0;
+    total += (n > 0) ? n : (flags & CSV_JOIN_LEFT) ? 1 : 0;
+  }
+
+  if( total > INT_MAX )
+  {
+    msg_error("join: result would have %zu rows\n", total);
+    free(lgrp), free(rgrp), free(start), free(list);
+    goto cleanup;
+  }
+
+  csvrow_t **rowtab = malloc((total + 1) * sizeof *rowtab);
+  int       *source = malloc((total + 1) * sizeof *source);
+  mem_pool_t pool;
+  int        out = 0;
+
+  if( !rowtab || !source ) abort();
+
+  mem_pool_ctor(&pool);
+  pool.alloc = self->csv_rowpool.alloc;
+
+  if( size < self->csv_colmax )
+  {
+    size = self->csv_colmax;
+  }
+
+  for( int l = 0; l < lrows; ++l )
+  {
+    const csvrow_t *src = self->csv_rowtab[l];
+    int             g   = lgrp[l];
+    int             lo  = (g >= 0) ? start[g]     : 0;
+    int             hi  = (g >= 0) ? start[g + 1] : 0;
+
+    if( lo == hi && !(flags & CSV_JOIN_LEFT) )
+    {
+      continue;
+    }
+
+    for( int i = lo; i < hi || i == lo; ++i )
+    {
+      csvrow_t *dst = mem_pool_alloc(&pool, csvrow_sizeof(size));
+      memcpy(dst, src, csvrow_sizeof(src->cr_cols));
+      rowtab[out]   = dst;
+      source[out++] = (i < hi) ? list[i] : -1;
+    }
+  }
+
+  // other can be self: old rows stay valid until columns are copied
+  csvrow_t **oldtab  = self->csv_rowtab;
+  mem_pool_t oldpool = self->csv_rowpool;
+  csvrow_t **from    = (other == self) ? oldtab : other->csv_rowtab;
+
+  self->csv_rowpool = pool;
+  self->csv_rowtab  = rowtab;
+  self->csv_rowcnt  = out;
+  self->csv_rowmax  = (int)total + 1;
+  self->csv_colmax  = size;
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * add non-key columns of other
+   * - - - - - - - - - - - - - - - - - - - */
+
+  for( int rc = 0; rc < rcols; ++rc )
+  {
+    const char *lab = csv_label(other, rc);
+    char       *tmp = 0;
+    int         col = 0;
+
+    if( iskey[rc] )
+    {
+      continue;
+    }
+
+    for( int n = 2; csv_getcol(self, lab) != -1; ++n )
+    {
+      free(tmp);
+      if( asprintf(&tmp, "%s_%d", csv_label(other, rc), n) < 0 ) abort();
+      lab = tmp;
+    }
+
+    col = csv_addcol(self, lab);
+    free(tmp);
+
+    for( int o = 0; o < out; ++o )
+    {
+      if( source[o] >= 0 )
+      {
+        self->csv_rowtab[o]->cr_celltab[col] =
+          from[source[o]]->cr_celltab[rc];
+      }
+    }
+  }
+
+  free(oldtab);
+  mem_pool_dtor(&oldpool);
+
+  free(source);
+  free(lgrp);
+  free(rgrp);
+  free(start);
+  free(list);
+
+  err = 0;
+
+  cleanup:
+
+  free(work);
+  free(iskey);
+  free(rkey);
+  free(lkey);
+
+  return err;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_op_join  --  join with table loaded from file
+ *
+ * Argument is <path>:<key,...>[:inner|left].
+ * ------------------------------------------------------------------------- */
+
+int
+csv_op_join(csv_t *self, const char *args)
+{
+  char     *work  = strdup(args);
+  char     *pos   = work;
+  char     *path  = cstring_split_at_char(pos, &pos, ':');
+  char     *keys  = cstring_split_at_char(pos, &pos, ':');
+  char     *mode  = cstring_split_at_char(pos, &pos, ':');
+  unsigned  flags = 0;
+  csv_t    *other = 0;
+  int       err   = -1;
+
+  if( !strcmp(mode, "left") )
+  {
+    flags |= CSV_JOIN_LEFT;
+  }
+  else if( *mode != 0 && strcmp(mode, "inner") )
+  {
+    msg_error("join: unknown mode '%s'\n", mode);
+    goto cleanup;
+  }
+
+  other = csv_create();
+
+  if( csv_load(other, path) != 0 )
+  {
+    goto cleanup;
+  }
+
+  err = csv_join(self, other, keys, flags);
+
+  cleanup:
+
+  csv_delete(other);
+  free(work);
+
+  return err;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_top  --  first rows in sort order without sorting the table
+ *
+ * Keeps the rows :sort: with given labels would put first, count rows
+ * in total or, if group labels are given, count rows of each group
+ * of rows with equal values in group columns. With CSV_TOP_DESC the
+ * order is that of :sort: followed by :reverse. The kept rows are in
+ * that order.
+ *
+ * Every row is compared once against the worst row kept so far in a
+ * bounded heap. Without groups, each thread keeps a heap of its own
+ * slice of rows; with groups, heaps are per group and each hash
+ * partition of groups is handled by one thread. Heap contents are
+ * then sorted, and the first rows of each group kept. Heaps grow with
+ * the rows pushed to them, so a count beyond the row count costs no
+ * memory. Returns 0 on success, -1 if count is negative or heap memory
+ * runs out; the table is then left unchanged.
+ * ------------------------------------------------------------------------- */
+
+typedef struct
+{
+  csv_t      *csv;
+  const int  *order;   // sort columns
+  int         cols;
+  int         desc;
+  int         count;   // rows to keep per group
+  int       **heap;    // per group or slice, row indices
+  int        *size;
+  int        *room;    // allocated heap entries
+  int        *fail;    // per partition, heap allocation failed
+} csvtop_t;
+
+static int
+csvtop_compare(const csvtop_t *self, int a, int b)
+{
+  const csvrow_t *ra  = self->csv->csv_rowtab[a];
+  const csvrow_t *rb  = self->csv->csv_rowtab[b];
+  int             res = 0;
+
+  for( int c = 0; c < self->cols && res == 0; ++c )
+  {
+    res = csvcell_compare(&ra->cr_celltab[self->order[c]],
+                          &rb->cr_celltab[self->order[c]]);
+  }
+  if( res == 0 )
+  {
+    // sorting is stable
+    res = (a > b) - (a < b);
+  }
+  return self->desc ? -res : res;
+}
+
+static int
+csvtop_compare_cb(const void *a, const void *b, void *aptr)
+{
+  return csvtop_compare(aptr, *(const int *)a, *(const int *)b);
+}
+
+static int
+csvtop_push(csvtop_t *self, int h, int row)
+{
+  // max heap, worst kept row at top
+  int *heap = self->heap[h];
+  int  n    = self->size[h];
+  int  i    = 0;
+
+  if( n < self->count && n == self->room[h] )
+  {
+    // grow geometrically up to count
+    int room = (n < 8) ? 16 : (n < self->count / 2) ? 2 * n : self->count;
+
+    if( room > self->count )
+    {
+      room = self->count;
+    }
+    if( (heap = realloc(heap, room * sizeof *heap)) == NULL )
+    {
+      return -1;
+    }
+    self->heap[h] = heap;
+    self->room[h] = room;
+  }
+
+  if( n < self->count )
+  {
+    for( i = self->size[h]++; i > 0; i = (i - 1) / 2 )
+    {
+      int p = (i - 1) / 2;
+      if( csvtop_compare(self, heap[p], row) >= 0 )
+      {
+        break;
+      }
+      heap[i] = heap[p];
+    }
+    heap[i] = row;
+    return 0;
+  }
+
+  if( csvtop_compare(self, row, heap[0]) >= 0 )
+  {
+    return 0;
+  }
+
+  for( ;; )
+  {
+    int l = 2 * i + 1;
+    int r = l + 1;
+    int m = i;
+    int v = row;
+
+    if( l < n && csvtop_compare(self, heap[l], v) > 0 )
+    {
+      m = l, v = heap[l];
+    }
+    if( r < n && csvtop_compare(self, heap[r], v) > 0 )
+    {
+      m = r;
+    }
+    if( m == i )
+    {
+      break;
+    }
+    heap[i] = heap[m];
+    i = m;
+  }
+  heap[i] = row;
+  return 0;
+}
+
+static void
+csvtop_job(csvgroup_t *grp, int part, void *user)
+{
+  csvtop_t *self = user;
+  int       rows = self->csv->csv_rowcnt;
+
+  if( grp->keys == 0 )
+  {
+    int lo = (int)((int64_t)rows * part / grp->parts);
+    int hi = (int)((int64_t)rows * (part + 1) / grp->parts);
+
+    for( int r = lo; r < hi; ++r )
+    {
+      if( csvtop_push(self, part, r) < 0 )
+      {
+        self->fail[part] = 1;
+        return;
+      }
+    }
+    return;
+  }
+
+  for( int r = 0; r < rows; ++r )
+  {
+    if( (int)(grp->hash[r] % grp->parts) == part )
+    {
+      if( csvtop_push(self, grp->group[r], r) < 0 )
+      {
+        self->fail[part] = 1;
+        return;
+      }
+    }
+  }
+}
+
+int
+csv_top(csv_t *self, int count, const char *labels, const char *group,
+        unsigned flags)
+{
+  if( count < 0 )
+  {
+    msg_error("top: negative row count %d\n", count);
+    return -1;
+  }
+
+  if( count > self->csv_rowcnt )
+  {
+    // heaps never hold more than all rows
+    count = self->csv_rowcnt;
+  }
+
+  if( count == 0 )
+  {
+    // storage of dropped rows is released with the table
+    csv_dropcellflags(self);
+    self->csv_rowcnt = 0;
+    return 0;
+  }
+
+  csvord_t  *ord  = csvord_create(self, labels ? labels : "", 0);
+  csvord_t  *gord = csvord_create(self, group ? group : "", 1);
+  csvgroup_t grp;
+  csvtop_t   top;
+
+  csvgroup_ctor(&grp, self, gord->co_forw, gord->co_cols, 0);
+
+  int heaps = (grp.groups > grp.parts) ? grp.groups : grp.parts;
+
+  top.csv   = self;
+  top.order = ord->co_forw;
+  top.cols  = ord->co_cols;
+  top.desc  = (flags & CSV_TOP_DESC) != 0;
+  top.count = count;
+  top.heap  = calloc(heaps + 1, sizeof *top.heap);
+  top.size  = calloc(heaps + 1, sizeof *top.size);
+  top.room  = calloc(heaps + 1, sizeof *top.room);
+  top.fail  = calloc(grp.parts, sizeof *top.fail);
+
+  if( !top.heap || !top.size || !top.room || !top.fail ) abort();
+
+  csvgroup_run(&grp, csvtop_job, &top);
+
+  int *cand = 0;
+  int *kept = 0;
+  int  keep = 0;
+  int  err  = 0;
+
+  for( int p = 0; p < grp.parts; ++p )
+  {
+    err |= top.fail[p];
+  }
+
+  if( err )
+  {
+    msg_error("top: out of memory for %d rows per group\n", count);
+    err = -1;
+    goto cleanup;
+  }
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * sort heap contents, keep first rows
+   * of each group
+   * - - - - - - - - - - - - - - - - - - - */
+
+  size_t have = 0;
+
+  for( int h = 0; h < heaps; ++h )
+  {
+    have += top.size[h];
+  }
+
+  cand = malloc((have + 1) * sizeof *cand);
+  kept = calloc(grp.groups + 1, sizeof *kept);
+
+  if( !cand || !kept ) abort();
+
+  have = 0;
+  for( int h = 0; h < heaps; ++h )
+  {
+    if( top.size[h] > 0 )
+    {
+      // heaps of empty slices are never allocated
+      memcpy(cand + have, top.heap[h], top.size[h] * sizeof *cand);
+      have += top.size[h];
+    }
+  }
+
+  qsort_r(cand, have, sizeof *cand, csvtop_compare_cb, &top);
+
+  csvrow_t **rowtab = malloc((have + 1) * sizeof *rowtab);
+  if ( rowtab == NULL ) abort();
+
+  for( size_t i = 0; i < have; ++i )
+  {
+    int g = grp.group[cand[i]];
+
+    if( kept[g]++ < top.count )
+    {
+      rowtab[keep++] = self->csv_rowtab[cand[i]];
+    }
+  }
+
+  // storage of dropped rows is released with the table
+  csv_dropcellflags(self);
+  memcpy(self->csv_rowtab, rowtab, keep * sizeof *rowtab);
+  self->csv_rowcnt = keep;
+
+  free(rowtab);
+
+  cleanup:
+
+  for( int h = 0; h < heaps; ++h )
+  {
+    free(top.heap[h]);
+  }
+  free(kept);
+  free(cand);
+  free(top.heap);
+  free(top.size);
+  free(top.room);
+  free(top.fail);
+
+  csvgroup_dtor(&grp);
+  csvord_delete(gord);
+  csvord_delete(ord);
+
+  return err;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_op_top
+ *
+ * Argument is <count>:<label,...>[:asc|desc][:<group label,...>].
+ * ------------------------------------------------------------------------- */
+
+int
+csv_op_top(csv_t *self, const char *args)
+{
+  char     *work  = strdup(args);
+  char     *pos   = work;
+  char     *num   = cstring_split_at_char(pos, &pos, ':');
+  char     *keys  = cstring_split_at_char(pos, &pos, ':');
+  char     *mode  = cstring_split_at_char(pos, &pos, ':');
+  char     *group = cstring_split_at_char(pos, &pos, ':');
+  char     *end   = 0;
+  long      count = strtol(num, &end, 10);
+  unsigned  flags = 0;
+  int       err   = -1;
+
+  if( end == num || *end != 0 || count < 0 || count > INT_MAX )
+  {
+    msg_error("top: invalid row count '%s'\n", num);
+    goto cleanup;
+  }
+
+  if( !strcmp(mode, "desc") )
+  {
+    flags |= CSV_TOP_DESC;
+  }
+  else if( *mode != 0 && strcmp(mode, "asc") )
+  {
+    msg_error("top: unknown order '%s'\n", mode);
+    goto cleanup;
+  }
+
+  err = csv_top(self, (int)count, keys, group, flags);
+
+  cleanup:
+
+  free(work);
+
+  return err;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_delta  --  per key differences of cumulative counter columns
+ *
+ * For every row the values of given columns are compared to those of
+ * the previous row, in row order, having equal values in key columns.
+ * Differences are stored to "delta_<col>" columns, and if a time column
+ * is given, differences divided by elapsed time to "rate_<col>" columns.
+ * A value smaller than the previous one is taken as counter reset, the
+ * delta is then the value itself. Values are left empty on the first row
+ * of a key, when either value is not a number, or when time does not
+ * advance.
+ *
+ * Keying by e.g. pid and starttime keeps reused pids apart. Rows need
+ * not be sorted: partitions of keys are handled in parallel, each in
+ * one pass over the rows. Returns 0 on success, -1 if a column is
+ * missing or a result column would also be a key, time or counter.
+ * ------------------------------------------------------------------------- */
+
+typedef struct
+{
+  const int *src;    // counter columns
+  const int *dst;    // delta & rate column pairs
+  int        cols;
+  int        time;   // or -1
+  int       *last;   // per group, previous row or -1
+} csvdelta_t;
+
+static void
+csvdelta_row(const csvdelta_t *self, const csvrow_t *prev, csvrow_t *row)
+{
+  const csvcell_t *t0 = 0, *t1 = 0;
+  double           dt = 0;
+
+  if( self->time >= 0 )
+  {
+    t0 = &prev->cr_celltab[self->time];
+    t1 = &row->cr_celltab[self->time];
+    if( csvcell_isnumber(t0) && csvcell_isnumber(t1) )
+    {
+      dt = csvcell_getnumber(t1) - csvcell_getnumber(t0);
+    }
+  }
+
+  for( int c = 0; c < self->cols; ++c )
+  {
+    const csvcell_t *v0    = &prev->cr_celltab[self->src[c]];
+    const csvcell_t *v1    = &row->cr_celltab[self->src[c]];
+    csvcell_t       *delta = &row->cr_celltab[self->dst[2*c+0]];
+    csvcell_t       *rate  = &row->cr_celltab[self->dst[2*c+1]];
+    int64_t          i0, i1;
+    double           d;
+
+    if( !csvcell_isnumber(v0) || !csvcell_isnumber(v1) )
+    {
+      continue;
+    }
+
+    if( csvcell_getinteger(v0, &i0) && csvcell_getinteger(v1, &i1) &&
+        !__builtin_sub_overflow(i1, i0, &i0) )
+    {
+      // counter reset -> counted up from zero
+      csvcell_setinteger(delta, (i0 < 0) ? i1 : i0);
+    }
+    else
+    {
+      d = csvcell_getnumber(v1) - csvcell_getnumber(v0);
+      csvcell_setnumber(delta, (d < 0) ? csvcell_getnumber(v1) : d);
+    }
+
+    if( dt > 0 )
+    {
+      csvcell_setnumber(rate, csvcell_getnumber(delta) / dt);
+    }
+  }
+}
+
+static void
+csvdelta_job(csvgroup_t *grp, int part, void *user)
+{
+  const csvdelta_t *self = user;
+  csv_t            *csv  = grp->csv;
+
+  for( int r = 0; r < csv->csv_rowcnt; ++r )
+  {
+    if( (int)(grp->hash[r] % grp->parts) != part )
+    {
+      continue;
+    }
+
+    int g = grp->group[r];
+
+    // columns may exist already from earlier delta
+    for( int c = 0; c < 2 * self->cols; ++c )
+    {
+      csvcell_ctor(&csv->csv_rowtab[r]->cr_celltab[self->dst[c]]);
+    }
+
+    if( self->last[g] >= 0 )
+    {
+      csvdelta_row(self, csv->csv_rowtab[self->last[g]], csv->csv_rowtab[r]);
+    }
+    self->last[g] = r;
+  }
+}
+
+int
+csv_delta(csv_t *self, const char *keys, const char *cols, const char *time)
+{
+  int        size  = csv_cols(self) + 1;
+  int       *key   = calloc(size, sizeof *key);
+  int       *src   = calloc(size, sizeof *src);
+  int       *dst   = calloc(2 * size, sizeof *dst);
+  char      *work  = strdup(keys);
+  int        nkey  = 0;
+  int        nsrc  = 0;
+  int        err   = -1;
+  char     **name  = 0;   // result labels, delta & rate per column
+  csvdelta_t delta;
+  csvgroup_t grp;
+
+  if( !key || !src || !dst || !work ) abort();
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * resolve columns before adding any
+   * - - - - - - - - - - - - - - - - - - - */
+
+  for( char *pos = work; *pos; )
+  {
+    char *lab = cstring_split_at_char(pos, &pos, ',');
+
+    if( *lab == 0 )
+    {
+      continue;
+    }
+    if( nkey == size || (key[nkey++] = csv_getcol(self, lab)) == -1 )
+    {
+      msg_error("delta: key column '%s' missing\n", lab);
+      goto cleanup;
+    }
+  }
+
+  free(work), work = strdup(cols);
+
+  for( char *pos = work; *pos; )
+  {
+    char *lab = cstring_split_at_char(pos, &pos, ',');
+
+    if( *lab == 0 )
+    {
+      continue;
+    }
+    if( nsrc == size || (src[nsrc++] = csv_getcol(self, lab)) == -1 )
+    {
+      msg_error("delta: column '%s' missing\n", lab);
+      goto cleanup;
+    }
+  }
+
+  delta.time = -1;
+  if( time && *time && (delta.time = csv_getcol(self, time)) == -1 )
+  {
+    msg_error("delta: time column '%s' missing\n", time);
+    goto cleanup;
+  }
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * result columns are cleared row by row,
+   * they can not be inputs of the pass
+   * - - - - - - - - - - - - - - - - - - - */
+
+  if( (name = calloc(2 * nsrc + 1, sizeof *name)) == NULL ) abort();
+
+  for( int i = 0; i < 2 * nsrc; ++i )
+  {
+    if( (i & 1) && delta.time < 0 )
+    {
+      continue;
+    }
+    if( asprintf(&name[i], "%s_%s", (i & 1) ? "rate" : "delta",
+                 csv_label(self, src[i / 2])) < 0 ) abort();
+
+    int col = csv_getcol(self, name[i]);
+    int use = (col >= 0 && col == delta.time);
+
+    for( int k = 0; k < nkey; ++k ) use |= (col >= 0 && col == key[k]);
+    for( int k = 0; k < nsrc; ++k ) use |= (col >= 0 && col == src[k]);
+
+    if( use )
+    {
+      msg_error("delta: result column '%s' is also an input\n", name[i]);
+      goto cleanup;
+    }
+  }
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * add result columns
+   * - - - - - - - - - - - - - - - - - - - */
+
+  // rows are moved at most once
+  csv_reserve(self, 0, csv_cols(self) + nsrc * ((delta.time < 0) ? 1 : 2));
+
+  for( int i = 0; i < 2 * nsrc; ++i )
+  {
+    // without time column, rate slot refers to delta column
+    dst[i] = name[i] ? csv_addcol(self, name[i]) : dst[i - 1];
+  }
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * one pass in row order per partition
+   * - - - - - - - - - - - - - - - - - - - */
+
+  csv_dropcellflags(self);
+  csvgroup_ctor(&grp, self, key, nkey, 0);
+
+  delta.src  = src;
+  delta.dst  = dst;
+  delta.cols = nsrc;
+  delta.last = malloc((grp.groups + 1) * sizeof *delta.last);
+  if ( delta.last == NULL ) abort();
+
+  for( int g = 0; g < grp.groups; ++g )
+  {
+    delta.last[g] = -1;
+  }
+
+  csvgroup_run(&grp, csvdelta_job, &delta);
+
+  free(delta.last);
+  csvgroup_dtor(&grp);
+  err = 0;
+
+  cleanup:
+
+  for( int i = 0; name && i < 2 * nsrc; ++i )
+  {
+    free(name[i]);
+  }
+  free(name);
+  free(work);
+  free(dst);
+  free(src);
+  free(key);
+
+  return err;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_op_delta
+ *
+ * Argument is <key label,...>:<label,...>[:<time label>], time column
+ * defaults to "time" if the table has one.
  * ------------------------------------------------------------------------- */
 
-// QUARANTINE int
-// QUARANTINE csv_save(csv_t *self, const char *path)
-// QUARANTINE {
-// QUARANTINE   int     error = -1;
-// QUARANTINE   FILE   *file  = NULL;
-// QUARANTINE   FILE   *newf  = NULL;
-// QUARANTINE
-// QUARANTINE   /* - - - - - - - - - - - - - - - - - - - *
-// QUARANTINE    * open output
-// QUARANTINE    * - - - - - - - - - - - - - - - - - - - */
-// QUARANTINE
-// QUARANTINE   if( path == NULL || !strcmp(path, "-") )
-// QUARANTINE   {
-// QUARANTINE     file = stdout;
-// QUARANTINE     path = "<stdout>";
-// QUARANTINE   }
-// QUARANTINE   else
-// QUARANTINE   {
-// QUARANTINE     file = newf = fopen(path, "w");
-// QUARANTINE   }
-// QUARANTINE
-// QUARANTINE   csv_setsource(self, path);
-// QUARANTINE
-// QUARANTINE   if( file == NULL )
-// QUARANTINE   {
-// QUARANTINE     perror(path); goto cleanup;
-// QUARANTINE   }
-// QUARANTINE
-// QUARANTINE   /* - - - - - - - - - - - - - - - - - - - *
-// QUARANTINE    * output header
-// QUARANTINE    * - - - - - - - - - - - - - - - - - - - */
-// QUARANTINE
-// QUARANTINE
-// QUARANTINE   if( !(self->csv_flags & CTF_NO_HEADER) )
-// QUARANTINE   {
-// QUARANTINE     for( int i=0, n=array_size(&self->csv_head); i < n; ++i )
-// QUARANTINE     {
-// QUARANTINE       csvvar_t *var = array_get(&self->csv_head, i);
-// QUARANTINE       fprintf(file, "%s=%s\n", var->cv_key, var->cv_val);
-// QUARANTINE     }
-// QUARANTINE     fprintf(file, "\n");
-// QUARANTINE   }
-// QUARANTINE
-// QUARANTINE   /* - - - - - - - - - - - - - - - - - - - *
-// QUARANTINE    * output table labels
-// QUARANTINE    * - - - - - - - - - - - - - - - - - - - */
-// QUARANTINE
-// QUARANTINE
-// QUARANTINE   if( !(self->csv_flags & CTF_NO_LABELS) )
-// QUARANTINE   {
-// QUARANTINE     for( int i=0, n=csv_cols(self); i < n; ++i )
-// QUARANTINE     {
-// QUARANTINE       char t[32];
-// QUARANTINE       const char *s = csvrow_getstring(self->csv_labtab, i, t, sizeof t);
-// QUARANTINE       fprintf(file, "%s%s", i ? "," : "", s);
-// QUARANTINE     }
-// QUARANTINE     fprintf(file, "\n");
-// QUARANTINE   }
-// QUARANTINE
-// QUARANTINE   /* - - - - - - - - - - - - - - - - - - - *
-// QUARANTINE    * output table body
-// QUARANTINE    * - - - - - - - - - - - - - - - - - - - */
-// QUARANTINE
-// QUARANTINE   for( int r = 0; r < self->csv_rowcnt; ++r )
-// QUARANTINE   {
-// QUARANTINE     const csvrow_t *row = self->csv_rowtab[r];
-// QUARANTINE
-// QUARANTINE     for( int c = 0; c < row->cr_cols; ++c )
-// QUARANTINE     {
-// QUARANTINE       char t[32];
-// QUARANTINE       const char *s = csvrow_getstring(row, c, t, sizeof t);
-// QUARANTINE       fprintf(file, "%s%s", c ? "," : "", s);
-// QUARANTINE     }
-// QUARANTINE     fprintf(file, "\n");
-// QUARANTINE   }
-// QUARANTINE
-// QUARANTINE   if( !(self->csv_flags & CTF_NO_TERMINATOR) )
-// QUARANTINE   {
-// QUARANTINE     fprintf(file, "\n");
-// QUARANTINE   }
-// QUARANTINE
-// QUARANTINE   if( ferror(file) )
-// QUARANTINE   {
-// QUARANTINE     perror(path); goto cleanup;
-// QUARANTINE   }
-// QUARANTINE
-// QUARANTINE   error = 0;
-// QUARANTINE
-// QUARANTINE   /* - - - - - - - - - - - - - - - - - - - *
-// QUARANTINE    * cleanup
-// QUARANTINE    * - - - - - - - - - - - - - - - - - - - */
-// QUARANTINE
-// QUARANTINE   cleanup:
-// QUARANTINE
-// QUARANTINE   if( newf != NULL )
-// QUARANTINE   {
-// QUARANTINE     fclose(newf);
-// QUARANTINE   }
-// QUARANTINE
-// QUARANTINE   return error;
-// QUARANTINE }
-// QUARANTINE
+int
+csv_op_delta(csv_t *self, const char *args)
+{
+  char *work = strdup(args);
+  char *pos  = work;
+  char *keys = cstring_split_at_char(pos, &pos, ':');
+  char *cols = cstring_split_at_char(pos, &pos, ':');
+  char *time = cstring_split_at_char(pos, &pos, ':');
+
+  if( *time == 0 && csv_getcol(self, "time") != -1 )
+  {
+    time = "time";
+  }
+
+  int err = csv_delta(self, keys, cols, time);
+
+  free(work);
+
+  return err;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_gather_inputs  --  column views for values expression only reads
+ *
+ * Variables referring to existing columns that are not assigned to
+ * anywhere in the expression are bound to their columns, and the
+ * columns are gathered. Returns table of views indexed by column,
+ * NULL for columns that must be accessed via rows.
+ * ------------------------------------------------------------------------- */
+
+static csvcolumn_t **
+csv_gather_inputs(csv_t *self, calc_t *calc)
+{
+  int           cols = csv_cols(self);
+  csvcolumn_t **view = calloc(cols + 1, sizeof *view);
+  calcstk_t    *fifo = &calc->calc_fifo;
+
+  for( int i = 0; i < fifo->stk_tail; ++i )
+  {
+    calctok_t  *tok = fifo->stk_data[i];
+    const char *sym = 0;
+    int         col = -1;
+
+    if( tok->tok_code != tc_var || !csvcell_isstring(&tok->tok_sym) )
+    {
+      continue;
+    }
+
+    sym = calctok_getsymbol(tok);
+
+    for( int k = 0; k < fifo->stk_tail; ++k )
+    {
+      calctok_t *set = fifo->stk_data[k];
+
+      if( set->tok_code == tc_set &&
+          (!csvcell_isstring(&set->tok_arg1->tok_sym) ||
+           !strcmp(calctok_getsymbol(set->tok_arg1), sym)) )
+      {
+        sym = 0;
+        break;
+      }
+    }
+
+    if( sym != 0 )
+    {
+      col = csvschema_find(csv_getschema(self), sym);
+    }
+
+    if( col >= 0 )
+    {
+      tok->tok_col = col;
+
+      if( view[col] == 0 )
+      {
+        view[col] = csvcolumn_create(self, col);
+      }
+    }
+  }
+
+  return view;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_release_inputs
+ * ------------------------------------------------------------------------- */
+
+static void
+csv_release_inputs(csvcolumn_t **view, int cols)
+{
+  if( view != 0 )
+  {
+    for( int c = 0; c < cols; ++c )
+    {
+      csvcolumn_delete(view[c]);
+    }
+    free(view);
+  }
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_op_calc  --  evaluate expression row by row
+ * ------------------------------------------------------------------------- */
+
+int
+csv_op_calc(csv_t *self, const char *expr)
+{
+  int           row  = 0;
+  int           cols = csv_cols(self);
+  csvcolumn_t **view = 0;
+
+  void getsym(calc_t *calc, void *user, calctok_t *tok)
+  {
+    if( tok->tok_col >= 0 && tok->tok_col < cols && view[tok->tok_col] )
+    {
+      csvcolumn_getcell(view[tok->tok_col], row, &tok->tok_val);
+      return;
+    }
+
+    if( tok->tok_col < 0 )
+    {
+      tok->tok_col = csv_addcol(self, calctok_getsymbol(tok));
+    }
+
+    tok->tok_val = *csv_getcell(self, row, tok->tok_col);
+  }
+
+  void setsym(calc_t *calc, void *user, calctok_t *tok)
+  {
+    if( tok->tok_col < 0 )
+    {
+      tok->tok_col = csv_addcol(self, calctok_getsymbol(tok));
+    }
+    *csv_getcell(self, row, tok->tok_col) = tok->tok_val;
+  }
+
+  int     err  = -1;
+  calc_t *calc = 0;
+
+  calc = calc_create();
+  calc->calc_getvar = getsym;
+  calc->calc_setvar = setsym;
+
+  if( calc_compile(calc, expr) == 0 )
+  {
+    goto cleanup;
+  }
+
+  calc_reserve(calc, self);
+  view = csv_gather_inputs(self, calc);
+
+  for( row = 0; row < self->csv_rowcnt; ++row )
+  {
+    calc_evaluate(calc);
+  }
+
+  err = 0;
+  cleanup:
+
+  csv_release_inputs(view, cols);
+  calc_delete(calc);
+
+  return err;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_op_sort
+ * ------------------------------------------------------------------------- */
+
+void
+csv_op_sort(csv_t *self, const char *labels)
+{
+  // rows are compared in the column order csvord_apply() would
+  // produce, but the cells themselves are never moved
+  csvord_t *ord = csvord_create(self, labels, 0);
+  csv_sortuniq(self, ord->co_forw, ord->co_cols, 0);
+  csvord_delete(ord);
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_op_uniq
+ * ------------------------------------------------------------------------- */
+
+void
+csv_op_uniq(csv_t *self, const char *labels)
+{
+  if( labels != 0 && *labels != 0 )
+  {
+    // projections tend to have few distinct rows: drop duplicates
+    // via hashing and sort only what remains
+    csv_distinct(self, labels, CSV_DISTINCT_SORT);
+    return;
+  }
+
+  // whole rows are mostly distinct: the sort resolves them on
+  // the first columns, hashing would have to read every cell
+  csv_sortuniq(self, 0, 0, 1);
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_op_distinct
+ * ------------------------------------------------------------------------- */
+
+void
+csv_op_distinct(csv_t *self, const char *labels)
+{
+  csv_distinct(self, labels, 0);
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_op_count
+ * ------------------------------------------------------------------------- */
 
+int
+csv_op_count(csv_t *self, const char *labels)
+{
+  return csv_distinct(self, labels, CSV_DISTINCT_COUNT);
+}
 
-/* - - - - - - - - - - - - - - - - - - - *
- * csv_save_as_html emit functions
- * - - - - - - - - - - - - - - - - - - - */
-static void
-csv_write_escaped(FILE *file, const char* text)
+/* ------------------------------------------------------------------------- *
+ * csv_op_usecols
+ * ------------------------------------------------------------------------- */
+
+void
+csv_op_usecols(csv_t *self, const char *labels)
 {
-  while( text && *text )
+  csvord_t *ord = csvord_create(self, labels, 1);
+  csvord_apply(ord, self);
+  csvord_delete(ord);
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_op_remcols
+ * ------------------------------------------------------------------------- */
+
+void
+csv_op_remcols(csv_t *self, const char *labels)
+{
+  char *work = strdup(labels);
+  char *lab;
+  int   col;
+
+  for( char *pos = work; *pos; )
   {
-    int c = (unsigned char)*text++;
-    switch( c )
+    if( *(lab = cstring_split_at_char(pos,&pos,',')) != 0 )
     {
-    case '<': fputs("&lt;",  file); break;
-    case '>': fputs("&gt;",  file); break;
-    case '&': fputs("&gamp", file); break;
-    default: putc(c, file); break;
+      if( (col = csv_getcol(self, lab)) != -1 )
+      {
+        csv_remcol(self, col);
+      }
     }
   }
+
+  free(work);
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_save_as_html
+ * csv_op_origin
+ * ------------------------------------------------------------------------- */
+
+void
+csv_op_origin(csv_t *self, const char *labels)
+{
+  char *work = strdup(labels);
+  char *lab;
+  int   col;
+
+  for( char *pos = work; *pos; )
+  {
+    if( *(lab = cstring_split_at_char(pos,&pos,',')) != 0 )
+    {
+      if( (col = csv_getcol(self, lab)) != -1 )
+      {
+        csvcolumn_t *view = csvcolumn_create(self, col);
+        double      *numb = view->cl_number;
+        double       orig = 0.0;
+        int          cnt  = 0;
+
+        for( int row = 0; row < view->cl_rows; ++row )
+        {
+          if( !csvcolumn_isstring(view, row) )
+          {
+            if( (cnt++ == 0) || (orig > numb[row]) )
+            {
+              orig = numb[row];
+            }
+          }
+        }
+
+        for( int row = 0; row < view->cl_rows; ++row )
+        {
+          numb[row] -= csvcolumn_isstring(view, row) ? 0.0 : orig;
+        }
+
+        csvcolumn_store(view, self, col);
+        csvcolumn_delete(view);
+      }
+    }
+  }
+
+  free(work);
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_op_order
+ * ------------------------------------------------------------------------- */
+
+void
+csv_op_order(csv_t *self, const char *labels)
+{
+  csvord_t *ord = csvord_create(self, labels, 0);
+  csvord_apply(ord, self);
+  csvord_delete(ord);
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_op_reverse
+ * ------------------------------------------------------------------------- */
+
+void
+csv_op_reverse(csv_t *self)
+{
+  csv_dropcellflags(self);
+
+  for( int lo=0, hi=self->csv_rowcnt; lo < --hi; ++lo )
+  {
+    csvrow_t *a = self->csv_rowtab[lo];
+    csvrow_t *b = self->csv_rowtab[hi];
+    self->csv_rowtab[lo] = b;
+    self->csv_rowtab[hi] = a;
+  }
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_op_select  --  evaluate expression row by row
  * ------------------------------------------------------------------------- */
+
 int
-csv_save_as_html(csv_t *self, const char *path)
+csv_op_select(csv_t *self, const char *expr)
 {
-  int     error = -1;
-  FILE   *file  = NULL;
-  FILE   *newf  = NULL;
+  int           row  = 0;
+  int           cols = csv_cols(self);
+  csvcolumn_t **view = 0;
 
-  /* - - - - - - - - - - - - - - - - - - - *
-   * open output
-   * - - - - - - - - - - - - - - - - - - - */
+  void getsym(calc_t *calc, void *user, calctok_t *tok)
+  {
+    if( tok->tok_col >= 0 && tok->tok_col < cols && view[tok->tok_col] )
+    {
+      csvcolumn_getcell(view[tok->tok_col], row, &tok->tok_val);
+      return;
+    }
 
-  if( path == NULL || !strcmp(path, "-") )
+    if( tok->tok_col < 0 )
+    {
+      tok->tok_col = csv_addcol(self, calctok_getsymbol(tok));
+    }
+
+    tok->tok_val = *csv_getcell(self, row, tok->tok_col);
+  }
+
+  void setsym(calc_t *calc, void *user, calctok_t *tok)
   {
-    file = stdout;
-    path = "<stdout>";
+    if( tok->tok_col < 0 )
+    {
+      tok->tok_col = csv_addcol(self, calctok_getsymbol(tok));
+    }
+    *csv_getcell(self, row, tok->tok_col) = tok->tok_val;
   }
-  else
+
+  int     err  = -1;
+  calc_t *calc = 0;
+
+  calc = calc_create();
+  calc->calc_getvar = getsym;
+  calc->calc_setvar = setsym;
+
+  if( calc_compile(calc, expr) == 0 )
   {
-    file = newf = fopen(path, "w");
+    goto cleanup;
   }
 
-  //csv_setsource(self, path);
+  calc_reserve(calc, self);
+  view = csv_gather_inputs(self, calc);
 
-  if( file == NULL )
+  int cnt = 0;
+
+  for( row = 0; row < self->csv_rowcnt; ++row )
   {
-    perror(path); goto cleanup;
+    if( fabs(calc_evaluate(calc)) < CSV_EPSILON )
+    {
+      // storage of dropped rows is released with the table
+      continue;
+    }
+    self->csv_rowtab[cnt++] = self->csv_rowtab[row];
   }
 
-  /* - - - - - - - - - - - - - - - - - - - *
-   * output header
-   * - - - - - - - - - - - - - - - - - - - */
+  if( cnt != self->csv_rowcnt )
+  {
+    csv_dropcellflags(self);
+  }
+  self->csv_rowcnt = cnt;
 
-  fprintf(file, "<html>\n<head><title>");
-  csv_write_escaped(file, self->csv_source ?
-         cstring_basename(self->csv_source) :
-         "<unnamed csv data>");
-  fprintf(file, "</title></head>\n<body>\n");
+  err = 0;
+  cleanup:
 
-  if( !(self->csv_flags & CTF_NO_HEADER) )
+  csv_release_inputs(view, cols);
+  calc_delete(calc);
+
+  return err;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csv_filter  --  returns nonzero if operation could not be executed
+ * ------------------------------------------------------------------------- */
+
+int
+csv_filter(csv_t *self, const char *expression, const char *defop)
+{
+  int   err  = -1;
+  int   res  = 0;
+  char *work = strdup(expression);
+  const char *expr = work;
+  const char *oper = defop ? defop : "calc";
+
+  if( *work == ':' )
   {
-    int n = array_size(&self->csv_head);
+    oper = cstring_split_at_char(work+1, (char **)&expr, ':');
+  }
 
-    if( n > 0 )
+  if( !strcmp(oper, "calc") )
+  {
+    res = csv_op_calc(self, expr);
+  }
+  else if( !strcmp(oper, "select") )
+  {
+    res = csv_op_select(self, expr);
+  }
+  else if( !strcmp(oper, "sort") )
+  {
+    csv_op_sort(self, expr);
+  }
+  else if( !strcmp(oper, "uniq") || !strcmp(oper, "unique") )
+  {
+    csv_op_uniq(self, expr);
+  }
+  else if( !strcmp(oper, "distinct") )
+  {
+    csv_op_distinct(self, expr);
+  }
+  else if( !strcmp(oper, "count") )
+  {
+    res = csv_op_count(self, expr);
+  }
+  else if( !strcmp(oper, "top") )
+  {
+    res = csv_op_top(self, expr);
+  }
+  else if( !strcmp(oper, "delta") )
+  {
+    res = csv_op_delta(self, expr);
+  }
+  else if( !strcmp(oper, "join") )
+  {
+    res = csv_op_join(self, expr);
+  }
+  else if( !strcmp(oper, "group") )
+  {
+    // keys and aggregates are separated by colon,
+    // default aggregate is row count
+    char *aggs = strchr(expr, ':');
+    if( aggs != 0 )
     {
-      fprintf(file, "<table border=1>\n");
-      for( int i=0; i < n; ++i )
-      {
-        csvvar_t *var = array_get(&self->csv_head, i);
-        fprintf(file, "<tr><th>");
-        csv_write_escaped(file, var->cv_key);
-        fprintf(file, "<td>");
-        csv_write_escaped(file, var->cv_val);
-        fprintf(file, "\n");
-      }
-      fprintf(file, "</table>\n<hr>\n");
+      *aggs++ = 0;
+    }
+    res = csv_op_group(self, expr, aggs);
+    if( aggs != 0 )
+    {
+      aggs[-1] = ':';
     }
   }
-
-  /* - - - - - - - - - - - - - - - - - - - *
-   * output table labels
-   * - - - - - - - - - - - - - - - - - - - */
-
-  fprintf(file, "<table border=1>\n");
-
-  if( !(self->csv_flags & CTF_NO_LABELS) )
+  else if( !strcmp(oper, "usecols") )
+  {
+    csv_op_usecols(self, expr);
+  }
+  else if( !strcmp(oper, "order") )
+  {
+    csv_op_order(self, expr);
+  }
+  else if( !strcmp(oper, "remcols") )
+  {
+    csv_op_remcols(self, expr);
+  }
+  else if( !strcmp(oper, "reverse") )
+  {
+    csv_op_reverse(self);
+  }
+  else if( !strcmp(oper, "origin") )
+  {
+    csv_op_origin(self, expr);
+  }
+  else if( !strcmp(oper, "header") )
   {
-    const csvrow_t *row = self->csv_labtab;
-    fprintf(file, "<tr>\n");
-    for( int c = 0; c < row->cr_cols; ++c )
+    for( int i = 0; i < self->csv_head.size; ++i )
     {
-      const csvcell_t *cell = csvrow_getcell(row, c);
-      if( csvcell_isnumber(cell) )
-      {
-        fprintf(file, "<th align=right>"CELL_FMT"\n", csvcell_getnumber(cell));
-      }
-      else
-      {
-        fprintf(file, "<th>");
-        csv_write_escaped(file, csvcell_getstring(cell,0,0));
-        fprintf(file, "\n");
-      }
+      csvvar_t *var = array_get(&self->csv_head, i);
+      printf("%s=%s\n", var->cv_key, var->cv_val);
     }
+    exit(EXIT_SUCCESS);
   }
-
-  /* - - - - - - - - - - - - - - - - - - - *
-   * output table body
-   * - - - - - - - - - - - - - - - - - - - */
-
-  for( int r = 0; r < self->csv_rowcnt; ++r )
+  else if( !strcmp(oper, "labels") )
   {
-    const csvrow_t *row = self->csv_rowtab[r];
-
-    fprintf(file, "<tr>\n");
+    csvrow_t *row = self->csv_labtab;
     for( int c = 0; c < row->cr_cols; ++c )
     {
-      const csvcell_t *cell = csvrow_getcell(row, c);
-      if( csvcell_isnumber(cell) )
-      {
-        fprintf(file, "<td align=right>"CELL_FMT"\n", csvcell_getnumber(cell));
-      }
-      else
-      {
-        fprintf(file, "<td>");
-        csv_write_escaped(file, csvcell_getstring(cell,0,0));
-        fprintf(file, "\n");
-      }
+      char t[32];
+      printf("%s\n", csvcell_getstring(&row->cr_celltab[c], t, sizeof t));
     }
+    exit(EXIT_SUCCESS);
   }
-
-  fprintf(file, "</table>\n</body>\n</html>");
-
-  if( ferror(file) )
+  else
   {
-    perror(path); goto cleanup;
+    msg_fatal("unknown CSV operation '%s:%s'\n", oper, expr);
+    goto cleanup;
   }
 
-  error = 0;
+  {
+    char tmp[256];
+    int  len = snprintf(tmp, sizeof tmp, ":%s:%s", oper, expr);
+    if( len < sizeof tmp )
+    {
+      csv_addvar(self, "operation", tmp);
+    }
+    else
+    {
+      char *tmp = malloc(len + 1);
+      snprintf(tmp, len+1, ":%s:%s", oper, expr);
+      csv_addvar(self, "opearation", tmp);
+      free(tmp);
+    }
+  }
 
-  /* - - - - - - - - - - - - - - - - - - - *
-   * cleanup
-   * - - - - - - - - - - - - - - - - - - - */
+  err = res;
 
   cleanup:
 
-  if( newf != NULL )
-  {
-    fclose(newf);
-  }
+  free(work);
 
-  return error;
+  return err;
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_sortrows  --  sort rows in table
+ * csv_op_isrowlocal  --  check if operation can be applied to row subsets
+ *
+ * Row local operations give the same result regardless of whether
+ * the table is processed as a whole or in consecutive batches.
+ * Expressions that assign columns on some rows only are not: the
+ * columns of a batch would depend on the rows it happens to have.
  * ------------------------------------------------------------------------- */
 
-void
-csv_sortrows(csv_t *self)
+int
+csv_op_isrowlocal(const char *expression, const char *defop)
 {
-  if( self->csv_rowcnt > 1 )
+  static const char * const local[] =
   {
-    qsort(self->csv_rowtab, self->csv_rowcnt, sizeof *self->csv_rowtab,
-          csvrow_compare_indirect_cb);
-  }
-}
+    "calc", "select", "usecols", "remcols", "order", 0
+  };
 
-/* ------------------------------------------------------------------------- *
- * csv_op_calc  --  evaluate expression row by row
- * ------------------------------------------------------------------------- */
+  char       *work = strdup(expression);
+  const char *oper = defop ? defop : "calc";
+  char       *expr = work;
+  int         res  = 0;
 
-int
-csv_op_calc(csv_t *self, const char *expr)
-{
-  int row = 0;
+  if( *work == ':' )
+  {
+    oper = cstring_split_at_char(work+1, &expr, ':');
+  }
 
-  void getsym(calc_t *calc, void *user, calctok_t *tok)
+  for( int i = 0; local[i]; ++i )
   {
-    if( tok->tok_col < 0 )
+    if( !strcmp(oper, local[i]) )
     {
-      tok->tok_col = csv_addcol(self, calctok_getsymbol(tok));
+      res = 1;
+      break;
     }
-
-    tok->tok_val = *csv_getcell(self, row, tok->tok_col);
   }
 
-  void setsym(calc_t *calc, void *user, calctok_t *tok)
+  if( res && (!strcmp(oper, "calc") || !strcmp(oper, "select")) )
   {
-    if( tok->tok_col < 0 )
+    calc_t *calc = calc_create();
+
+    // errors are reported when the operation is executed
+    calc->calc_quiet = 1;
+
+    if( calc_compile(calc, expr) && calc_sets_conditionally(calc) )
     {
-      tok->tok_col = csv_addcol(self, calctok_getsymbol(tok));
+      res = 0;
     }
-    *csv_getcell(self, row, tok->tok_col) = tok->tok_val;
+    calc_delete(calc);
   }
 
-  int     err  = -1;
-  calc_t *calc = 0;
+  free(work);
 
-  calc = calc_create();
-  calc->calc_getvar = getsym;
-  calc->calc_setvar = setsym;
+  return res;
+}
 
-  if( calc_compile(calc, expr) == 0 )
-  {
-    goto cleanup;
-  }
+/* ========================================================================= *
+ * csvstream_t  --  methods
+ * ========================================================================= */
 
-  for( row = 0; row < self->csv_rowcnt; ++row )
-  {
-    calc_evaluate(calc);
-  }
+enum { CSV_STREAM_ROWS = 1 << 14 };
 
-  err = 0;
-  cleanup:
+struct csvstream_t
+{
+  csv_t        *sm_table;    // rows of current batch
+  parser_t     *sm_parser;
+  writer_t     *sm_writer;
+  int           sm_eof;      // all input rows parsed
+  int           sm_follow;   // wait for rows appended to input
+
+  csvrow_t     *sm_labtab;   // input labels
+  unsigned     *sm_colflags; // input column flags
+  csvschema_t  *sm_schema;   // input label index
+  int           sm_vars;     // header variables after first batch
+
+  int           sm_cols;     // output columns, -1 = labels not written
+  const char  **sm_labels;   // output labels
+  int          *sm_map;      // output column -> table column
+  int           sm_extra;    // dropped columns have been reported
+};
 
-  calc_delete(calc);
+/* ------------------------------------------------------------------------- *
+ * csvstream_reset  --  discard rows and restore input columns
+ * ------------------------------------------------------------------------- */
 
-  return err;
+static void
+csvstream_reset(csvstream_t *self)
+{
+  csv_t *csv  = self->sm_table;
+  int    cols = self->sm_labtab->cr_cols;
+
+  csv->csv_rowcnt = 0;
+  mem_pool_dtor(&csv->csv_rowpool);
+
+  csvrow_delete(csv->csv_labtab);
+  csv->csv_labtab = csvrow_create(cols);
+  memcpy(csv->csv_labtab->cr_celltab, self->sm_labtab->cr_celltab,
+         cols * sizeof *self->sm_labtab->cr_celltab);
+
+  csvschema_delete(csv->csv_schema);
+  csv->csv_schema = csvschema_share(self->sm_schema);
+
+  csv->csv_colflags = realloc(csv->csv_colflags,
+                              (cols + 1) * sizeof *csv->csv_colflags);
+  memcpy(csv->csv_colflags, self->sm_colflags,
+         cols * sizeof *csv->csv_colflags);
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_op_sort
+ * csvstream_trimvars  --  drop header variables added after first batch
  * ------------------------------------------------------------------------- */
 
-void
-csv_op_sort(csv_t *self, const char *labels)
+static void
+csvstream_trimvars(csvstream_t *self)
 {
-  csvord_t *ord = csvord_create(self, labels, 0);
-  csvord_apply(ord, self);
-  csv_sortrows(self);
-  csvord_unapply(ord, self);
-  csvord_delete(ord);
+  csv_t *csv = self->sm_table;
+
+  if( self->sm_vars < 0 )
+  {
+    self->sm_vars = array_size(&csv->csv_head);
+  }
+
+  while( array_size(&csv->csv_head) > self->sm_vars )
+  {
+    csvvar_delete(array_pop(&csv->csv_head));
+  }
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_op_uniq
+ * csvstream_remap  --  map table columns to columns already written
+ *
+ * Operations can produce different columns for different batches,
+ * e.g. calc adds assigned columns only when evaluated for a row.
+ * Returns NULL if table columns match the output as is.
  * ------------------------------------------------------------------------- */
 
-void
-csv_op_uniq(csv_t *self, const char *labels)
+static const int *
+csvstream_remap(csvstream_t *self)
 {
-  if( labels != 0 && *labels != 0 )
+  csv_t *csv  = self->sm_table;
+  int    cols = csv_cols(csv);
+  int    same = (cols == self->sm_cols);
+
+  for( int c = 0; same && c < cols; ++c )
   {
-    csvord_t *ord = csvord_create(self, labels, 1);
-    csvord_apply(ord, self);
-    csvord_delete(ord);
+    same = (csv_label(csv, c) == self->sm_labels[c]);
+  }
+  if( same )
+  {
+    return 0;
   }
 
-  csv_sortrows(self);
-
-  int di = 0;
-  csvrow_t *prev = 0;
-
-  for( int si = 0; si < self->csv_rowcnt; ++si )
+  for( int o = 0; o < self->sm_cols; ++o )
   {
-    csvrow_t *curr = self->csv_rowtab[si];
+    self->sm_map[o] = -1;
 
-    if( prev != 0 && csvrow_compare(prev, curr) == 0 )
+    for( int c = 0; c < cols; ++c )
     {
-      csvrow_delete(curr);
+      if( !strcmp(csv_label(csv, c), self->sm_labels[o]) )
+      {
+        self->sm_map[o] = c;
+        break;
+      }
     }
-    else
+  }
+
+  for( int c = 0; c < cols && !self->sm_extra; ++c )
+  {
+    int o = 0;
+
+    while( o < self->sm_cols && self->sm_map[o] != c ) ++o;
+
+    if( o == self->sm_cols && csv->csv_rowcnt > 0 )
     {
-      self->csv_rowtab[di++] = prev = curr;
+      msg_warning("%s: column '%s' not in streamed output\n",
+                  self->sm_parser->path, csv_label(csv, c));
+      self->sm_extra = 1;
     }
   }
-  self->csv_rowcnt = di;
+  return self->sm_map;
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_op_usecols
+ * csvstream_snapshot  --  remember input columns
  * ------------------------------------------------------------------------- */
 
-void
-csv_op_usecols(csv_t *self, const char *labels)
+static void
+csvstream_snapshot(csvstream_t *self)
 {
-  csvord_t *ord = csvord_create(self, labels, 1);
-  csvord_apply(ord, self);
-  csvord_delete(ord);
-}
+  csv_t *csv  = self->sm_table;
+  int    cols = csv_cols(csv);
 
-/* ------------------------------------------------------------------------- *
- * csv_op_remcols
- * ------------------------------------------------------------------------- */
+  csvrow_delete(self->sm_labtab);
+  self->sm_labtab = csvrow_create(cols);
+  memcpy(self->sm_labtab->cr_celltab, csv->csv_labtab->cr_celltab,
+         cols * sizeof *csv->csv_labtab->cr_celltab);
 
-void
-csv_op_remcols(csv_t *self, const char *labels)
-{
-  char *work = strdup(labels);
-  char *lab;
-  int   col;
+  csvschema_delete(self->sm_schema);
+  self->sm_schema = csvschema_share(csv_getschema(csv));
 
-  for( char *pos = work; *pos; )
+  free(self->sm_colflags);
+  self->sm_colflags = calloc(cols + 1, sizeof *self->sm_colflags);
+  if( cols > 0 )
   {
-    if( *(lab = cstring_split_at_char(pos,&pos,',')) != 0 )
-    {
-      if( (col = csv_getcol(self, lab)) != -1 )
-      {
-        csv_remcol(self, col);
-      }
-    }
+    memcpy(self->sm_colflags, csv->csv_colflags,
+           cols * sizeof *csv->csv_colflags);
   }
-
-  free(work);
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_op_origin
+ * csvstream_start  --  parse header and labels, open output
  * ------------------------------------------------------------------------- */
 
-void
-csv_op_origin(csv_t *self, const char *labels)
+static csvstream_t *
+csvstream_start(csv_t *table, const char *input, const char *output,
+                int follow)
 {
-  char *work = strdup(labels);
-  char *lab;
-  int   col;
+  int       map    = !follow && !(table->csv_flags & CTF_NO_MMAP);
+  parser_t *parser = parser_open(input, map);
+  writer_t *writer = 0;
 
-  for( char *pos = work; *pos; )
+  if( parser->error )
   {
-    if( *(lab = cstring_split_at_char(pos,&pos,',')) != 0 )
-    {
-      if( (col = csv_getcol(self, lab)) != -1 )
-      {
-        int       cnt = 0;
-        csvcell_t val = CSVCELL_ZERO;
+    perror(input);
+    parser_free(parser);
+    return 0;
+  }
 
-        for( int row = 0; row < self->csv_rowcnt; ++row )
-        {
-          csvcell_t *cell = csv_getcell(self, row, col);
+  writer = writer_open(output);
 
-          if( csvcell_isnumber(cell) )
-          {
-            if( (cnt++ == 0) || (csvcell_compare(&val, cell) > 0) )
-            {
-              val = *cell;
-            }
-          }
-        }
+  if( writer->error )
+  {
+    perror(output);
+    writer_free(writer);
+    parser_free(parser);
+    return 0;
+  }
 
-        for( int row = 0; row < self->csv_rowcnt; ++row )
-        {
-          csvcell_t *cell = csv_getcell(self, row, col);
+  csvstream_t *self = calloc(1, sizeof *self);
 
-          if( csvcell_isnumber(cell) )
-          {
-            cell->cc_number -= val.cc_number;
-          }
-        }
-      }
-    }
-  }
+  self->sm_table  = table;
+  self->sm_parser = parser;
+  self->sm_writer = writer;
+  self->sm_eof    = (csv_parse_head(table, parser) != 0);
+  self->sm_follow = follow;
 
-  free(work);
+  parser->limit = CSV_STREAM_ROWS;
+
+  csvstream_snapshot(self);
+
+  self->sm_vars   = -1;
+  self->sm_cols   = -1;
+  self->sm_labels = 0;
+  self->sm_map    = 0;
+  self->sm_extra  = 0;
+
+  return self;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csvstream_open  --  parse header and labels, open output
+ * ------------------------------------------------------------------------- */
+
+csvstream_t *
+csvstream_open(csv_t *table, const char *input, const char *output)
+{
+  return csvstream_start(table, input, output, 0);
+}
+
+/* ------------------------------------------------------------------------- *
+ * csvstream_follow  --  like csvstream_open(), but keep reading rows
+ *
+ * When all rows of the input file have been read, csvstream_read()
+ * returns empty batches until more rows are appended to the file.
+ * The stream ends only at table terminator or if the file gets
+ * truncated. Written rows are flushed to output after each batch.
+ * ------------------------------------------------------------------------- */
+
+csvstream_t *
+csvstream_follow(csv_t *table, const char *input, const char *output)
+{
+  return csvstream_start(table, input, output, 1);
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_op_order
+ * csvstream_project  --  restrict columns to parse, see csv_load_cols()
+ *
+ * Must be called before the first csvstream_read().
  * ------------------------------------------------------------------------- */
 
 void
-csv_op_order(csv_t *self, const char *labels)
+csvstream_project(csvstream_t *self, const char *labels, int remove)
 {
-  csvord_t *ord = csvord_create(self, labels, 0);
-  csvord_apply(ord, self);
-  csvord_delete(ord);
+  csv_project(self->sm_table, self->sm_parser, labels, remove);
+  csvstream_snapshot(self);
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_op_reverse
+ * csvstream_where  --  skip rows while parsing, see csv_load_where()
+ *
+ * Must be called before the first csvstream_read(), and the
+ * expression must stay valid until the stream is closed.
  * ------------------------------------------------------------------------- */
 
 void
-csv_op_reverse(csv_t *self)
+csvstream_where(csvstream_t *self, const char *expr)
 {
-  for( int lo=0, hi=self->csv_rowcnt; lo < --hi; ++lo )
+  if( expr != 0 && self->sm_parser->idx != 0 )
   {
-    csvrow_t *a = self->csv_rowtab[lo];
-    csvrow_t *b = self->csv_rowtab[hi];
-    self->csv_rowtab[lo] = b;
-    self->csv_rowtab[hi] = a;
+    parser_where(self->sm_parser, self->sm_table, expr);
   }
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_op_select  --  evaluate expression row by row
+ * csvstream_read  --  parse next batch of rows into the table
+ *
+ * Returns 1 when all input has been parsed, 0 if there might
+ * be more rows to read after the current batch.
  * ------------------------------------------------------------------------- */
 
 int
-csv_op_select(csv_t *self, const char *expr)
+csvstream_read(csvstream_t *self)
 {
-  int row = 0;
-
-  void getsym(calc_t *calc, void *user, calctok_t *tok)
+  if( !self->sm_eof && self->sm_follow )
   {
-    if( tok->tok_col < 0 )
-    {
-      tok->tok_col = csv_addcol(self, calctok_getsymbol(tok));
-    }
-
-    tok->tok_val = *csv_getcell(self, row, tok->tok_col);
+    self->sm_eof = (parser_follow(self->sm_parser) == 0);
   }
-
-  void setsym(calc_t *calc, void *user, calctok_t *tok)
+  else if( !self->sm_eof )
   {
-    if( tok->tok_col < 0 )
+    int rc = parser_rows(self->sm_parser);
+
+    if( rc >= 0 )
     {
-      tok->tok_col = csv_addcol(self, calctok_getsymbol(tok));
+      if( rc != 0 )
+      {
+        msg_warning("%s: missing CSV table terminator\n",
+                    self->sm_parser->path);
+      }
+      self->sm_eof = 1;
     }
-    *csv_getcell(self, row, tok->tok_col) = tok->tok_val;
   }
 
-  int     err  = -1;
-  calc_t *calc = 0;
+  return self->sm_eof;
+}
 
-  calc = calc_create();
-  calc->calc_getvar = getsym;
-  calc->calc_setvar = setsym;
+/* ------------------------------------------------------------------------- *
+ * csvstream_write  --  write rows in the table and discard them
+ *
+ * Header and labels are written along with the first batch that
+ * has rows, or the last batch if all are empty. Header variables
+ * added by operations are taken from the first batch only.
+ * ------------------------------------------------------------------------- */
 
-  if( calc_compile(calc, expr) == 0 )
-  {
-    goto cleanup;
-  }
+void
+csvstream_write(csvstream_t *self)
+{
+  csv_t *csv = self->sm_table;
 
-  int cnt = 0;
+  csvstream_trimvars(self);
 
-  for( row = 0; row < self->csv_rowcnt; ++row )
+  if( self->sm_cols < 0 && (csv_rows(csv) > 0 || self->sm_eof) )
   {
-    if( fabs(calc_evaluate(calc)) < CSV_EPSILON )
-    {
-      csvrow_delete(self->csv_rowtab[row]);
-    }
-    else
+    csv_write_head(csv, self->sm_writer);
+
+    self->sm_cols   = csv_cols(csv);
+    self->sm_labels = calloc(self->sm_cols + 1, sizeof *self->sm_labels);
+    self->sm_map    = calloc(self->sm_cols + 1, sizeof *self->sm_map);
+
+    for( int c = 0; c < self->sm_cols; ++c )
     {
-      self->csv_rowtab[cnt++] = self->csv_rowtab[row];
+      self->sm_labels[c] = csv_label(csv, c);
     }
   }
 
-  self->csv_rowcnt = cnt;
-
-  err = 0;
-  cleanup:
+  if( self->sm_cols >= 0 )
+  {
+    csv_write_body(csv, self->sm_writer, csvstream_remap(self),
+                   self->sm_cols);
+  }
 
-  calc_delete(calc);
+  if( self->sm_follow )
+  {
+    writer_flush(self->sm_writer);
+    fflush(self->sm_writer->file);
+  }
 
-  return err;
+  csvstream_reset(self);
 }
 
 /* ------------------------------------------------------------------------- *
- * csv_filter
+ * csvstream_close  --  finish output and release stream
+ *
+ * Returns 0 if output was successfully written.
  * ------------------------------------------------------------------------- */
 
 int
-csv_filter(csv_t *self, const char *expression, const char *defop)
+csvstream_close(csvstream_t *self)
 {
-  int   err  = -1;
-  char *work = strdup(expression);
-  const char *expr = work;
-  const char *oper = defop ? defop : "calc";
-
-  if( *work == ':' )
-  {
-    oper = cstring_split_at_char(work+1, (char **)&expr, ':');
-  }
+  int rc = -1;
 
-  if( !strcmp(oper, "calc") )
-  {
-    csv_op_calc(self, expr);
-  }
-  else if( !strcmp(oper, "select") )
-  {
-    csv_op_select(self, expr);
-  }
-  else if( !strcmp(oper, "sort") )
-  {
-    csv_op_sort(self, expr);
-  }
-  else if( !strcmp(oper, "uniq") || !strcmp(oper, "unique") )
-  {
-    csv_op_uniq(self, expr);
-  }
-  else if( !strcmp(oper, "usecols") )
-  {
-    csv_op_usecols(self, expr);
-  }
-  else if( !strcmp(oper, "order") )
-  {
-    csv_op_order(self, expr);
-  }
-  else if( !strcmp(oper, "remcols") )
-  {
-    csv_op_remcols(self, expr);
-  }
-  else if( !strcmp(oper, "reverse") )
-  {
-    csv_op_reverse(self);
-  }
-  else if( !strcmp(oper, "origin") )
-  {
-    csv_op_origin(self, expr);
-  }
-  else if( !strcmp(oper, "header") )
-  {
-    for( int i = 0; i < self->csv_head.size; ++i )
-    {
-      csvvar_t *var = array_get(&self->csv_head, i);
-      printf("%s=%s\n", var->cv_key, var->cv_val);
-    }
-    exit(EXIT_SUCCESS);
-  }
-  else if( !strcmp(oper, "labels") )
+  if( self != 0 )
   {
-    csvrow_t *row = self->csv_labtab;
-    for( int c = 0; c < row->cr_cols; ++c )
+    if( self->sm_cols < 0 )
     {
-      char t[32];
-      printf("%s\n", csvcell_getstring(&row->cr_celltab[c], t, sizeof t));
+      self->sm_eof = 1;
+      csvstream_write(self);
     }
-    exit(EXIT_SUCCESS);
+
+    self->sm_writer->error = -1;
+    csv_write_tail(self->sm_table, self->sm_writer);
+    rc = self->sm_writer->error;
+
+    writer_free(self->sm_writer);
+    parser_free(self->sm_parser);
+    csvrow_delete(self->sm_labtab);
+    free(self->sm_colflags);
+    csvschema_delete(self->sm_schema);
+    free(self->sm_labels);
+    free(self->sm_map);
+    free(self);
   }
-  else
+
+  return rc;
+}
+
+/* ========================================================================= *
+ * csvtail_t  --  methods
+ * ========================================================================= */
+
+struct csvtail_t
+{
+  csv_t        *tl_table;    // rows are appended here
+  parser_t     *tl_parser;   // input offset, separator & column mapping
+  int           tl_done;     // terminator found or input truncated
+};
+
+/* ------------------------------------------------------------------------- *
+ * csvtail_open  --  parse header and labels of file to follow
+ *
+ * Rows are added to the table by csvtail_read(). Parsed fields are
+ * stored by column index, so columns of the table must not be
+ * removed or reordered while following.
+ * ------------------------------------------------------------------------- */
+
+csvtail_t *
+csvtail_open(csv_t *table, const char *path)
+{
+  parser_t *parser = parser_open(path, 0);
+
+  if( parser->error )
   {
-    msg_fatal("unknown CSV operation '%s:%s'\n", oper, expr);
-    goto cleanup;
+    perror(path);
+    parser_free(parser);
+    return 0;
   }
 
+  csvtail_t *self = calloc(1, sizeof *self);
+
+  self->tl_table  = table;
+  self->tl_parser = parser;
+  self->tl_done   = (csv_parse_head(table, parser) != 0);
+
+  return self;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csvtail_read  --  parse rows completed since the previous call
+ *
+ * Returns number of rows added to the table, or -1 once the table
+ * has ended and there will be no more rows.
+ * ------------------------------------------------------------------------- */
+
+int
+csvtail_read(csvtail_t *self)
+{
+  int rows = csv_rows(self->tl_table);
+
+  if( self->tl_done )
   {
-    char tmp[256];
-    int  len = snprintf(tmp, sizeof tmp, ":%s:%s", oper, expr);
-    if( len < sizeof tmp )
-    {
-      csv_addvar(self, "operation", tmp);
-    }
-    else
-    {
-      char *tmp = malloc(len + 1);
-      snprintf(tmp, len+1, ":%s:%s", oper, expr);
-      csv_addvar(self, "opearation", tmp);
-      free(tmp);
-    }
+    return -1;
   }
 
-  err = 0;
+  self->tl_done = (parser_follow(self->tl_parser) == 0);
 
-  cleanup:
+  return csv_rows(self->tl_table) - rows;
+}
 
-  free(work);
+/* ------------------------------------------------------------------------- *
+ * csvtail_close
+ * ------------------------------------------------------------------------- */
 
-  return err;
+void
+csvtail_close(csvtail_t *self)
+{
+  if( self != 0 )
+  {
+    parser_free(self->tl_parser);
+    free(self);
+  }
 }
 
 // XoXoXoXoXoXoXoXoXoXoXoXoXoXoXoXoXoXoXoXoXoXoXoXoXoXoXoXoXoXoXoXoXoXoXoXoXoX
@@ -3061,6 +8994,8 @@ csvord_apply_dorow(csvord_t *self, csvrow_t *row)
 void
 csvord_apply(csvord_t *self, csv_t *csv)
 {
+  csv_dropcellflags(csv);
+  csv_dropschema(csv);
   csvord_apply_dorow(self, csv->csv_labtab);
   for( int r = 0; r < csv->csv_rowcnt; ++r )
   {
@@ -3089,9 +9024,163 @@ csvord_unapply_dorow(csvord_t *self, csvrow_t *row)
 void
 csvord_unapply(csvord_t *self, csv_t *csv)
 {
+  csv_dropcellflags(csv);
+  csv_dropschema(csv);
   csvord_unapply_dorow(self, csv->csv_labtab);
   for( int r = 0; r < csv->csv_rowcnt; ++r )
   {
     csvord_unapply_dorow(self, csv->csv_rowtab[r]);
   }
 }
+
+/* ========================================================================= *
+ * load & sort benchmark
+ *
+ * cc -DTESTMAIN -std=c99 -D_GNU_SOURCE -O2 -pthread csv_table.c \
+ *    libsysperf.a -lm
+ *
+ * ./a.out [-s <labels>] [-j <threads,...>] <file> ...
+ *
+ * With -s the loaded table is also sorted by given labels using each
+ * of the thread counts, 1,2,4... up to csv_getthreads() by default,
+ * and the speedup relative to the first count is reported.
+ * ========================================================================= */
+
+#ifdef TESTMAIN
+#include <time.h>
+
+static double
+bench_time(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double
+bench_load(const char *path, int flags, int *rows)
+{
+  csv_t *csv = csv_create();
+  csv->csv_flags |= flags;
+
+  double t = bench_time();
+  csv_load(csv, path);
+  t = bench_time() - t;
+
+  *rows = csv_rows(csv);
+  csv_delete(csv);
+  return t;
+}
+
+static void
+bench_sort(const char *path, const char *labels, const char *threads)
+{
+  csv_t *csv  = csv_create();
+  int    most = csv_getthreads();
+  double base = 0;
+  char  *work = strdup(threads ? threads : "");
+  char  *pos  = work;
+
+  csv_load(csv, path);
+
+  for( int n = 1, done = 0; !done; )
+  {
+    if( threads != 0 )
+    {
+      char *num = cstring_split_at_char(pos, &pos, ',');
+      if( *num == 0 )
+      {
+        break;
+      }
+      n = atoi(num);
+    }
+    else if( n >= most )
+    {
+      n = most, done = 1;
+    }
+
+    double best = 0;
+
+    csv_setthreads(n);
+    for( int round = 0; round < 3; ++round )
+    {
+      csv_t *copy = csv_copy(csv);
+      double t    = bench_time();
+      csv_op_sort(copy, labels);
+      t = bench_time() - t;
+      csv_delete(copy);
+      if( round == 0 || best > t ) best = t;
+    }
+    if( base == 0 ) base = best;
+
+    printf("%s: sort %-8s %3d threads %8.3f s %6.2fx\n", path, labels,
+           n, best, base / best);
+
+    if( threads == 0 )
+    {
+      n *= 2;
+    }
+  }
+
+  csv_setthreads(most);
+  free(work);
+  csv_delete(csv);
+}
+
+int main(int ac, char **av)
+{
+  static const struct
+  {
+    const char *name;
+    int         flags;
+  } mode[] =
+  {
+    { "getline", CTF_NO_MMAP },
+    { "mmap",    0           },
+  };
+
+  const char *labels  = 0;
+  const char *threads = 0;
+
+  for( int i = 1; i < ac; ++i )
+  {
+    if( !strcmp(av[i], "-s") && i + 1 < ac )
+    {
+      labels = av[++i];
+      continue;
+    }
+    if( !strcmp(av[i], "-j") && i + 1 < ac )
+    {
+      threads = av[++i];
+      continue;
+    }
+
+    struct stat st;
+    if( stat(av[i], &st) != 0 )
+    {
+      perror(av[i]);
+      continue;
+    }
+
+    for( size_t m = 0; m < sizeof mode / sizeof *mode; ++m )
+    {
+      double best = 0;
+      int    rows = 0;
+
+      for( int round = 0; round < 3; ++round )
+      {
+        double t = bench_load(av[i], mode[m].flags, &rows);
+        if( round == 0 || best > t ) best = t;
+      }
+      printf("%s: %-8s %9d rows %8.3f s %8.1f MB/s\n", av[i], mode[m].name,
+             rows, best, st.st_size / best / (1 << 20));
+    }
+
+    if( labels != 0 )
+    {
+      bench_sort(av[i], labels, threads);
+    }
+  }
+  return 0;
+}
+#endif
@@ -92,6 +92,7 @@ extern "C" {
 
 #include "array.h"
 #include "cstring.h"
+#include "mem_pool.h"
 
 #define CSV_EPSILON DBL_EPSILON
 
@@ -101,11 +102,20 @@ extern "C" {
 
 typedef struct csvvar_t     csvvar_t;   // key = value string pair
 typedef struct csvtext_t    csvtext_t;  // cell strings are interned
+typedef struct csvtextpool_t csvtextpool_t; // storage for interned strings
+typedef struct csvtextstat_t csvtextstat_t; // string pool statistics
+typedef struct csvmemstat_t  csvmemstat_t;  // table memory statistics
 typedef struct csvcell_t    csvcell_t;  // double/string container
 typedef struct csvrow_t     csvrow_t;   // array of cells
 typedef struct csv_t        csv_t;      // table of cells
 
 typedef struct csvord_t csvord_t;
+typedef struct csvcolumn_t csvcolumn_t; // column gathered into arrays
+typedef struct csvdict_t   csvdict_t;   // dictionary encoded string column
+typedef struct csvstat_t   csvstat_t;   // value statistics of a column
+typedef struct csvschema_t csvschema_t; // labels & column index, shareable
+typedef struct csvstream_t csvstream_t; // batch wise table processing
+typedef struct csvtail_t   csvtail_t;   // incremental loading of growing file
 
 // QUARANTINE typedef struct csvshuffle_t csvshuffle_t; // column shuffle book keeping
 
@@ -131,17 +141,61 @@ struct csvtext_t
   char       ct_text[];
 };
 
+/* ------------------------------------------------------------------------- *
+ * csvtextstat_t  --  interned string statistics, see csvtextpool_stats()
+ * ------------------------------------------------------------------------- */
+
+enum { CSVTEXT_CHAINLEN = 8 }; // chain length histogram, last is open ended
+
+struct csvtextstat_t
+{
+  size_t ts_strings;   // unique strings
+  size_t ts_requests;  // intern calls
+  size_t ts_hits;      // intern calls that found an existing string
+  size_t ts_text;      // text bytes, terminators included
+  size_t ts_entries;   // entry header bytes
+  size_t ts_tables;    // hash chain table bytes
+  size_t ts_reserved;  // bytes held by entry pools
+  size_t ts_chains;    // hash chains
+  size_t ts_maxchain;  // longest chain
+  size_t ts_chainlen[CSVTEXT_CHAINLEN]; // chains by number of entries
+};
+
 /* ------------------------------------------------------------------------- *
  * csvcell_t  --  numberic / textual value
+ *
+ * A cell holds either a double or an interned string, never both,
+ * so both are packed into 64 bits: numbers are stored as is and
+ * strings as a pointer in the payload of a negative quiet NaN that
+ * has the two highest mantissa bits set. NaN values produced by
+ * arithmetic never use that range; others are folded to the default
+ * NaN when stored. Use the csvcell_xxx() accessors instead of
+ * looking at the bits directly.
+ *
+ * Integers are doubles as long as the double is exact. Larger 64 bit
+ * integers are interned like strings and the cell holds the pointer
+ * in a positive NaN with the same tag bits, see csvcell_setinteger().
+ *
+ * Cell flags are not stored in cells, see csv_getcellflags().
  * ------------------------------------------------------------------------- */
 
 struct csvcell_t
 {
-  double      cc_number;
-  const char *cc_string;
-  unsigned    cc_flags;
+  uint64_t    cc_bits;
 };
 
+/* String pointers are stored in the 50 bits below the tag, so strings
+ * must live below 2^50 with the top byte clear: true for user space
+ * on x86-64 and AArch64 with 48 bit addresses, but not with 57 bit
+ * addresses or with tagged pointers (AArch64 TBI/MTE). Such addresses
+ * are caught where cell strings are allocated, see csv_table.c. */
+#define CSVCELL_TAG_MASK   0xfffc000000000000ull // sign, exponent & 2 bits
+#define CSVCELL_TAG_STRING 0xfffc000000000000ull // NaN boxed pointer
+#define CSVCELL_TAG_INT64  0x7ffc000000000000ull // NaN boxed large integer
+#define CSVCELL_TAG_NAN    0xfff8000000000000ull // default NaN on x86
+
+#define CSVCELL_EXACT      9007199254740992.0    // 2^53, doubles exact below
+
 enum
 {
   CF_USR1 = (1u<<0),
@@ -150,8 +204,7 @@ enum
   CF_USR4 = (1u<<3),
 };
 
-#define CSVCELL_ZERO {0.0,  0, 0}
-#define CSVCELL_NULL {0.0, "", 0}
+#define CSVCELL_ZERO {0}
 
 /* ------------------------------------------------------------------------- *
  * csvrow_t  --  row of cells
@@ -182,6 +235,23 @@ enum
   CTF_NO_HEADER     = (1u<<0), // omit headers while saving
   CTF_NO_LABELS     = (1u<<1), // omit labels while saving
   CTF_NO_TERMINATOR = (1u<<2), // omit empty line after data
+  CTF_NO_MMAP       = (1u<<3), // use stdio instead of mmap while loading
+};
+
+enum
+{
+  CSV_DISTINCT_COUNT = (1u<<0), // add count column of merged rows
+  CSV_DISTINCT_SORT  = (1u<<1), // sort result instead of keeping input order
+};
+
+enum
+{
+  CSV_JOIN_LEFT      = (1u<<0), // keep rows without match
+};
+
+enum
+{
+  CSV_TOP_DESC       = (1u<<0), // largest first, as :sort: + :reverse
 };
 
 /* ------------------------------------------------------------------------- *
@@ -195,15 +265,127 @@ struct csv_t
 
   int        csv_rowcnt;
   int        csv_rowmax;
+  int        csv_colmax; // cells allocated in each row of csv_rowtab
 
   unsigned  *csv_colflags;
 
   csvrow_t  *csv_labtab;
   csvrow_t **csv_rowtab;
+  mem_pool_t csv_rowpool; // storage for rows in csv_rowtab
 
   char      *csv_sepstr;
 
   char      *csv_source;
+
+  csvschema_t    *csv_schema;    // label index, NULL = not built yet
+
+  unsigned char **csv_cellflags; // CF_USRx per column, NULL = none set
+  int             csv_cellcols;  // columns in csv_cellflags
+  int             csv_cellrows;  // rows in each csv_cellflags column
+};
+
+/* ------------------------------------------------------------------------- *
+ * csvmemstat_t  --  memory held by a table, see csv_memstats()
+ *
+ * Interned strings are shared by all tables and are accounted for by
+ * csvtextpool_stats() instead.
+ * ------------------------------------------------------------------------- */
+
+struct csvmemstat_t
+{
+  size_t ms_rows;      // data rows
+  size_t ms_cols;      // columns
+  size_t ms_strcells;  // cells referring to interned strings
+  size_t ms_rowtab;    // row pointer table bytes
+  size_t ms_rowhead;   // row header bytes
+  size_t ms_cells;     // bytes of cells in use
+  size_t ms_rowpool;   // bytes held by the row pool
+  size_t ms_slack;     // pooled bytes not in use: spare columns,
+                       // dropped rows, unused chunk tails
+  size_t ms_labels;    // label row bytes
+  size_t ms_head;      // header variable bytes
+  size_t ms_flags;     // column & cell flag bytes
+  size_t ms_schema;    // label index bytes, when not shared
+  size_t ms_total;     // all of the above, pool counted once
+};
+
+/* ------------------------------------------------------------------------- *
+ * csvcolumn_t  --  values of one table column in contiguous arrays
+ *
+ * Rows keep their cells inline, so scanning a column of csv_t
+ * touches every row separately. A column view holds a copy of the
+ * values that can be scanned sequentially; changes are not visible
+ * in the table until stored back with csvcolumn_store().
+ * ------------------------------------------------------------------------- */
+
+struct csvcolumn_t
+{
+  int           cl_rows;
+  int           cl_strings; // number of rows with string value
+  double       *cl_number;  // numeric values, zero for strings
+  const char  **cl_string;  // interned strings, NULL for numbers,
+                            // interned value for large integers
+  uint64_t     *cl_isstr;   // bit per row: value is string
+};
+
+/* ------------------------------------------------------------------------- *
+ * csvdict_t  --  string values of one table column as integer codes
+ *
+ * Every distinct string in the column gets a code, and rows refer to
+ * the interned text via the code. Ranks give the csvtext_compare()
+ * order of the dictionary entries, strings that compare equal share
+ * the rank, so that rows can be sorted and compared by rank alone.
+ * ------------------------------------------------------------------------- */
+
+struct csvdict_t
+{
+  int           cd_rows;
+  uint32_t     *cd_code;   // row -> code, 0 = number
+  int           cd_count;  // distinct strings, codes are 1 ... cd_count
+  const char  **cd_text;   // code -> interned text
+  uint32_t     *cd_rank;   // code -> sort rank, 0 for numbers
+  uint32_t     *cd_slot;   // text -> code hash, open addressing
+  uint32_t      cd_mask;
+};
+
+/* ------------------------------------------------------------------------- *
+ * csvschema_t  --  column labels with hashed lookup
+ *
+ * Tables keep their labels in csv_labtab; the schema adds a label to
+ * column index on top of that, plus value types and statistics that
+ * are filled in by csvschema_analyze(). A schema is reference counted
+ * and can be shared by tables that have identical labels. Changing
+ * the columns of a table detaches it from a shared schema.
+ * ------------------------------------------------------------------------- */
+
+enum
+{
+  CT_NUMBER  = (1u<<0), // column has numeric values
+  CT_STRING  = (1u<<1), // column has non-empty string values
+  CT_EMPTY   = (1u<<2), // column has empty values
+  CT_INTEGER = (1u<<3), // all numeric values are integers
+};
+
+struct csvstat_t
+{
+  int          st_numbers; // rows with numeric value
+  int          st_strings; // rows with string value
+  double       st_min;     // smallest numeric value
+  double       st_max;     // largest numeric value
+  double       st_sum;     // sum of numeric values
+};
+
+struct csvschema_t
+{
+  int          cs_refs;  // tables using the schema
+  int          cs_cols;
+  int          cs_max;   // allocated columns
+  const char **cs_label; // interned labels
+  uint32_t    *cs_hval;  // label hash values
+  unsigned    *cs_type;  // CT_xxx flags, see csvschema_analyze()
+  csvstat_t   *cs_stat;  // value statistics, see csvschema_analyze()
+  int         *cs_slot;  // open addressed index: column + 1, 0 = free
+  int          cs_mask;  // number of slots - 1
 };
 
 /* ------------------------------------------------------------------------- *
@@ -247,8 +429,18 @@ void      csvvar_setval   (csvvar_t *self, const char *val);
 extern const char csvtext_empty[];
 
 const char *csvtext_intern (const char *text);
+const char *csvtext_intern_ex(const char *text, size_t size);
 int         csvtext_compare(const char *s1, const char *s2);
 
+csvtextpool_t *csvtextpool_create(void);
+void           csvtextpool_delete(csvtextpool_t *self);
+const char    *csvtextpool_intern(csvtextpool_t *self, const char *text, size_t size);
+size_t         csvtextpool_count (csvtextpool_t *self);
+void           csvtextpool_stats (csvtextpool_t *self, csvtextstat_t *stats);
+csvtextpool_t *csvtext_setpool   (csvtextpool_t *pool);
+
+void csvtextstat_emit(const csvtextstat_t *self, FILE *file);
+
 void csvtext_global_replace_char_hack(int from, int to);
 
 /* ========================================================================= *
@@ -257,14 +449,10 @@ void csvtext_global_replace_char_hack(int from, int to);
 
 void        csvcell_ctor               (csvcell_t *self);
 void        csvcell_dtor               (csvcell_t *self);
-int         csvcell_isstring           (const csvcell_t *self);
 int         csvcell_isempty            (const csvcell_t *self);
-int         csvcell_isnumber           (const csvcell_t *self);
 int         csvcell_iszero             (const csvcell_t *self);
-double      csvcell_getnumber          (const csvcell_t *self);
 const char *csvcell_getstring          (const csvcell_t *self, char *buff, size_t size);
 void        csvcell_setstring          (csvcell_t *self, const char *text);
-void        csvcell_setnumber          (csvcell_t *self, double numb);
 void        csvcell_setauto            (csvcell_t *self, const char *text);
 csvcell_t  *csvcell_create             (void);
 void        csvcell_delete             (csvcell_t *self);
@@ -273,6 +461,104 @@ int         csvcell_compare            (const csvcell_t *a, const csvcell_t *b);
 double      csvcell_diff               (const csvcell_t *a, const csvcell_t *b);
 int         csvcell_compare_cb         (const void *a, const void *b);
 int         csvcell_compare_indirect_cb(const void *a, const void *b);
+void        csvcell_setinteger         (csvcell_t *self, int64_t numb);
+int         csvcell_getinteger         (const csvcell_t *self, int64_t *pnumb);
+void        csvcell_setdigits          (csvcell_t *self, double numb, const char *text, size_t size);
+const char *csvcell_format             (const csvcell_t *self, char *buff, size_t size);
+
+/* ------------------------------------------------------------------------- *
+ * csvcell_gettext  --  string of cell, or NULL for numbers
+ * ------------------------------------------------------------------------- */
+
+static inline const char *csvcell_gettext(const csvcell_t *self)
+{
+  if( (self->cc_bits & CSVCELL_TAG_MASK) != CSVCELL_TAG_STRING )
+  {
+    return 0;
+  }
+  return (const char *)(uintptr_t)(self->cc_bits & ~CSVCELL_TAG_MASK);
+}
+
+/* ------------------------------------------------------------------------- *
+ * csvcell_settext  --  set cell to string that is already interned
+ * ------------------------------------------------------------------------- */
+
+static inline void csvcell_settext(csvcell_t *self, const char *text)
+{
+  self->cc_bits = CSVCELL_TAG_STRING | (uint64_t)(uintptr_t)text;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csvcell_isstring  --  check if cell is a string
+ * ------------------------------------------------------------------------- */
+
+static inline int csvcell_isstring(const csvcell_t *self)
+{
+  return (self->cc_bits & CSVCELL_TAG_MASK) == CSVCELL_TAG_STRING;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csvcell_isnumber  --  check if cell is a number
+ * ------------------------------------------------------------------------- */
+
+static inline int csvcell_isnumber(const csvcell_t *self)
+{
+  return (self->cc_bits & CSVCELL_TAG_MASK) != CSVCELL_TAG_STRING;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csvcell_isint64  --  check if cell is an integer too large for double
+ * ------------------------------------------------------------------------- */
+
+static inline int csvcell_isint64(const csvcell_t *self)
+{
+  return (self->cc_bits & CSVCELL_TAG_MASK) == CSVCELL_TAG_INT64;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csvcell_getint64  --  value of large integer cell
+ * ------------------------------------------------------------------------- */
+
+static inline int64_t csvcell_getint64(const csvcell_t *self)
+{
+  const char *data = (const char *)(uintptr_t)(self->cc_bits & ~CSVCELL_TAG_MASK);
+  int64_t     numb;
+
+  memcpy(&numb, data + 1, sizeof numb);
+  return numb;
+}
+
+/* ------------------------------------------------------------------------- *
+ * csvcell_getnumber  --  obtain numerical cell value, zero for strings
+ * ------------------------------------------------------------------------- */
+
+static inline double csvcell_getnumber(const csvcell_t *self)
+{
+  union { uint64_t u; double d; } v = { .u = self->cc_bits };
+
+  if( (v.u & CSVCELL_TAG_INT64) != CSVCELL_TAG_INT64 )
+  {
+    // plain double
+    return v.d;
+  }
+  return csvcell_isstring(self) ? 0.0 : (double)csvcell_getint64(self);
+}
+
+/* ------------------------------------------------------------------------- *
+ * csvcell_setnumber  --  set cell to numerical value
+ * ------------------------------------------------------------------------- */
+
+static inline void csvcell_setnumber(csvcell_t *self, double numb)
+{
+  union { uint64_t u; double d; } v = { .d = numb };
+
+  if( (v.u & CSVCELL_TAG_INT64) == CSVCELL_TAG_INT64 )
+  {
+    // string & large integer tags, either sign
+    v.u = CSVCELL_TAG_NAN;
+  }
+  self->cc_bits = v.u;
+}
 
 /* ========================================================================= *
  * csvrow_t  --  methods
@@ -288,6 +574,7 @@ void             csvrow_setstring          (csvrow_t *self, int col, const char
 void             csvrow_setnumber          (csvrow_t *self, int col, double numb);
 void             csvrow_setauto            (csvrow_t *self, int col, const char *text);
 csvrow_t        *csvrow_create             (int cols);
+csvrow_t        *csvrow_copy               (const csvrow_t *self);
 void             csvrow_delete             (csvrow_t *self);
 int              csvrow_addcol             (csvrow_t **pself);
 int              csvrow_remcol             (csvrow_t **pself, int col);
@@ -296,6 +583,44 @@ int              csvrow_compare            (const csvrow_t *row1, const csvrow_t
 int              csvrow_compare_cb         (const void *row1, const void *row2);
 int              csvrow_compare_indirect_cb(const void *row1p, const void *row2p);
 
+/* ========================================================================= *
+ * csvcolumn_t  --  methods
+ * ========================================================================= */
+
+csvcolumn_t *csvcolumn_create  (const csv_t *csv, int col);
+void         csvcolumn_delete  (csvcolumn_t *self);
+int          csvcolumn_isstring(const csvcolumn_t *self, int row);
+void         csvcolumn_getcell (const csvcolumn_t *self, int row, csvcell_t *cell);
+void         csvcolumn_store   (const csvcolumn_t *self, csv_t *csv, int col);
+
+/* ========================================================================= *
+ * csvdict_t  --  methods
+ * ========================================================================= */
+
+csvdict_t  *csvdict_create (const csv_t *csv, int col);
+void        csvdict_delete (csvdict_t *self);
+uint32_t    csvdict_lookup (const csvdict_t *self, const char *text);
+uint32_t    csvdict_textrank(const csvdict_t *self, const char *text);
+uint32_t    csvdict_getcode(const csvdict_t *self, int row);
+uint32_t    csvdict_getrank(const csvdict_t *self, int row);
+const char *csvdict_gettext(const csvdict_t *self, uint32_t code);
+
+/* ========================================================================= *
+ * csvschema_t  --  methods
+ * ========================================================================= */
+
+csvschema_t     *csvschema_create (void);
+void             csvschema_delete (csvschema_t *self);
+csvschema_t     *csvschema_share  (csvschema_t *self);
+int              csvschema_cols   (const csvschema_t *self);
+const char      *csvschema_label  (const csvschema_t *self, int col);
+int              csvschema_find   (const csvschema_t *self, const char *lab);
+int              csvschema_add    (csvschema_t *self, const char *lab);
+int              csvschema_equal  (const csvschema_t *self, const csvschema_t *that);
+unsigned         csvschema_type   (const csvschema_t *self, int col);
+const csvstat_t *csvschema_stat   (const csvschema_t *self, int col);
+void             csvschema_analyze(csvschema_t *self, const csv_t *csv);
+
 /* ========================================================================= *
  * csvord_t  --  methods
  * ========================================================================= */
@@ -309,6 +634,8 @@ void      csvord_unapply(csvord_t *self, csv_t *csv);
  * csv_t  --  methods
  * ========================================================================= */
 
+void        csv_setthreads  (int count);
+int         csv_getthreads  (void);
 void        csv_setseparator(csv_t *self, const char *sep);
 int         csv_cols        (const csv_t *self);
 int         csv_rows        (const csv_t *self);
@@ -324,6 +651,11 @@ void        csv_setrowflags (csv_t *self, int row, unsigned mask);
 void        csv_addrowflags (csv_t *self, int row, unsigned mask);
 void        csv_clrrowflags (csv_t *self, int row, unsigned mask);
 unsigned    csv_tstrowflags (const csv_t *self, int row, unsigned mask);
+unsigned    csv_getcellflags(const csv_t *self, int row, int col);
+unsigned    csv_tstcellflags(const csv_t *self, int row, int col, unsigned mask);
+void        csv_setcellflags(csv_t *self, int row, int col, unsigned mask);
+void        csv_addcellflags(csv_t *self, int row, int col, unsigned mask);
+void        csv_clrcellflags(csv_t *self, int row, int col, unsigned mask);
 csvrow_t   *csv_getrow      (const csv_t *self, int row);
 csvcell_t  *csv_getcell     (const csv_t *self, int row, int col);
 int         csv_isstring    (const csv_t *self, int row, int col);
@@ -338,6 +670,7 @@ const char *csv_getsource   (const csv_t *self);
 void        csv_ctor        (csv_t *self);
 void        csv_dtor        (csv_t *self);
 csv_t      *csv_create      (void);
+csv_t      *csv_copy        (const csv_t *self);
 void        csv_delete      (csv_t *self);
 void        csv_delete_cb   (void *self);
 void        csv_addvar      (csv_t *self, const char *key, const char *val);
@@ -346,19 +679,37 @@ csvrow_t   *csv_newrow      (csv_t *self);
 void        csv_delrow      (csv_t *self, int row);
 void        csv_delrow_nocompact(csv_t *self, int row);
 void        csv_compactrows (csv_t *self);
+void        csv_reserve     (csv_t *self, int rows, int cols);
 
+csvschema_t *csv_getschema  (csv_t *self);
+void        csv_memstats    (const csv_t *self, csvmemstat_t *stats);
+void        csvmemstat_emit (const csvmemstat_t *self, FILE *file);
+int         csv_setschema   (csv_t *self, csvschema_t *schema);
 int         csv_addcol      (csv_t *self, const char *lab);
 void        csv_remcol      (csv_t *self, int col);
 int         csv_getcol      (csv_t *self, const char *lab);
 int         csv_index       (csv_t *self, const char *lab);
 const char *csv_label       (const csv_t *self, int col);
 int         csv_load        (csv_t *self, const char *path);
+int         csv_load_cols   (csv_t *self, const char *path, const char *labels, int remove);
+int         csv_load_where  (csv_t *self, const char *path, const char *expr);
+int         csv_load_many   (csv_t *self, const char **path, int count, const char *srclab);
 int         csv_save        (csv_t *self, const char *path);
 int         csv_save_as_html(csv_t *self, const char *path);
 void        csv_sortrows    (csv_t *self);
+int         csv_distinct    (csv_t *self, const char *labels, unsigned flags);
+int         csv_join        (csv_t *self, csv_t *other, const char *keys, unsigned flags);
+int         csv_top         (csv_t *self, int count, const char *labels, const char *group, unsigned flags);
+int         csv_delta       (csv_t *self, const char *keys, const char *cols, const char *time);
 int         csv_op_calc     (csv_t *self, const char *expr);
 void        csv_op_sort     (csv_t *self, const char *labels);
 void        csv_op_uniq     (csv_t *self, const char *labels);
+void        csv_op_distinct (csv_t *self, const char *labels);
+int         csv_op_count    (csv_t *self, const char *labels);
+int         csv_op_group    (csv_t *self, const char *keys, const char *aggs);
+int         csv_op_join     (csv_t *self, const char *args);
+int         csv_op_top      (csv_t *self, const char *args);
+int         csv_op_delta    (csv_t *self, const char *args);
 void        csv_op_usecols  (csv_t *self, const char *labels);
 void        csv_op_remcols  (csv_t *self, const char *labels);
 void        csv_op_origin   (csv_t *self, const char *labels);
@@ -366,6 +717,27 @@ void        csv_op_order    (csv_t *self, const char *labels);
 void        csv_op_reverse  (csv_t *self);
 int         csv_op_select   (csv_t *self, const char *expr);
 int         csv_filter      (csv_t *self, const char *expression, const char *defop);
+int         csv_op_isrowlocal(const char *expression, const char *defop);
+
+/* ========================================================================= *
+ * csvstream_t  --  methods
+ * ========================================================================= */
+
+csvstream_t *csvstream_open   (csv_t *table, const char *input, const char *output);
+csvstream_t *csvstream_follow (csv_t *table, const char *input, const char *output);
+void         csvstream_project(csvstream_t *self, const char *labels, int remove);
+void         csvstream_where  (csvstream_t *self, const char *expr);
+int          csvstream_read   (csvstream_t *self);
+void         csvstream_write  (csvstream_t *self);
+int          csvstream_close  (csvstream_t *self);
+
+/* ========================================================================= *
+ * csvtail_t  --  methods
+ * ========================================================================= */
+
+csvtail_t   *csvtail_open     (csv_t *table, const char *path);
+int          csvtail_read     (csvtail_t *self);
+void         csvtail_close    (csvtail_t *self);
 
 #ifdef __cplusplus
 };
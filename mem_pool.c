@@ -54,6 +54,7 @@ mem_chunk_t *mem_chunk_create(size_t size)
   msg_debug("%s: %d kB\n", __FUNCTION__, size >> 10);
 
   mem_chunk_t *self = malloc(sizeof *self + size);
+  self->next = 0;
   self->head = 0;
   self->tail = size;
   return self;
@@ -148,13 +149,22 @@ void mem_pool_delete(mem_pool_t *self)
 
 void *mem_pool_alloc(mem_pool_t *self, size_t size)
 {
-  size = (size + 3) & ~3;
+  size = (size + 7) & ~7;
+
+  if( size > self->alloc && self->chunk != 0 )
+  {
+    // dedicated chunk behind the current one, which stays in use
+    mem_chunk_t *chunk = mem_chunk_create(size);
+    chunk->next = self->chunk->next;
+    self->chunk->next = chunk;
+    return mem_chunk_alloc(chunk, size);
+  }
 
   if( mem_chunk_avail(self->chunk) < size )
   {
     mem_chunk_t *chunk;
 
-    chunk = mem_chunk_create(self->alloc);
+    chunk = mem_chunk_create(size > self->alloc ? size : self->alloc);
     chunk->next = self->chunk;
     self->chunk = chunk;
   }
@@ -162,6 +172,54 @@ void *mem_pool_alloc(mem_pool_t *self, size_t size)
   return mem_chunk_alloc(self->chunk, size);
 }
 
+/* ------------------------------------------------------------------------- *
+ * mem_pool_splice  --  move all allocations of another pool to this one
+ * ------------------------------------------------------------------------- */
+
+void mem_pool_splice(mem_pool_t *self, mem_pool_t *from)
+{
+  mem_chunk_t *tail = from->chunk;
+
+  if( tail == 0 )
+  {
+    return;
+  }
+
+  while( tail->next != 0 )
+  {
+    tail = tail->next;
+  }
+
+  if( self->chunk != 0 )
+  {
+    tail->next = self->chunk->next;
+    self->chunk->next = from->chunk;
+  }
+  else
+  {
+    self->chunk = from->chunk;
+  }
+  from->chunk = 0;
+}
+
+/* ------------------------------------------------------------------------- *
+ * mem_pool_usage  --  bytes handed out and bytes held by chunks
+ * ------------------------------------------------------------------------- */
+
+void mem_pool_usage(const mem_pool_t *self, size_t *used, size_t *reserved)
+{
+  size_t u = 0, r = 0;
+
+  for( const mem_chunk_t *chunk = self->chunk; chunk; chunk = chunk->next )
+  {
+    u += chunk->head;
+    r += sizeof *chunk + chunk->tail;
+  }
+
+  if( used )     *used     = u;
+  if( reserved ) *reserved = r;
+}
+
 /* ------------------------------------------------------------------------- *
  * mem_pool_strdup
  * ------------------------------------------------------------------------- */
@@ -81,6 +81,8 @@ void mem_pool_delete(mem_pool_t *self);
 
 void *mem_pool_alloc(mem_pool_t *self, size_t size);
 void *mem_pool_strdup(mem_pool_t *self, const char *str);
+void mem_pool_splice(mem_pool_t *self, mem_pool_t *from);
+void mem_pool_usage(const mem_pool_t *self, size_t *used, size_t *reserved);
 
 #ifdef __cplusplus
 };
@@ -114,6 +114,12 @@ static const manual_t app_man[]=
           ":select:<expr>\n"
           ":sort:[label,...]]\n"
           ":uniq:[label,...]]\n"
+          ":distinct:[label,...]]\n"
+          ":count:[label,...]]\n"
+          ":group:<label,...>[:<aggregate,...>]\n"
+          ":join:<path>:<label,...>[:inner|left]\n"
+          ":top:<count>:[label,...][:asc|desc][:<label,...>]\n"
+          ":delta:<label,...>:<label,...>[:<label>]\n"
           ":usecols:<label,...>\n"
           ":remcols:<label,...>\n"
           ":order:<label,...>\n"
@@ -131,6 +137,58 @@ static const manual_t app_man[]=
           "The operations are executed after the data has been read in the\n"
           "same order as specified on command line\n"
           "\n"
+          "The uniq operation keeps unique combinations of given columns,\n"
+          "or whole rows, in sorted order. Distinct does the same keeping\n"
+          "the first row of each combination in input order, and count\n"
+          "also adds a 'count' column telling how many rows had it.\n"
+          "\n"
+          "Group makes one row per unique combination of given columns\n"
+          "followed by aggregates over the rows having it: count, or one\n"
+          "of sum, mean, stddev, min, max, first, last and count applied\n"
+          "to a column as in 'max(rss)'. Results are labeled 'count' and\n"
+          "'<aggregate>_<column>', empty values are ignored. Default is\n"
+          "count, thus\n"
+          "  % "TOOL_NAME" :group:pid,comm:count,max(rss),sum(utime)\n"
+          "\n"
+          "Join loads another table from given path and adds its columns\n"
+          "to rows having the same values in given key columns, making a\n"
+          "row for every match. Rows without a match are dropped, or with\n"
+          "left join kept with empty values. Labels that are already in\n"
+          "use get a numeric suffix, e.g.\n"
+          "  % "TOOL_NAME" -fstat.csv :join:services.csv:pid:left\n"
+          "\n"
+          "Top keeps the given count of rows that sort would put first,\n"
+          "or with desc last ones in reverse order, without sorting the\n"
+          "whole table. If group columns are given, the count applies to\n"
+          "every combination of their values, e.g. three largest <rss>\n"
+          "values of each <comm>\n"
+          "  % "TOOL_NAME" :top:3:rss:desc:comm\n"
+          "\n"
+          "Delta is for cumulative counters: for every row it adds the\n"
+          "difference of each given column to the previous row with equal\n"
+          "values in key columns as 'delta_<column>', and divided by time\n"
+          "elapsed as 'rate_<column>'. Time column is the optional third\n"
+          "argument, by default <time> if the table has one. A value less\n"
+          "than the previous one is taken as counter reset. Rows need not\n"
+          "be sorted, e.g. to keep reused pids apart\n"
+          "  % "TOOL_NAME" :delta:pid,starttime:utime,stime,minflt\n"
+          "\n"
+          "If all operations are row local (calc, select, usecols, remcols\n"
+          "and order), the data is processed in batches of rows and the\n"
+          "table is never held in memory as a whole.\n"
+          "\n"
+          "Leading usecols or remcols operation is applied already while\n"
+          "reading the data, values of dropped columns are not parsed.\n"
+          "Likewise leading select operation that only refers to existing\n"
+          "columns and makes no assignments is evaluated while reading,\n"
+          "rows that are not selected are never stored.\n"
+          "\n"
+          "With --follow the input file is read further as rows are appended\n"
+          "to it. Row local operations are then applied to new rows only and\n"
+          "the results appended to output. Otherwise all operations are done\n"
+          "again on all rows read so far and a new table is written out each\n"
+          "time the input has grown.\n"
+          "\n"
           "Note that you should escape of quote chars that have special\n"
           "meaning for shell.\n"
           )
@@ -163,10 +221,16 @@ enum
 
   opt_input,
   opt_output,
+  opt_source,
 
   opt_no_header,
   opt_no_labels,
   opt_data_only,
+
+  opt_no_mmap,
+  opt_threads,
+  opt_follow,
+  opt_stats,
 };
 
 static const option_t app_opt[] =
@@ -201,12 +265,19 @@ static const option_t app_opt[] =
 
   OPT_ADD(opt_input,
           "f", "input", "<source path>",
-          "Input file to use instead of stdin.\n" ),
+          "Input file to use instead of stdin. Can be given several\n"
+          "times, the files are then loaded in parallel and merged\n"
+          "into one table having the columns of all files.\n" ),
 
   OPT_ADD(opt_output,
           "o", "output", "<destination path>",
           "Output file to use instead of stdout.\n" ),
 
+  OPT_ADD(opt_source,
+          "S", "source", "<label>",
+          "Add column with given label, telling the input file each\n"
+          "row was read from.\n" ),
+
   OPT_ADD(opt_no_header,
           0, "no-header", 0,
           "Omit header rows from Output.\n" ),
@@ -219,6 +290,26 @@ static const option_t app_opt[] =
           0, "data-only", 0,
           "Output only data rows.\n" ),
 
+  OPT_ADD(opt_no_mmap,
+          0, "no-mmap", 0,
+          "Read input via stdio instead of parsing it in place\n"
+          "from mmapped file.\n" ),
+
+  OPT_ADD(opt_threads,
+          "j", "threads", "<count>",
+          "Number of threads to use for loading and sorting large\n"
+          "tables, defaults to number of CPUs.\n" ),
+
+  OPT_ADD(opt_follow,
+          "F", "follow", "<seconds>",
+          "Keep reading rows appended to the input file, checking\n"
+          "for more with given interval.\n" ),
+
+  OPT_ADD(opt_stats,
+          0, "stats", 0,
+          "Print memory usage of the table and the interned strings\n"
+          "to stderr after loading and after each operation.\n" ),
+
   OPT_END
 };
 
@@ -232,8 +323,13 @@ struct sp_csv_filter_t
 {
   char         *input;
   char         *output;
+  str_array_t   inputs;      // all input files given
+  char         *source;      // label for input file column, or NULL
   csv_t        *table;
   str_array_t   expressions;
+  char         *failed;      // expressions that failed on first batch
+  double        follow;      // input poll interval, or zero
+  int           stats;       // print memory statistics
 };
 
 /* ------------------------------------------------------------------------- *
@@ -244,9 +340,14 @@ static inline void sp_csv_filter_ctor(sp_csv_filter_t *self)
 {
   self->input  = 0;
   self->output = 0;
+  self->source = 0;
   self->table  = csv_create();
+  self->failed = 0;
+  self->follow = 0;
+  self->stats  = 0;
 
   str_array_ctor(&self->expressions);
+  str_array_ctor(&self->inputs);
 }
 
 /* ------------------------------------------------------------------------- *
@@ -257,9 +358,12 @@ static inline void sp_csv_filter_dtor(sp_csv_filter_t *self)
 {
   free(self->input);
   free(self->output);
+  free(self->source);
+  free(self->failed);
   csv_delete(self->table);
 
   array_dtor(&self->expressions);
+  array_dtor(&self->inputs);
 }
 
 /* ------------------------------------------------------------------------- *
@@ -286,6 +390,15 @@ void sp_csv_filter_delete(sp_csv_filter_t *self)
   }
 }
 
+/* ------------------------------------------------------------------------- *
+ * sp_csv_filter_merging  --  several inputs or source column
+ * ------------------------------------------------------------------------- */
+
+int sp_csv_filter_merging(sp_csv_filter_t *self)
+{
+  return self->inputs.size > 1 || self->source != 0;
+}
+
 /* ------------------------------------------------------------------------- *
  * sp_csv_filter_sanity
  * ------------------------------------------------------------------------- */
@@ -298,6 +411,125 @@ void sp_csv_filter_sanity(sp_csv_filter_t *self)
     msg_fatal("refusing to filter stdin -> stdout interactively\n"
               "(use --help for usage)\n");
   }
+
+  if( self->follow > 0 && (self->input == 0 || !strcmp(self->input, "-")) )
+  {
+    msg_fatal("following requires input file\n"
+              "(use --help for usage)\n");
+  }
+
+  if( self->follow > 0 && sp_csv_filter_merging(self) )
+  {
+    msg_fatal("following can not be combined with merging inputs\n"
+              "(use --help for usage)\n");
+  }
+}
+
+/* ------------------------------------------------------------------------- *
+ * sp_csv_filter_default_operation  --  derived from executable name
+ * ------------------------------------------------------------------------- */
+
+const char *sp_csv_filter_default_operation(void)
+{
+  const char *prog = msg_getprogname();
+  const char *base = strrchr(prog, '_');
+  return base ? (base + 1) : prog;
+}
+
+/* ------------------------------------------------------------------------- *
+ * sp_csv_filter_projection  --  leading usecols / remcols operation
+ *
+ * Returns label list of leading column selection that can be
+ * done already while loading, or NULL. Columns referred to by
+ * index are left for the operation proper, as applying those
+ * twice would not give the same result.
+ * ------------------------------------------------------------------------- */
+
+char *sp_csv_filter_projection(sp_csv_filter_t *self, int *premove)
+{
+  const char *oper = sp_csv_filter_default_operation();
+  char       *work = 0;
+  char       *expr = 0;
+
+  if( self->expressions.size == 0 )
+  {
+    return 0;
+  }
+
+  work = strdup(str_array_get(&self->expressions, 0));
+  expr = work;
+
+  if( *work == ':' )
+  {
+    oper = cstring_split_at_char(work+1, &expr, ':');
+  }
+
+  if( !strcmp(oper, "usecols") || !strcmp(oper, "remcols") )
+  {
+    char *temp = strdup(expr);
+
+    *premove = !strcmp(oper, "remcols");
+
+    for( char *pos = temp; *pos; )
+    {
+      char *lab = cstring_split_at_char(pos, &pos, ',');
+      char *end = 0;
+
+      strtol(lab, &end, 0);
+
+      if( *lab != 0 && end != lab && *end == 0 )
+      {
+        oper = 0;
+        break;
+      }
+    }
+
+    free(temp);
+
+    if( oper != 0 )
+    {
+      expr = strdup(expr);
+      free(work);
+      return expr;
+    }
+  }
+
+  free(work);
+  return 0;
+}
+
+/* ------------------------------------------------------------------------- *
+ * sp_csv_filter_predicate  --  leading select operation
+ *
+ * Returns expression of leading row selection that can be done
+ * already while loading, or NULL. The operation proper is still
+ * executed afterwards, which is harmless as the loader accepts
+ * only expressions that do not modify the table.
+ * ------------------------------------------------------------------------- */
+
+char *sp_csv_filter_predicate(sp_csv_filter_t *self)
+{
+  const char *oper = sp_csv_filter_default_operation();
+  char       *work = 0;
+  char       *expr = 0;
+
+  if( self->expressions.size == 0 )
+  {
+    return 0;
+  }
+
+  work = strdup(str_array_get(&self->expressions, 0));
+  expr = work;
+
+  if( *work == ':' )
+  {
+    oper = cstring_split_at_char(work+1, &expr, ':');
+  }
+
+  expr = strcmp(oper, "select") ? 0 : strdup(expr);
+
+  free(work);
+  return expr;
 }
 
 /* ------------------------------------------------------------------------- *
@@ -306,7 +538,36 @@ void sp_csv_filter_sanity(sp_csv_filter_t *self)
 
 int sp_csv_filter_load_table(sp_csv_filter_t *self)
 {
-  return csv_load(self->table, self->input);
+  if( sp_csv_filter_merging(self) )
+  {
+    // source column for stdin alone
+    const char *stdin_path[] = { "-" };
+
+    if( self->inputs.size == 0 )
+    {
+      return csv_load_many(self->table, stdin_path, 1, self->source);
+    }
+    return csv_load_many(self->table, (const char **)self->inputs.data,
+                         self->inputs.size, self->source);
+  }
+
+  int   remove = 0;
+  char *labels = sp_csv_filter_projection(self, &remove);
+  char *where  = sp_csv_filter_predicate(self);
+  int   err    = -1;
+
+  if( labels != 0 )
+  {
+    err = csv_load_cols(self->table, self->input, labels, remove);
+  }
+  else
+  {
+    err = csv_load_where(self->table, self->input, where);
+  }
+
+  free(labels);
+  free(where);
+  return err;
 }
 
 /* ------------------------------------------------------------------------- *
@@ -327,30 +588,210 @@ void sp_csv_filter_add_expression(sp_csv_filter_t *self, char *expr)
   str_array_add(&self->expressions, expr);
 }
 
+/* ------------------------------------------------------------------------- *
+ * sp_csv_filter_emit_stats  --  memory usage after given step
+ * ------------------------------------------------------------------------- */
+
+void sp_csv_filter_emit_stats(sp_csv_filter_t *self, const char *step)
+{
+  csvmemstat_t  mem;
+  csvtextstat_t txt;
+
+  csv_memstats(self->table, &mem);
+  csvtextpool_stats(0, &txt);
+
+  fprintf(stderr, "-- %s: %d rows, %d cols\n", step,
+          csv_rows(self->table), csv_cols(self->table));
+  csvmemstat_emit(&mem, stderr);
+  csvtextstat_emit(&txt, stderr);
+}
+
 /* ------------------------------------------------------------------------- *
  * sp_csv_filter_handle_expressions
  * ------------------------------------------------------------------------- */
 
 void sp_csv_filter_handle_expressions(sp_csv_filter_t *self)
 {
+  const char *oper  = sp_csv_filter_default_operation();
+  int         stats = 0;
+
   /* - - - - - - - - - - - - - - - - - - - *
-   * default operation derived from
-   * executable name
+   * statistics are printed for the first
+   * batch / table only
    * - - - - - - - - - - - - - - - - - - - */
 
-  const char *prog = msg_getprogname();
-  const char *base = strrchr(prog, '_');
-  const char *oper = base ? (base + 1) : prog;
+  if( self->failed == 0 )
+  {
+    self->failed = calloc(self->expressions.size + 1, 1);
+    stats = self->stats;
+  }
+
+  if( stats )
+  {
+    sp_csv_filter_emit_stats(self, "load");
+  }
 
   /* - - - - - - - - - - - - - - - - - - - *
-   * execute filters in original order
+   * execute filters in original order,
+   * skip the ones that have already
+   * failed to avoid repeating diagnostics
+   * while streaming
    * - - - - - - - - - - - - - - - - - - - */
 
   for( size_t i = 0; i < self->expressions.size; ++i )
   {
     char *expr = str_array_get(&self->expressions, i);
-    csv_filter(self->table, expr, oper);
+
+    if( !self->failed[i] && csv_filter(self->table, expr, oper) != 0 )
+    {
+      self->failed[i] = 1;
+    }
+
+    if( stats )
+    {
+      sp_csv_filter_emit_stats(self, expr);
+    }
+  }
+}
+
+/* ------------------------------------------------------------------------- *
+ * sp_csv_filter_can_stream  --  all operations can be done batch wise
+ * ------------------------------------------------------------------------- */
+
+int sp_csv_filter_can_stream(sp_csv_filter_t *self)
+{
+  const char *oper = sp_csv_filter_default_operation();
+
+  if( sp_csv_filter_merging(self) )
+  {
+    return 0;
+  }
+
+  for( size_t i = 0; i < self->expressions.size; ++i )
+  {
+    char *expr = str_array_get(&self->expressions, i);
+
+    if( !csv_op_isrowlocal(expr, oper) )
+    {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/* ------------------------------------------------------------------------- *
+ * sp_csv_filter_sleep  --  wait before polling input again
+ * ------------------------------------------------------------------------- */
+
+void sp_csv_filter_sleep(double seconds)
+{
+  struct timespec ts;
+
+  ts.tv_sec  = (time_t)seconds;
+  ts.tv_nsec = (long)((seconds - ts.tv_sec) * 1e9);
+
+  nanosleep(&ts, 0);
+}
+
+/* ------------------------------------------------------------------------- *
+ * sp_csv_filter_stream_table  --  load, filter & save in batches
+ * ------------------------------------------------------------------------- */
+
+int sp_csv_filter_stream_table(sp_csv_filter_t *self)
+{
+  csvstream_t *stream = 0;
+
+  if( self->follow > 0 )
+  {
+    stream = csvstream_follow(self->table, self->input, self->output);
+  }
+  else
+  {
+    stream = csvstream_open(self->table, self->input, self->output);
+  }
+
+  if( stream == 0 )
+  {
+    return -1;
+  }
+
+  int   remove = 0;
+  char *labels = sp_csv_filter_projection(self, &remove);
+
+  char *where  = sp_csv_filter_predicate(self);
+
+  csvstream_project(stream, labels, remove);
+  csvstream_where(stream, where);
+  free(labels);
+
+  csv_addvar(self->table, "filter", TOOL_NAME" "TOOL_VERS);
+
+  for( int eof = 0; !eof; )
+  {
+    eof = csvstream_read(stream);
+
+    int rows = csv_rows(self->table);
+
+    sp_csv_filter_handle_expressions(self);
+    csvstream_write(stream);
+
+    if( !eof && rows == 0 && self->follow > 0 )
+    {
+      sp_csv_filter_sleep(self->follow);
+    }
   }
+
+  int err = csvstream_close(stream);
+
+  free(where);
+  return err;
+}
+
+/* ------------------------------------------------------------------------- *
+ * sp_csv_filter_follow_table  --  redo operations as input grows
+ *
+ * Used when some operation needs the whole table. The rows read
+ * so far are kept and all operations are executed on a copy of
+ * them whenever rows have been added, writing out a new table.
+ * ------------------------------------------------------------------------- */
+
+int sp_csv_filter_follow_table(sp_csv_filter_t *self)
+{
+  csv_t     *input = self->table;
+  csvtail_t *tail  = csvtail_open(input, self->input);
+  int        err   = 0;
+
+  if( tail == 0 )
+  {
+    return -1;
+  }
+
+  csv_addvar(input, "filter", TOOL_NAME" "TOOL_VERS);
+
+  int rows = csvtail_read(tail);
+
+  for( int todo = 1; rows >= 0 && !err; rows = csvtail_read(tail) )
+  {
+    if( rows == 0 && !todo )
+    {
+      sp_csv_filter_sleep(self->follow);
+      continue;
+    }
+
+    self->table = csv_copy(input);
+
+    sp_csv_filter_handle_expressions(self);
+    err = sp_csv_filter_save_table(self);
+    fflush(stdout);
+
+    csv_delete(self->table);
+    self->table = input;
+    todo = 0;
+  }
+
+  csvtail_close(tail);
+
+  return err;
 }
 
 /* ------------------------------------------------------------------------- *
@@ -398,12 +839,17 @@ void sp_csv_filter_handle_arguments(sp_csv_filter_t *self, int ac, char **av)
 
     case opt_input:
       SET_STRING(self->input, par);
+      str_array_add(&self->inputs, par);
       break;
 
     case opt_output:
       SET_STRING(self->output, par);
       break;
 
+    case opt_source:
+      SET_STRING(self->source, par);
+      break;
+
     case opt_noswitch:
       sp_csv_filter_add_expression(self, par);
       break;
@@ -420,6 +866,26 @@ void sp_csv_filter_handle_arguments(sp_csv_filter_t *self, int ac, char **av)
       self->table->csv_flags |= (CTF_NO_HEADER | CTF_NO_LABELS |
                               CTF_NO_TERMINATOR);
       break;
+
+    case opt_no_mmap:
+      self->table->csv_flags |= CTF_NO_MMAP;
+      break;
+
+    case opt_threads:
+      csv_setthreads(strtol(par, 0, 0));
+      break;
+
+    case opt_follow:
+      self->follow = strtod(par, 0);
+      if( !(self->follow > 0) )
+      {
+        msg_fatal("invalid follow interval '%s'\n", par);
+      }
+      break;
+
+    case opt_stats:
+      self->stats = 1;
+      break;
     }
   }
 
@@ -440,6 +906,35 @@ int main(int ac, char **av)
 
   sp_csv_filter_sanity(app);
 
+  /* - - - - - - - - - - - - - - - - - - - *
+   * following growing input file
+   * - - - - - - - - - - - - - - - - - - - */
+
+  if( app->follow > 0 && !sp_csv_filter_can_stream(app) )
+  {
+    if( sp_csv_filter_follow_table(app) != 0 )
+    {
+      exit(EXIT_FAILURE);
+    }
+    sp_csv_filter_delete(app);
+    return 0;
+  }
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * row local operations do not need the
+   * whole table in memory
+   * - - - - - - - - - - - - - - - - - - - */
+
+  if( sp_csv_filter_can_stream(app) )
+  {
+    if( sp_csv_filter_stream_table(app) != 0 )
+    {
+      exit(EXIT_FAILURE);
+    }
+    sp_csv_filter_delete(app);
+    return 0;
+  }
+
   if( sp_csv_filter_load_table(app) != 0 )
   {
     exit(EXIT_FAILURE);